@@ -0,0 +1,140 @@
+#include "benchutil.h"
+#include "../common.h"
+#include <iomanip>
+#include <iostream>
+#include <cctype>
+#include <cstdlib>
+
+// normally defined in main.cpp
+bool salt::no_std = false;
+std::vector<std::string> salt::file_names = {};
+int salt::current_file_name_index = 0;
+
+uint64_t parse_size(const std::string& str) {
+    size_t digits = 0;
+    while (digits < str.size() && std::isdigit(static_cast<unsigned char>(str[digits])))
+        digits++;
+
+    if (digits == 0)
+        salt::print_fatal("bad size \"" + str + "\", expected something like 64MB");
+
+    uint64_t size = std::stoull(str.substr(0, digits));
+    const std::string unit = str.substr(digits);
+    if (unit == "KB" || unit == "kb")
+        size <<= 10;
+    else if (unit == "MB" || unit == "mb")
+        size <<= 20;
+    else if (unit == "GB" || unit == "gb")
+        size <<= 30;
+    else if (!unit.empty())
+        salt::print_fatal("bad size unit \"" + unit + "\", expected KB, MB or GB");
+    return size;
+}
+
+std::vector<std::string> split_list(const std::string& str) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= str.size()) {
+        size_t comma = str.find(',', start);
+        if (comma == std::string::npos)
+            comma = str.size();
+        items.push_back(str.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+static std::string json_escape(const std::string& str) {
+    std::string res;
+    for (char ch : str) {
+        if (ch == '"' || ch == '\\')
+            res += '\\';
+        res += ch;
+    }
+    return res;
+}
+
+JsonObject& JsonObject::text(const std::string& key, const std::string& value) {
+    fields_.push_back({ key, '"' + json_escape(value) + '"' });
+    return *this;
+}
+
+JsonObject& JsonObject::integer(const std::string& key, uint64_t value) {
+    fields_.push_back({ key, std::to_string(value) });
+    return *this;
+}
+
+// As short as it can be, 0.01 stays 0.01
+JsonObject& JsonObject::number(const std::string& key, double value) {
+    std::ostringstream out;
+    out << value;
+    fields_.push_back({ key, out.str() });
+    return *this;
+}
+
+// Always precision digits after the point, so the columns of a run line up
+JsonObject& JsonObject::number(const std::string& key, double value, int precision) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(precision) << value;
+    fields_.push_back({ key, out.str() });
+    return *this;
+}
+
+const std::vector<std::pair<std::string, std::string>>& JsonObject::fields() const {
+    return fields_;
+}
+
+void print_json(const JsonObject& header, const std::vector<JsonObject>& results) {
+    std::cout << "{\n";
+    for (const auto& [key, value] : header.fields())
+        std::cout << "  \"" << key << "\": " << value << ",\n";
+    std::cout << "  \"results\": [\n";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        std::cout << "    {";
+        const auto& fields = results[i].fields();
+        for (size_t j = 0; j < fields.size(); j++)
+            std::cout << (j ? ", \"" : "\"") << fields[j].first << "\": " << fields[j].second;
+        std::cout << (i + 1 < results.size() ? "},\n" : "}\n");
+    }
+
+    std::cout << "  ]\n}" << std::endl;
+}
+
+double json_number(const std::string& line, const std::string& key) {
+    const size_t pos = line.find('"' + key + "\": ");
+    if (pos == std::string::npos)
+        return -1.0;
+    return std::atof(line.c_str() + pos + key.size() + 4);
+}
+
+std::string json_string(const std::string& line, const std::string& key) {
+    const std::string needle = '"' + key + "\": \"";
+    const size_t pos = line.find(needle);
+    if (pos == std::string::npos)
+        return "";
+    const size_t start = pos + needle.size();
+    return line.substr(start, line.find('"', start) - start);
+}
+
+TableRow::TableRow(const std::string& name, int width) {
+    out_ << std::left << std::setw(width) << name << std::right;
+}
+
+TableRow& TableRow::count(uint64_t value, int width, const char* unit) {
+    out_ << std::setw(width) << value << ' ' << unit << ' ';
+    return *this;
+}
+
+TableRow& TableRow::number(double value, int width, int precision, const char* unit) {
+    out_ << std::setw(width) << std::fixed << std::setprecision(precision) << value << ' ' << unit << ' ';
+    return *this;
+}
+
+// Without the space after the last unit
+std::string TableRow::str() const {
+    std::string res = out_.str();
+    if (!res.empty() && res.back() == ' ')
+        res.pop_back();
+    return res;
+}
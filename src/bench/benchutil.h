@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sstream>
+#include <utility>
+#include "../frontend/diagnostics.h"
+
+// What every benchmark needs besides the thing it measures: reading its arguments,
+// and printing the results as JSON or as a table.
+
+// DiagnosticSink already counts errors, a bench only wants to know if there were any
+class SilentDiagnosticSink : public DiagnosticSink {
+protected:
+    void emit(DiagnosticLevel, const std::string&) override {}
+};
+
+// "1GB", "64MB", "512KB" or just a number of bytes
+uint64_t parse_size(const std::string& str);
+
+// "a,b,c" -> { "a", "b", "c" }
+std::vector<std::string> split_list(const std::string& str);
+
+// The fields of one JSON object, in the order they were added
+class JsonObject {
+private:
+    std::vector<std::pair<std::string, std::string>> fields_; // key, value already written as JSON
+public:
+    JsonObject& text(const std::string& key, const std::string& value);
+    JsonObject& integer(const std::string& key, uint64_t value);
+    JsonObject& number(const std::string& key, double value);
+    JsonObject& number(const std::string& key, double value, int precision);
+
+    const std::vector<std::pair<std::string, std::string>>& fields() const;
+};
+
+// Prints the fields of header one per line, then "results" with one result per line (parser_bench --compare depends on it)
+void print_json(const JsonObject& header, const std::vector<JsonObject>& results);
+
+// The number after "key": on a line of print_json(), or -1 if it isn't there
+double json_number(const std::string& line, const std::string& key);
+
+// The string after "key": on a line of print_json(), or "" if it isn't there
+std::string json_string(const std::string& line, const std::string& key);
+
+// One line of a --table: a left aligned name, then right aligned columns each followed by their unit
+class TableRow {
+private:
+    std::ostringstream out_;
+public:
+    TableRow(const std::string& name, int width);
+    TableRow& count(uint64_t value, int width, const char* unit);
+    TableRow& number(double value, int width, int precision, const char* unit);
+
+    std::string str() const;
+};
@@ -0,0 +1,108 @@
+#include "corpus.h"
+#include "../common.h"
+#include <fstream>
+
+const std::vector<CorpusShape>& all_corpus_shapes() {
+    static const std::vector<CorpusShape> shapes = {
+        CorpusShape::IDENT,
+        CorpusShape::NUMERIC,
+        CorpusShape::INDENT,
+        CorpusShape::COMMENT,
+        CorpusShape::STRING,
+    };
+    return shapes;
+}
+
+const char* corpus_shape_name(CorpusShape shape) {
+    switch (shape) {
+    case CorpusShape::IDENT:    return "ident";
+    case CorpusShape::NUMERIC:  return "numeric";
+    case CorpusShape::INDENT:   return "indent";
+    case CorpusShape::COMMENT:  return "comment";
+    case CorpusShape::STRING:   return "string";
+    default:                    return "unknown";
+    }
+}
+
+bool corpus_shape_from_name(const std::string& name, CorpusShape& shape) {
+    for (CorpusShape s : all_corpus_shapes()) {
+        if (name == corpus_shape_name(s)) {
+            shape = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Appends the body of function number n to out
+static void write_body(std::string& out, CorpusShape shape, uint64_t n) {
+    const std::string id = std::to_string(n);
+
+    switch (shape) {
+    case CorpusShape::IDENT:
+        out += "    long accumulated_value_" + id + " = first_argument + second_argument\n";
+        out += "    accumulated_value_" + id + " = helper_function_name(accumulated_value_" + id + ", first_argument)\n";
+        out += "    unsigned int loop_counter_variable = accumulated_value_" + id + " as unsigned int\n";
+        out += "    return if accumulated_value_" + id + " then loop_counter_variable else second_argument\n";
+        break;
+
+    case CorpusShape::NUMERIC:
+        out += "    double x = 3.14159 * " + id + " + 2.71828 - 0.5 / 1024.0\n";
+        out += "    long y = 0x1F + 0xFF * " + id + " - 1234567890 + 42 * 7 - 99\n";
+        out += "    long z = 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 10 + " + id + "\n";
+        out += "    return y + z\n";
+        break;
+
+    case CorpusShape::INDENT:
+        // Climb up to 12 levels deep and back down, half with tabs and half with spaces
+        for (int depth = 1; depth <= 12; depth++)
+            out += std::string(depth, '\t') + "x = x + " + std::to_string(depth) + '\n';
+        for (int depth = 12; depth >= 1; depth--)
+            out += std::string(depth * 4, ' ') + "x = x - " + std::to_string(depth) + '\n';
+        out += "    return x\n";
+        break;
+
+    case CorpusShape::COMMENT:
+        out += "    # The first comment line of function " + id + ", it goes on for a while\n";
+        out += "    # to make sure the comment scanner has something to chew on here\n";
+        out += "    long x = first_argument  # a trailing comment after some code\n";
+        out += "    # and another full line comment before the end of the function\n";
+        out += "    return x  # done\n";
+        break;
+
+    case CorpusShape::STRING:
+        out += "    print(\"function " + id + " says hello to the string scanner\")\n";
+        out += "    print(\"a longer string literal, with some punctuation: ()[]{}+-*/ and more\")\n";
+        out += "    char c = 'x'\n";
+        out += "    char d = 'y'\n";
+        out += "    return c\n";
+        break;
+    }
+}
+
+void write_corpus(const std::string& file_name, CorpusShape shape, uint64_t size) {
+    std::ofstream file = std::ofstream(file_name, std::ios::binary);
+    if (!file.is_open())
+        salt::print_fatal(file_name + ": could not open file for writing");
+
+    file << "# generated " << corpus_shape_name(shape) << " corpus\n";
+
+    // Written out one chunk at a time, so a 1 GB corpus doesn't need 1 GB of memory
+    std::string chunk;
+    uint64_t written = 0;
+    uint64_t n = 0;
+    while (written < size) {
+        chunk.clear();
+        while (chunk.size() < 64 * 1024) {
+            chunk += "fn f" + std::to_string(n) + "(long first_argument, long second_argument) -> long:\n";
+            write_body(chunk, shape, n);
+            chunk += '\n';
+            n++;
+        }
+        file.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        written += chunk.size();
+    }
+
+    if (!file)
+        salt::print_fatal(file_name + ": could not write corpus");
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Synthetic .sl sources for the benchmarks. Every shape leans on one part of the
+// lexer, so a change that only speeds up (or slows down) that part shows up clearly.
+enum class CorpusShape {
+    IDENT,      // long identifiers, calls and keywords
+    NUMERIC,    // integer, float and hex literals
+    INDENT,     // deeply nested lines, mostly leading whitespace
+    COMMENT,    // more comment than code
+    STRING,     // string and char literals
+};
+
+// Every shape, in the order they are listed above
+const std::vector<CorpusShape>& all_corpus_shapes();
+
+const char* corpus_shape_name(CorpusShape shape);
+
+// Returns false if name isn't a shape
+bool corpus_shape_from_name(const std::string& name, CorpusShape& shape);
+
+// Writes about size bytes of the given shape to file_name. The output only depends on
+// shape and size, so the same arguments always give the same file.
+void write_corpus(const std::string& file_name, CorpusShape shape, uint64_t size);
@@ -0,0 +1,199 @@
+#include <chrono>
+#include <iostream>
+#include <functional>
+#include <filesystem>
+#include "../common.h"
+#include "../frontend/parser.h"
+#include "../frontend/types.h"
+#include "../frontend/sourcemanager.h"
+#include "benchutil.h"
+
+/*
+* Stress test for the expression parser. Generates functions with one very deep expression in them
+* (nested parentheses, long operator chains, a = b = ... = c, - - ... - x) and parses them on a thread
+* with a small stack, so anything that recurses once per level of nesting crashes instead of passing.
+* Every shape is parsed at depth/100, depth/10 and depth, ns/token should stay about the same for all three.
+* Reports JSON (or a table with --table).
+* usage: salt_expr_bench [--depth 100000] [--runs N] [--stack 1MB] [--shapes all|parens,chain,assign,unary,nested] [--dir DIR] [--table]
+*/
+
+namespace chrono = std::chrono;
+
+static const char* const ALL_SHAPES[] = { "parens", "chain", "assign", "unary", "nested" };
+
+struct ExprBenchResult {
+    std::string shape;
+    size_t depth;
+    size_t tokens;      // in the expression only
+    double seconds;
+    size_t ast_bytes;
+};
+
+// Writes a function with a single expression of the given shape, nested depth levels deep.
+// Returns how many tokens the expression has.
+static size_t write_expression_file(const std::string& file_name, const std::string& shape, size_t depth) {
+    std::string expr;
+    size_t tokens = 0;
+
+    if (shape == "parens") {            // ((((x))))
+        expr.append(depth, '(');
+        expr += 'x';
+        expr.append(depth, ')');
+        tokens = 2 * depth + 1;
+    } else if (shape == "chain") {      // x + x * x - x + ...
+        static const char* const ops[] = { " + ", " * ", " - " };
+        expr = "x";
+        for (size_t i = 0; i < depth; i++)
+            expr += std::string(ops[i % 3]) + 'x';
+        tokens = 2 * depth + 1;
+    } else if (shape == "assign") {     // x = x = ... = x, all right associative
+        expr = "x";
+        for (size_t i = 0; i < depth; i++)
+            expr += " = x";
+        tokens = 2 * depth + 1;
+    } else if (shape == "unary") {      // - - - ... x
+        for (size_t i = 0; i < depth; i++)
+            expr += "- ";
+        expr += 'x';
+        tokens = depth + 1;
+    } else if (shape == "nested") {     // (x + (x * (x - ...)))
+        static const char* const ops[] = { " + ", " * ", " - " };
+        for (size_t i = 0; i < depth; i++)
+            expr += std::string("(x") + ops[i % 3];
+        expr += 'x';
+        expr.append(depth, ')');
+        tokens = 4 * depth + 1;
+    } else {
+        salt::print_fatal("unknown expression shape \"" + shape + "\"");
+    }
+
+    std::ofstream file = std::ofstream(file_name, std::ios::binary);
+    if (!file.is_open())
+        salt::print_fatal(file_name + ": could not open file");
+    file << "fn bench(long x) -> long:\n    x = " << expr << "\n    return x\n";
+    return tokens;
+}
+
+#ifdef SALT_WINDOWS
+static Windows::DWORD WINAPI run_thread(Windows::LPVOID param) {
+    (*static_cast<std::function<void()>*>(param))();
+    return 0;
+}
+
+// Runs fn on a new thread that has only stack_size bytes of stack
+static void run_with_stack(size_t stack_size, std::function<void()> fn) {
+    Windows::HANDLE thread = Windows::CreateThread(nullptr, stack_size, run_thread, &fn, STACK_SIZE_PARAM_IS_A_RESERVATION, nullptr);
+    if (!thread)
+        salt::print_fatal("could not create the parser thread");
+    Windows::WaitForSingleObject(thread, INFINITE);
+    Windows::CloseHandle(thread);
+}
+#endif
+
+static ExprBenchResult bench_expression(const std::string& file_name, const std::string& shape, size_t depth, int runs, size_t stack_size) {
+    ExprBenchResult res = { shape, depth, write_expression_file(file_name, shape, depth), 0.0, 0 };
+
+    for (int i = 0; i < runs; i++) {
+        // Errors mean the corpus is broken, not that the parser is slow
+        SilentDiagnosticSink diagnostics;
+        AstArena arena;
+
+        auto start = chrono::steady_clock::now();
+        run_with_stack(stack_size, [&]() {
+            Parser parser = Parser(file_name, diagnostics, arena);
+            parser.parse();
+        });
+        auto end = chrono::steady_clock::now();
+        SourceManager::destroy();
+
+        if (diagnostics.has_errors())
+            salt::print_fatal(salt::f_string("%s at depth %llu did not parse", shape.c_str(), (unsigned long long) depth));
+
+        res.seconds += chrono::duration<double>(end - start).count();
+        res.ast_bytes = arena.bytes_allocated();
+    }
+
+    res.seconds /= runs;
+    return res;
+}
+
+static std::vector<std::string> parse_shapes(const std::string& str) {
+    if (str == "all")
+        return std::vector<std::string>(std::begin(ALL_SHAPES), std::end(ALL_SHAPES));
+    return split_list(str);
+}
+
+static double ns_per_token(const ExprBenchResult& res) {
+    return res.tokens ? res.seconds * 1.0e9 / res.tokens : 0.0;
+}
+
+static void print_json(const std::vector<ExprBenchResult>& results, int runs, size_t stack_size) {
+    std::vector<JsonObject> objects;
+    for (const ExprBenchResult& res : results)
+        objects.push_back(JsonObject()
+            .text("shape", res.shape)
+            .integer("depth", res.depth)
+            .integer("tokens", res.tokens)
+            .number("seconds", res.seconds, 6)
+            .number("ns_per_token", ns_per_token(res), 2)
+            .integer("ast_bytes", res.ast_bytes));
+
+    print_json(JsonObject().integer("runs", runs).integer("stack_bytes", stack_size), objects);
+}
+
+static void print_table(const std::vector<ExprBenchResult>& results, int runs, size_t stack_size) {
+    std::cout << runs << " runs, " << stack_size / 1024 << " KB of stack\n";
+    for (const ExprBenchResult& res : results)
+        std::cout << TableRow(res.shape, 8)
+            .count(res.depth, 10, "deep")
+            .count(res.tokens, 10, "tokens")
+            .number(res.seconds * 1000.0, 10, 3, "ms")
+            .number(ns_per_token(res), 8, 1, "ns/token")
+            .count(res.ast_bytes, 12, "AST bytes").str() << '\n';
+}
+
+int main(int argc, const char** argv) {
+    std::vector<std::string> shapes = parse_shapes("all");
+    std::string dir = std::filesystem::temp_directory_path().string();
+    size_t depth = 100000;
+    size_t stack_size = size_t(1) << 20;
+    bool table = false;
+    int runs = 3;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--depth" && i + 1 < argc)
+            depth = std::max<size_t>(100, std::stoull(argv[++i]));
+        else if (arg == "--runs" && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--stack" && i + 1 < argc)
+            stack_size = parse_size(argv[++i]);
+        else if (arg == "--shapes" && i + 1 < argc)
+            shapes = parse_shapes(argv[++i]);
+        else if (arg == "--dir" && i + 1 < argc)
+            dir = argv[++i];
+        else if (arg == "--table")
+            table = true;
+        else
+            salt::print_fatal("usage: salt_expr_bench [--depth 100000] [--runs N] [--stack 1MB] [--shapes all|SHAPE,...] [--dir DIR] [--table]");
+    }
+
+    salt::fill_types();
+
+    const std::string file_name = (std::filesystem::path(dir) / "salt_expr_bench.sl").string();
+    salt::file_names = { file_name };
+
+    std::vector<ExprBenchResult> results;
+    for (const std::string& shape : shapes)
+        for (size_t d : { depth / 100, depth / 10, depth })
+            results.push_back(bench_expression(file_name, shape, d, runs, stack_size));
+
+    std::filesystem::remove(file_name);
+
+    if (table)
+        print_table(results, runs, stack_size);
+    else
+        print_json(results, runs, stack_size);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+#include <chrono>
+#include <iostream>
+#include <atomic>
+#include <new>
+#include <filesystem>
+#include "../common.h"
+#include "../frontend/lexer.h"
+#include "../frontend/types.h"
+#include "../frontend/runscan.h"
+#include "corpus.h"
+#include "benchutil.h"
+
+#ifdef SALT_WINDOWS
+namespace Windows {
+#include <psapi.h>
+}
+#endif
+
+/*
+* Tokenizes .sl files with every file input mode of the Lexer, and reports tokens/sec,
+* MB/sec, allocations per token and peak RSS as JSON (or as a table with --table).
+* The files can be given on the command line, or generated with --generate.
+* usage: salt_lexer_bench [--runs N] [--table]
+*                         [--generate all|ident,numeric,indent,comment,string] [--size 16MB] [--dir DIR] [--keep]
+*                         [file1.sl file2.sl ...]
+*/
+
+namespace chrono = std::chrono;
+
+// Every allocation in the process goes through here, so we can tell how many the lexer makes
+static std::atomic<uint64_t> allocation_count = 0;
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+static uint64_t peak_rss() {
+#ifdef SALT_WINDOWS
+    Windows::PROCESS_MEMORY_COUNTERS counters;
+    if (Windows::K32GetProcessMemoryInfo(Windows::GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+#endif
+    return 0;
+}
+
+struct LexerBenchResult {
+    std::string corpus;
+    std::string file_name;
+    const char* mode;
+    uint64_t bytes;
+    size_t tokens;
+    double seconds;
+    uint64_t allocations;
+    uint64_t peak_rss;
+};
+
+static LexerBenchResult bench_file(const std::string& corpus, const std::string& file_name, uint64_t bytes,
+    LexerInputMode mode, const char* mode_name, int runs) {
+    LexerBenchResult res = { corpus, file_name, mode_name, bytes, 0, 0.0, 0, 0 };
+
+    for (int i = 0; i < runs; i++) {
+        const uint64_t allocations_before = allocation_count.load(std::memory_order_relaxed);
+        auto start = chrono::steady_clock::now();
+        {
+            Lexer lexer;
+            res.tokens = lexer.tokenize(file_name.c_str(), mode).size();
+        }
+        SourceManager::destroy();
+        auto end = chrono::steady_clock::now();
+        res.seconds += chrono::duration<double>(end - start).count();
+        res.allocations += allocation_count.load(std::memory_order_relaxed) - allocations_before;
+    }
+
+    res.allocations /= runs;
+    res.peak_rss = peak_rss();
+    return res;
+}
+
+static uint64_t file_size(const std::string& file_name) {
+    std::ifstream file = std::ifstream(file_name, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        salt::print_fatal(file_name + ": could not open file");
+    return static_cast<uint64_t>(file.tellg());
+}
+
+static uint64_t parse_corpus_size(const std::string& str) {
+    const uint64_t size = parse_size(str);
+    // Token offsets are 32 bit
+    if (size == 0 || size >= (uint64_t(4) << 30))
+        salt::print_fatal("corpus size must be more than 0 and less than 4GB");
+    return size;
+}
+
+static std::vector<CorpusShape> parse_shapes(const std::string& str) {
+    if (str == "all")
+        return all_corpus_shapes();
+
+    std::vector<CorpusShape> shapes;
+    for (const std::string& name : split_list(str)) {
+        CorpusShape shape;
+        if (!corpus_shape_from_name(name, shape))
+            salt::print_fatal("unknown corpus shape \"" + name + "\"");
+        shapes.push_back(shape);
+    }
+    return shapes;
+}
+
+static void print_json(const std::vector<LexerBenchResult>& results, int runs) {
+    std::vector<JsonObject> objects;
+    for (const LexerBenchResult& res : results) {
+        const double seconds = res.seconds > 0.0 ? res.seconds / runs : 0.0;
+        objects.push_back(JsonObject()
+            .text("corpus", res.corpus)
+            .text("file", res.file_name)
+            .text("mode", res.mode)
+            .integer("bytes", res.bytes)
+            .integer("tokens", res.tokens)
+            .number("seconds", seconds, 6)
+            .number("tokens_per_sec", seconds > 0.0 ? res.tokens / seconds : 0.0, 2)
+            .number("mb_per_sec", seconds > 0.0 ? res.bytes / seconds / 1.0e6 : 0.0, 2)
+            .number("allocs_per_token", res.tokens ? double(res.allocations) / res.tokens : 0.0, 4)
+            .integer("peak_rss_bytes", res.peak_rss));
+    }
+
+    print_json(JsonObject().text("run_scanner", run_scanner_name()).integer("runs", runs), objects);
+}
+
+static void print_table(const std::vector<LexerBenchResult>& results, int runs) {
+    std::cout << "run scanner: " << run_scanner_name() << '\n';
+    std::string last_file;
+    for (const LexerBenchResult& res : results) {
+        if (res.file_name != last_file) {
+            std::cout << res.file_name << " (" << res.bytes << " bytes, " << runs << " runs)\n";
+            last_file = res.file_name;
+        }
+        double bytes_per_sec = res.seconds > 0.0 ? double(res.bytes) * runs / res.seconds : 0.0;
+        std::cout << '\t' << TableRow(res.mode, 8)
+            .count(res.tokens, 10, "tokens")
+            .number(bytes_per_sec / 1.0e6, 12, 2, "MB/s")
+            .number(res.tokens ? double(res.allocations) / res.tokens : 0.0, 8, 3, "allocs/token").str() << '\n';
+    }
+}
+
+int main(int argc, const char** argv) {
+    std::vector<std::pair<std::string, std::string>> inputs; // corpus name, file name
+    std::vector<CorpusShape> shapes;
+    uint64_t corpus_size = uint64_t(16) << 20;
+    std::string corpus_dir = std::filesystem::temp_directory_path().string();
+    bool keep_corpora = false;
+    bool table = false;
+    int runs = 5;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--generate" && i + 1 < argc)
+            shapes = parse_shapes(argv[++i]);
+        else if (arg == "--size" && i + 1 < argc)
+            corpus_size = parse_corpus_size(argv[++i]);
+        else if (arg == "--dir" && i + 1 < argc)
+            corpus_dir = argv[++i];
+        else if (arg == "--keep")
+            keep_corpora = true;
+        else if (arg == "--table")
+            table = true;
+        else
+            inputs.push_back({ arg, arg });
+    }
+
+    if (inputs.empty() && shapes.empty())
+        salt::print_fatal("usage: salt_lexer_bench [--runs N] [--table] [--generate all|SHAPE,...] [--size 16MB] [--dir DIR] [--keep] [file1.sl ...]");
+
+    salt::fill_types();
+
+    std::vector<std::string> generated;
+    for (CorpusShape shape : shapes) {
+        const std::string file_name = (std::filesystem::path(corpus_dir) / (std::string("salt_corpus_") + corpus_shape_name(shape) + ".sl")).string();
+        write_corpus(file_name, shape, corpus_size);
+        inputs.push_back({ corpus_shape_name(shape), file_name });
+        generated.push_back(file_name);
+    }
+
+    const std::pair<LexerInputMode, const char*> modes[] = {
+        { LexerInputMode::LEXER_INPUT_MODE_FILE, "stream" },
+        { LexerInputMode::LEXER_INPUT_MODE_BUFFER, "buffer" },
+    };
+
+    std::vector<LexerBenchResult> results;
+    for (const auto& input : inputs) {
+        salt::file_names = { input.second };
+        const uint64_t bytes = file_size(input.second);
+        for (const auto& mode : modes)
+            results.push_back(bench_file(input.first, input.second, bytes, mode.first, mode.second, runs));
+    }
+
+    if (!keep_corpora)
+        for (const std::string& file_name : generated)
+            std::filesystem::remove(file_name);
+
+    if (table)
+        print_table(results, runs);
+    else
+        print_json(results, runs);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,335 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <filesystem>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+#include "../common.h"
+#include "../frontend/parser.h"
+#include "../frontend/astvisitor.h"
+#include "../frontend/types.h"
+#include "../frontend/sourcemanager.h"
+#include "benchutil.h"
+
+/*
+* Parser throughput. Generates programs that each stress one thing (lots of functions, long bodies, many
+* arguments, deep expressions, fresh identifiers everywhere), tokenizes them up front and times only
+* Parser::parse(), which doesn't generate any code. Reports functions/sec, AST nodes/sec and arena bytes
+* per node as JSON (or a table with --table).
+* With --compare, the results are checked against the JSON of an earlier run: anything that got more than
+* --tolerance percent slower, or uses more bytes per node, is a regression and makes the exit code 1.
+* usage: salt_parser_bench [--runs N] [--scale F] [--programs all|NAME,...] [--dir DIR] [--table]
+*                          [--compare old.json] [--tolerance 5]
+*/
+
+namespace chrono = std::chrono;
+
+struct ProgramShape {
+    const char* name;
+    size_t functions;
+    size_t body_length;     // statements per function, not counting the return
+    size_t args;            // per function
+    size_t depth;           // how deeply every expression is nested
+    double reuse;           // how often a statement assigns to an existing variable instead of declaring a new one
+};
+
+static const ProgramShape ALL_PROGRAMS[] = {
+    { "baseline",       2000,   8,      2,  3,  0.5 },
+    { "many_functions", 20000,  1,      1,  1,  0.5 },
+    { "long_bodies",    100,    400,    2,  3,  0.5 },
+    { "many_args",      2000,   8,      16, 3,  0.5 },
+    { "deep_exprs",     500,    8,      2,  48, 0.5 },
+    { "fresh_idents",   2000,   8,      2,  3,  0.0 },
+    { "reused_idents",  2000,   8,      2,  3,  1.0 },
+};
+
+struct ParserBenchResult {
+    std::string program;
+    size_t functions;
+    size_t tokens;
+    size_t nodes;
+    size_t ast_bytes;
+    double seconds;
+};
+
+// Same numbers every time, so every run parses exactly the same program
+class ProgramRng {
+private:
+    uint64_t state_;
+public:
+    ProgramRng(uint64_t seed) : state_(seed) {}
+    uint32_t next() {
+        state_ = state_ * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<uint32_t>(state_ >> 33);
+    }
+    size_t below(size_t n) { return n ? next() % n : 0; }
+    double unit() { return next() / 2147483648.0; }
+};
+
+// A variable, a number or a call to the previous function
+static void write_operand(std::string& out, ProgramRng& rng, const std::vector<std::string>& vars,
+    const std::string& callee, size_t args) {
+    const size_t pick = rng.below(10);
+    if (pick == 0) {
+        out += std::to_string(rng.below(1000));
+    } else if (pick == 1 && !callee.empty()) {
+        out += callee + '(';
+        for (size_t i = 0; i < args; i++)
+            out += (i ? ", " : "") + vars[rng.below(vars.size())];
+        out += ')';
+    } else {
+        out += vars[rng.below(vars.size())];
+    }
+}
+
+// An expression nested depth levels deep, built inside out so deep ones don't need a deep stack here either
+static std::string make_expression(ProgramRng& rng, size_t depth, const std::vector<std::string>& vars,
+    const std::string& callee, size_t args) {
+    static const char* const ops[] = { " + ", " - ", " * " };
+    std::string expr;
+    write_operand(expr, rng, vars, callee, args);
+
+    for (size_t level = 0; level < depth; level++) {
+        std::string operand;
+        write_operand(operand, rng, vars, callee, args);
+        const char* op = ops[rng.below(3)];
+        expr = level % 2 ? '(' + expr + op + operand + ')' : '(' + operand + op + expr + ')';
+    }
+    return expr;
+}
+
+// Writes the program and returns how many functions it has
+static size_t write_program(const std::string& file_name, const ProgramShape& shape, double scale) {
+    const size_t functions = std::max<size_t>(1, static_cast<size_t>(std::llround(shape.functions * scale)));
+    ProgramRng rng = ProgramRng(functions * 31 + shape.body_length);
+    std::string out;
+    std::vector<std::string> vars;
+
+    for (size_t fn = 0; fn < functions; fn++) {
+        const std::string id = std::to_string(fn);
+        vars.clear();
+
+        out += "fn function_" + id + '(';
+        for (size_t i = 0; i < shape.args; i++) {
+            vars.push_back("arg_" + std::to_string(i));
+            out += (i ? ", long " : "long ") + vars.back();
+        }
+        out += ") -> long:\n";
+
+        // Every function calls the one before it, which is always declared with the same arguments
+        const std::string callee = fn > 0 && shape.args > 0 ? "function_" + std::to_string(fn - 1) : "";
+        if (vars.empty())
+            vars.push_back("local_" + id + "_0");
+
+        for (size_t stmt = 0; stmt < shape.body_length; stmt++) {
+            const std::string expr = make_expression(rng, shape.depth, vars, callee, shape.args);
+            if (stmt > 0 && rng.unit() < shape.reuse) {
+                out += "    " + vars[rng.below(vars.size())] + " = " + expr + '\n';
+            } else {
+                // Unique in the whole file, so every one of these is new to the interner
+                vars.push_back("local_" + id + '_' + std::to_string(stmt + 1));
+                out += "    long " + vars.back() + " = " + expr + '\n';
+            }
+        }
+        out += "    return " + vars.back() + "\n\n";
+    }
+
+    std::ofstream file = std::ofstream(file_name, std::ios::binary);
+    if (!file.is_open())
+        salt::print_fatal(file_name + ": could not open file");
+    file << out;
+    return functions;
+}
+
+class NodeCounter : public ExprVisitor<NodeCounter> {
+public:
+    size_t nodes = 0;
+    void visit_expr(Expression) { nodes++; }
+};
+
+// Every node of every function, declarations and arguments included
+static size_t count_nodes(const TranslationUnitAST& unit) {
+    NodeCounter counter;
+    size_t nodes = unit.declarations.size();
+    for (FunctionAST* fn : unit.functions) {
+        nodes += 2 + fn->decl()->args().size(); // the function and its declaration
+        for (Expression expr : fn->body())
+            counter.visit_tree(expr);
+    }
+    return nodes + counter.nodes;
+}
+
+static ParserBenchResult bench_program(const std::string& file_name, const ProgramShape& shape, double scale, int runs) {
+    ParserBenchResult res = { shape.name, write_program(file_name, shape, scale), 0, 0, 0, 0.0 };
+
+    for (int i = 0; i < runs; i++) {
+        // Any error means the generator is broken, so they are only counted
+        SilentDiagnosticSink diagnostics;
+        AstArena arena;
+        {
+            // whole_file, so all the lexing is done before the clock starts
+            Parser parser = Parser(file_name, diagnostics, arena, true);
+            res.tokens = parser.tokens().buffered(); // EOF included
+
+            auto start = chrono::steady_clock::now();
+            parser.parse();
+            auto end = chrono::steady_clock::now();
+
+            res.seconds += chrono::duration<double>(end - start).count();
+            res.nodes = count_nodes(parser.unit());
+            res.ast_bytes = arena.bytes_allocated();
+        }
+        SourceManager::destroy();
+
+        if (diagnostics.has_errors())
+            salt::print_fatal(shape.name + std::string(" did not parse, the generator is broken"));
+    }
+
+    res.seconds /= runs;
+    return res;
+}
+
+static double per_sec(size_t count, double seconds) {
+    return seconds > 0.0 ? count / seconds : 0.0;
+}
+
+static double bytes_per_node(const ParserBenchResult& res) {
+    return res.nodes ? double(res.ast_bytes) / res.nodes : 0.0;
+}
+
+static std::vector<ProgramShape> parse_programs(const std::string& str) {
+    if (str == "all")
+        return std::vector<ProgramShape>(std::begin(ALL_PROGRAMS), std::end(ALL_PROGRAMS));
+
+    std::vector<ProgramShape> programs;
+    for (const std::string& name : split_list(str)) {
+        auto it = std::find_if(std::begin(ALL_PROGRAMS), std::end(ALL_PROGRAMS), [&name](const ProgramShape& p) { return name == p.name; });
+        if (it == std::end(ALL_PROGRAMS))
+            salt::print_fatal("unknown program \"" + name + "\"");
+        programs.push_back(*it);
+    }
+    return programs;
+}
+
+static void print_json(const std::vector<ParserBenchResult>& results, int runs, double scale) {
+    std::vector<JsonObject> objects;
+    for (const ParserBenchResult& res : results)
+        objects.push_back(JsonObject()
+            .text("program", res.program)
+            .integer("functions", res.functions)
+            .integer("tokens", res.tokens)
+            .integer("nodes", res.nodes)
+            .number("seconds", res.seconds, 6)
+            .number("functions_per_sec", per_sec(res.functions, res.seconds), 2)
+            .number("nodes_per_sec", per_sec(res.nodes, res.seconds), 2)
+            .number("tokens_per_sec", per_sec(res.tokens, res.seconds), 2)
+            .integer("ast_bytes", res.ast_bytes)
+            .number("bytes_per_node", bytes_per_node(res), 2));
+
+    print_json(JsonObject().integer("runs", runs).number("scale", scale), objects);
+}
+
+static void print_table(const std::vector<ParserBenchResult>& results, int runs, double scale) {
+    std::cout << runs << " runs, scale " << scale << '\n';
+    for (const ParserBenchResult& res : results)
+        std::cout << TableRow(res.program, 16)
+            .count(res.functions, 8, "fns")
+            .count(res.nodes, 10, "nodes")
+            .number(res.seconds * 1000.0, 10, 3, "ms")
+            .number(per_sec(res.functions, res.seconds), 12, 0, "fns/s")
+            .number(per_sec(res.nodes, res.seconds), 12, 0, "nodes/s")
+            .number(bytes_per_node(res), 8, 2, "bytes/node").str() << '\n';
+}
+
+// Prints how every program did compared to the old run, returns how many regressed
+static int compare(const std::vector<ParserBenchResult>& results, const std::string& old_file, double tolerance) {
+    std::ifstream file = std::ifstream(old_file);
+    if (!file.is_open())
+        salt::print_fatal(old_file + ": could not open file");
+
+    int regressions = 0;
+    std::string line;
+    std::cout << std::defaultfloat << "compared to " << old_file << " (tolerance " << tolerance << "%)\n";
+    while (std::getline(file, line)) {
+        const std::string program = json_string(line, "program");
+        auto res = std::find_if(results.begin(), results.end(), [&program](const ParserBenchResult& r) { return r.program == program; });
+        if (program.empty() || res == results.end())
+            continue;
+
+        if (json_number(line, "functions") != double(res->functions)) {
+            std::cout << std::left << std::setw(16) << program << std::right << "  not the same program (other --scale?), skipped\n";
+            continue;
+        }
+
+        const double old_speed = json_number(line, "nodes_per_sec");
+        const double old_bytes = json_number(line, "bytes_per_node");
+        const double speed_change = old_speed > 0.0 ? (per_sec(res->nodes, res->seconds) / old_speed - 1.0) * 100.0 : 0.0;
+        // Rounded like the JSON, or the last digit looks like a change
+        const double bytes_change = std::round(bytes_per_node(*res) * 100.0) / 100.0 - old_bytes;
+
+        // Bytes per node don't depend on the machine, so any growth is a real change
+        const bool slower = speed_change < -tolerance;
+        const bool bigger = bytes_change > 0.005;
+        regressions += slower || bigger;
+
+        std::cout << std::left << std::setw(16) << program << std::right
+            << std::showpos << std::fixed << std::setprecision(1)
+            << std::setw(8) << speed_change << "% nodes/s "
+            << std::setw(8) << std::setprecision(2) << bytes_change << " bytes/node" << std::noshowpos
+            << (slower ? "  SLOWER" : "") << (bigger ? "  BIGGER" : "") << '\n';
+    }
+    return regressions;
+}
+
+int main(int argc, const char** argv) {
+    std::vector<ProgramShape> programs = parse_programs("all");
+    std::string dir = std::filesystem::temp_directory_path().string();
+    std::string compare_file;
+    double tolerance = 5.0;
+    double scale = 1.0;
+    bool table = false;
+    int runs = 5;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--scale" && i + 1 < argc)
+            scale = std::max(0.001, std::atof(argv[++i]));
+        else if (arg == "--programs" && i + 1 < argc)
+            programs = parse_programs(argv[++i]);
+        else if (arg == "--dir" && i + 1 < argc)
+            dir = argv[++i];
+        else if (arg == "--compare" && i + 1 < argc)
+            compare_file = argv[++i];
+        else if (arg == "--tolerance" && i + 1 < argc)
+            tolerance = std::atof(argv[++i]);
+        else if (arg == "--table")
+            table = true;
+        else
+            salt::print_fatal("usage: salt_parser_bench [--runs N] [--scale F] [--programs all|NAME,...] [--dir DIR] [--table] [--compare old.json] [--tolerance 5]");
+    }
+
+    salt::fill_types();
+
+    const std::string file_name = (std::filesystem::path(dir) / "salt_parser_bench.sl").string();
+    salt::file_names = { file_name };
+
+    std::vector<ParserBenchResult> results;
+    for (const ProgramShape& program : programs)
+        results.push_back(bench_program(file_name, program, scale, runs));
+
+    std::filesystem::remove(file_name);
+
+    if (table || !compare_file.empty())
+        print_table(results, runs, scale);
+    else
+        print_json(results, runs, scale);
+
+    if (!compare_file.empty() && compare(results, compare_file, tolerance) > 0)
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
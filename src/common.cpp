@@ -1,11 +1,17 @@
 #include "common.h"
 #include <limits.h>
 #include <cstdarg>
+#include <filesystem>
 #include "frontend/miniregex.h"
 #include "frontend/tokens.h"
 #include "frontend/ast.h"
 
 int salt::WARNING_LEVEL = 255;
+
+#ifndef SALT_BUILD_ID
+#define SALT_BUILD_ID ""
+#endif
+const char* const salt::BUILD_ID = SALT_BUILD_ID;
 using namespace salt;
 
 // Global variables
@@ -138,10 +144,64 @@ std::string salt::f_string(const char* format, ...) {
 	return str;
 }
 
+uint64_t salt::hash_bytes(const void* data, size_t size, uint64_t seed) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t res = seed;
+	for (size_t i = 0; i < size; i++) {
+		res ^= bytes[i];
+		res *= 0x100000001b3ull;
+	}
+	return res;
+}
+
+bool salt::read_file(const std::string& file_name, std::string& out) {
+	std::ifstream file = std::ifstream(file_name, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return false;
+
+	const std::streamoff size = file.tellg();
+	if (size < 0)
+		return false;
+
+	out.resize(static_cast<size_t>(size));
+	file.seekg(0);
+	return static_cast<bool>(file.read(out.data(), size));
+}
+
+bool salt::write_file_atomic(const std::string& file_name, const std::string& data) {
+	std::error_code err;
+	const std::filesystem::path dir = std::filesystem::path(file_name).parent_path();
+	if (!dir.empty())
+		std::filesystem::create_directories(dir, err);
+
+	const std::string tmp_name = file_name + ".tmp";
+	{
+		std::ofstream file = std::ofstream(tmp_name, std::ios::binary | std::ios::trunc);
+		if (!file.is_open() || !file.write(data.data(), data.size()))
+			return false;
+	}
+
+	std::filesystem::rename(tmp_name, file_name, err);
+	if (err) {
+		std::filesystem::remove(tmp_name, err);
+		return false;
+	}
+	return true;
+}
+
 void salt::print_colored(const std::string& str, const TextColor tc) {
 	std::cout << tc << str << Color::WHITE;
 }
 
+std::string salt::Error::str(const std::string& file_name) const {
+	std::string res;
+	if (!file_name.empty())
+		res += file_name + " - ";
+	if (has_location())
+		res += std::to_string(line_) + ':' + std::to_string(col_) + ": ";
+	return res + message_;
+}
+
 void salt::print_warning(const std::string& str, int min_warning_level) {
 	if (min_warning_level > salt::WARNING_LEVEL)
 		return;
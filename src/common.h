@@ -7,6 +7,9 @@
 #include <limits>
 #include <cstdlib>
 #include <fstream>
+#include <cstdint>
+#include <variant>
+#include <memory>
 
 class Token;
 class ExprAST;
@@ -43,6 +46,11 @@ namespace salt {
     const std::string& get_current_file_name();
 
     extern int WARNING_LEVEL;
+
+    // A hash of every source file of this compiler, set by CMake (empty if it wasn't).
+    // What is cached on disk is keyed on it, so nothing made by another version of the compiler gets used
+    extern const char* const BUILD_ID;
+
     class TextColor; // defined below
 
     class Exception : public std::exception {
@@ -116,6 +124,16 @@ namespace salt {
 
     std::string reverse(const std::string& s);
     std::string f_string(const char* format, ...);
+
+    // 64 bit FNV-1a. Pass the hash of the previous piece as seed to hash several pieces as one
+    uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+    // The whole file in one read, false if it couldn't be read
+    bool read_file(const std::string& file_name, std::string& out);
+
+    // Writes data to a temporary file and renames it to file_name (making its directory if needed),
+    // so nobody ever reads half a file. False if that didn't work, then file_name is left alone
+    bool write_file_atomic(const std::string& file_name, const std::string& data);
     long long llrand();
 
 
@@ -145,108 +163,111 @@ namespace salt {
 
     
 
-    /// @todo: maybe one day make a better Result class
+    // What kind of thing went wrong, so code can tell errors apart without reading the message
+    enum class ErrorCode : uint8_t {
+        GENERIC = 0,
+        SYNTAX,
+        TYPE,
+        INTERNAL,
+        LIMIT,      // ran out of something there is only so much of, like the steps a const fn may take
+    };
+
+    /*
+    * An error that is cheap to make and to pass around: a code, a message and where it happened.
+    * A const char* message is not copied, so it must be a string literal or live as long as the program does.
+    * The few messages that are put together at runtime are passed as a std::string, which every copy of the
+    * Error shares. It only gets put together with the file name and location when printed, see str().
+    */
+    class Error {
+    private:
+        std::shared_ptr<const std::string> owned_message_;  // null unless the message was a std::string
+        const char* message_;
+        uint32_t line_;         // 0 if we don't know where it happened
+        uint32_t col_;
+        ErrorCode code_;
+
+    public:
+        Error(const char* message, ErrorCode code = ErrorCode::GENERIC, uint32_t line = 0, uint32_t col = 0) :
+            message_(message), line_(line), col_(col), code_(code) {}
+        Error(std::string message, ErrorCode code = ErrorCode::GENERIC, uint32_t line = 0, uint32_t col = 0) :
+            owned_message_(std::make_shared<const std::string>(std::move(message))),
+            message_(owned_message_->c_str()), line_(line), col_(col), code_(code) {}
+
+        // The same error, somewhere else
+        Error at(uint32_t line, uint32_t col) const {
+            Error res = *this;
+            res.line_ = line;
+            res.col_ = col;
+            return res;
+        }
+
+        const char* message() const     { return message_; }
+        uint32_t line() const           { return line_; }
+        uint32_t col() const            { return col_; }
+        ErrorCode code() const          { return code_; }
+        bool has_location() const       { return line_ != 0; }
+
+        // "file_name - line:col: message", leaving out whatever we don't know
+        std::string str(const std::string& file_name = "") const;
+    };
+
     /* 
-    * A class that represents either a successful operation or an exception.
-    * Allows a function to either return a literal T or a literal Exception instead of throwing it.
+    * A class that represents either a successful operation or an Error.
+    * Allows a function to either return a literal T or a literal Error instead of throwing it.
     * Additionally, evaluates to True iff the Result contains a T, or False otherwise.
     * This allows for if (Result res = ...) expressions.
+    * Only one of the two is ever stored (in place), so a successful Result costs about as much as the T itself.
     */
-
     template <typename T>
     class Result {
     private:
-        std::unique_ptr<T> success_;
-        salt::Exception fail_;
-        bool is_ok_;
-        bool is_initialized_;
-    public:
-        Result(Result_e result, T&& success) {
-            success_ = std::make_unique<T>(std::forward<T>(success));
-            is_ok_ = result == Result_e::OK;
-            is_initialized_ = true;
-            fail_ = "Uninitialized exception in Result";
-        }
+        std::variant<std::monostate, T, Error> data_; // monostate if uninitialized
 
-        Result(T&& success) : fail_("Uninitialized exception in Result") {
-            success_ = std::make_unique<T>(std::forward<T>(success));
-            is_ok_ = true;
-            is_initialized_ = true;
+    public:
+        Result(Result_e result, T&& success) : data_(std::in_place_index<1>, std::move(success)) {
+            if (result != Result_e::OK)
+                print_fatal("tried to make an error Result out of a value");
         }
 
-        Result(Exception&& fail) : fail_(fail){
-            success_ = nullptr;
-            is_ok_ = false;
-            is_initialized_ = true;
-        }
+        Result(T&& success) : data_(std::in_place_index<1>, std::move(success)) {}
 
-        /*
-        Result(Result_e result, const T&& success) {
-            success_ = std::make_unique<T>(success);
-            is_ok_ = result == Result_e::OK;
-            is_initialized_ = true;
-        }
-        */
-
-        Result(Result_e result, Exception&& fail) {
-            success_ = nullptr;
-            fail_ = fail;
-            is_ok_ = false;
-            is_initialized_ = true;
-        }
+        Result(Error fail) : data_(std::in_place_index<2>, fail) {}
 
-        Result(Result_e result, const Exception& fail) {
-            success_ = nullptr;
-            fail_ = fail;
-            is_ok_ = false;
-            is_initialized_ = true;
+        Result(Result_e result, Error fail) : data_(std::in_place_index<2>, fail) {
+            if (result != Result_e::ERR)
+                print_fatal("tried to make an ok Result out of an error");
         }
 
-        Result() {
-            success_ = nullptr;
-            is_initialized_ = false;
-        }
-        
-        // Trying to use this function gives me a severe brain ache
-        // If you get a memory.h line 3465 bug, this is the culprit
-        Result(const Result& res) {
-            is_ok_ = res.is_ok_;
-            is_initialized_ = res.is_initialized_;
-            if (res.is_initialized_) {
-                success_ = res.success_ ? std::make_unique<T>(*res.success_) : nullptr;
-                fail_ = res.fail_;
-            }
-            
-        }
+        Result() {}
 
-        bool is_ok() const noexcept { return is_ok_; }
+        bool is_ok() const noexcept { return data_.index() == 1; }
         operator bool() const noexcept { return is_ok(); }
 
         T unwrap() {
-            if (!is_initialized_)
+            if (T* success = std::get_if<1>(&data_))
+                return std::move(*success);
+            else if (const Error* fail = std::get_if<2>(&data_))
+                print_fatal(std::string("Tried to unwrap error: ") + fail->str());
+            else
                 print_fatal("tried to use uninitialized Result");
-            if (is_ok()) 
-                return std::move(*success_); 
-            else 
-                print_fatal(std::string("Tried to unwrap exception: ") + fail_.what()); 
         }
 
         T unwrap_or(T&& default_value) {
-            if (!is_initialized_)
+            if (data_.index() == 0)
                 print_fatal("tried to use uninitialized Result");
-            if (is_ok()) 
-                return std::move(*success_); 
-            else 
-                return default_value; 
+            if (T* success = std::get_if<1>(&data_))
+                return std::move(*success);
+            else
+                return default_value;
         }
 
-        salt::Exception&& unwrap_err() {
-            if (!is_initialized_)
+        Error unwrap_err() const {
+            if (const Error* fail = std::get_if<2>(&data_))
+                return *fail;
+            else if (is_ok())
+                print_fatal("tried to call unwrap_err() on an ok value");
+            else
                 print_fatal("tried to use uninitialized Result");
-            if (!is_ok()) 
-                return std::move(fail_); 
-            else 
-                print_fatal("tried to call unwrap_err() on an ok value"); 
         }
 
     };
@@ -254,41 +275,29 @@ namespace salt {
     template <>
     class Result<void> {
     private:
-        salt::Exception fail_;
+        Error fail_;
         bool is_ok_;
     public:
-        Result(void) : fail_("Uninitialized exception in Result<void>") {
-            is_ok_ = true;
-        }
+        Result(void) : fail_(""), is_ok_(true) {}
 
-        Result(Result_e res) : fail_("Unknown exception in Result<void>") {
+        Result(Result_e res) : fail_(""), is_ok_(true) {
             if (res != Result_e::OK)
                 print_fatal("Invalid initialization of Result<void>");
-            is_ok_ = true;
         }
 
-        Result(Exception&& fail) : fail_(fail) {
-            is_ok_ = false;
-        }
-
-        Result(const Exception& fail) : fail_(fail) {
-            is_ok_ = false;
-        }
-
-        // Trying to use this function gives me a severe brain ache
-        // If you get a memory.h line 3465 bug, this is the culprit
+        Result(Error fail) : fail_(fail), is_ok_(false) {}
 
         bool is_ok() const noexcept { return is_ok_; }
         operator bool() const noexcept { return is_ok(); }
 
         void unwrap() {
             if (!is_ok())
-                print_fatal(std::string("Tried to unwrap exception: ") + fail_.what());
+                print_fatal(std::string("Tried to unwrap error: ") + fail_.str());
         }
 
-        salt::Exception&& unwrap_err() {
+        Error unwrap_err() const {
             if (!is_ok())
-                return std::move(fail_);
+                return fail_;
             else
                 print_fatal("tried to call unwrap_err() on an ok value");
         }
@@ -297,7 +306,6 @@ namespace salt {
 
     
 
-
     #ifdef SALT_WINDOWS
     enum class Color : Windows::WORD {
         BLACK = 0,
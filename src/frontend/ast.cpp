@@ -2,87 +2,111 @@
 #include <sstream>
 #include "../common.h"
 #include "irgenerator.h"
+#include "functioncache.h"
+#include "sourcemanager.h"
 #include "types.h"
 
 #define ASTCNDEBUG
-#define RET_POISON_WITH_ERROR(type) do {\
-    print_error(f_string("unsupported operation for `%s` type (line %d at function %s in compiler)", type->name.c_str(), __LINE__, __FUNCTION__));\
-    return get_poison_value(type);\
-} while (0)
-
-#define RET_POISON_WITH_ERROR_VAL(val) do {\
-    print_error_at(val.get(), f_string("unsupported operation for `%s` type (line %d at function %s in compiler)", val->type()->name.c_str(), __LINE__, __FUNCTION__));\
-    return get_poison_value(val->type());\
-} while (0)
-
-#define RET_POISON_WITH_ERROR_MSG(type, error) do {\
-    print_error(error);\
-    return get_poison_value(type);\
-} while (0)
 
 using namespace salt;
 
-static llvm::Value* my_get_poison_value(const llvm::Type* type) {
-    IRGenerator* gen = IRGenerator::get();
-    if (type == llvm::Type::getVoidTy(*gen->context))
-        return llvm::PoisonValue::get(llvm::Type::getInt64Ty(*gen->context));
-
-    return llvm::PoisonValue::get(const_cast<llvm::Type*>(type));
-}
-
-static llvm::Value* get_poison_value(const salt::Type* type) {
-    return my_get_poison_value(type->get());
-}
-
 // Make the variable printable with salt::to_string (for vectors).
 std::ostream& operator<<(std::ostream& os, const VariableExprAST& var) {
     os << "Variable (type: " << var.type()->name << ", name: " << var.name() << ')';
     return os;
 }
 
+// line_ is still the offset of the token, the SourceManager turns it into a line and col
+void ExprAST::look_up_location() const {
+    const uint32_t offset = static_cast<uint32_t>(this->line_);
+    const SourceManager* sources = SourceManager::get();
+    this->line_ = sources->line(offset);
+    this->col_ = sources->col(offset);
+}
+
 std::string ExprAST::ast_type() const {
-    std::string my_type = "unknown type??";
-    if (is_binary())
-        my_type = "binary expr";
-    else if (is_val())
-        my_type = "val expr";
-    else if (this->is_variable())
-        my_type = "variable expr";
-    else if (this->is_type())
-        my_type = "type expr";
-    else if (this->is_return())
-        my_type = "return expr";
-    else if (this->is_call())
-        my_type = "call expr";
-    else if (this->is_if())
-        my_type = "if expr";
-    else if (this->is_deref())
-        my_type = "deref expr";
-
-    return my_type;
+    switch (kind()) {
+    case ExprKind::Val:             return "val expr";
+    case ExprKind::Variable:        return "variable expr";
+    case ExprKind::Binary:          return "binary expr";
+    case ExprKind::Unary:           return "unary expr";
+    case ExprKind::Call:            return "call expr";
+    case ExprKind::If:              return "if expr";
+    case ExprKind::Repeat:          return "repeat expr";
+    case ExprKind::Type:            return "type expr";
+    case ExprKind::Deref:           return "deref expr";
+    case ExprKind::Return:          return "return expr";
+    case ExprKind::NewVariable:     return "new variable expr";
+    case ExprKind::ImplicitCast:    return "implicit cast";
+    }
+    return "unknown type??";
+}
+
+void ExprAST::children(std::vector<Expression>& out) const {
+    switch (kind()) {
+    case ExprKind::Binary: {
+        const BinaryExprAST* binary = static_cast<const BinaryExprAST*>(this);
+        out.push_back(binary->lhs());
+        out.push_back(binary->rhs());
+        break;
+    }
+    case ExprKind::Unary:
+        out.push_back(static_cast<const UnaryExprAST*>(this)->operand());
+        break;
+    case ExprKind::Call: {
+        AstList<Expression> args = static_cast<const CallExprAST*>(this)->args();
+        out.insert(out.end(), args.begin(), args.end());
+        break;
+    }
+    case ExprKind::If: {
+        const IfExprAST* if_expr = static_cast<const IfExprAST*>(this);
+        out.insert(out.end(), { if_expr->condition_, if_expr->true_expr_, if_expr->false_expr_ });
+        break;
+    }
+    case ExprKind::Repeat: {
+        const RepeatAST* repeat = static_cast<const RepeatAST*>(this);
+        out.push_back(repeat->loop_until_expr_);
+        out.push_back(repeat->loop_body_);
+        break;
+    }
+    case ExprKind::Deref:
+        out.push_back(static_cast<const DerefExprAST*>(this)->expr_);
+        break;
+    case ExprKind::Return:
+        out.push_back(static_cast<const ReturnAST*>(this)->return_val);
+        break;
+    case ExprKind::NewVariable: {
+        const NewVariableAST* new_var = static_cast<const NewVariableAST*>(this);
+        out.push_back(new_var->var_);
+        out.push_back(new_var->value_);
+        break;
+    }
+    case ExprKind::ImplicitCast:
+        out.push_back(static_cast<const ImplicitCastExprAST*>(this)->operand_);
+        break;
+    default:
+        break; // leaves
+    }
 }
 
 
-ValExprAST::ValExprAST(const Token& tok, int64_t val, TypeInstance ti) {
-    this->col_ = tok.col();
-    this->line_ = tok.line();
+ValExprAST::ValExprAST(const Token& tok, int64_t val, TypeInstance ti) : ExprAST(ExprKind::Val) {
+    set_location(tok);
     this->val_.i64 = val;
     this->ti_ = ti;
 }
 
-ValExprAST::ValExprAST(const Token& tok, double val, TypeInstance ti) {
-    this->col_ = tok.col();
-    this->line_ = tok.line();
+ValExprAST::ValExprAST(const Token& tok, double val, TypeInstance ti) : ExprAST(ExprKind::Val) {
+    set_location(tok);
     this->val_.f64 = val;
     this->ti_ = ti;
 }
 
-ValExprAST::ValExprAST(const Token& tok, std::string str, TypeInstance ti) {
-    this->col_ = tok.col();
-    this->line_ = tok.line();
+ValExprAST::ValExprAST(const Token& tok, Symbol str, TypeInstance ti) : ExprAST(ExprKind::Val) {
+    set_location(tok);
     this->val_.i64 = 0;
     this->ti_ = ti;
-    this->data_ = str;
+    this->str_ = str;
 }
 
 int64_t ValExprAST::to_int() const {
@@ -93,73 +117,42 @@ double ValExprAST::to_double() const {
     return val_.f64;
 }
 
-VariableExprAST::VariableExprAST(const Token& tok, TypeInstance ti) : name_(tok.data()) {
-    this->col_ = tok.col();
-    this->line_ = tok.line();
+VariableExprAST::VariableExprAST(const Token& tok, TypeInstance ti) : ExprAST(ExprKind::Variable), name_(tok.interned()) {
+    set_location(tok);
     this->ti_ = ti;
     if (!ti_)
         ti_ = SALT_TYPE_ERROR;
     if (tok.val() != TOK_IDENT) {
-        print_error_at(this, f_string("Cannot create variable from token %s with data `%s`, expected identifier (TOK_IDENT)", tok.str().c_str(), tok.data().c_str()));
+        print_error_at(this, f_string("Cannot create variable from token %s with data `%s`, expected identifier (TOK_IDENT)", tok.str().c_str(), std::string(tok.data()).c_str()));
     }
 }
 
-const std::string& VariableExprAST::name() const {
+Symbol VariableExprAST::name() const {
     return name_;
 }
 
 
-BinaryExprAST::BinaryExprAST(const Token& tok, Expression lhs, Expression rhs) {
+BinaryExprAST::BinaryExprAST(const Token& tok, Expression lhs, Expression rhs) : ExprAST(ExprKind::Binary) {
     this->op_ = tok.val();
-    this->lhs_ = std::move(lhs);
-    this->rhs_ = std::move(rhs);
-    this->col_ = lhs_->col();
-    this->line_ = lhs_->line();
-    
-    // type promotion: the BinaryExpr will have the size of the largest of the types, if an implicit conversion is possible
-    // however, if this is an explicit cast, then this expr will always have the same type as the rhs
-
-    if (this->op_ == TOK_AS) {
-        this->ti_ = rhs_->type_instance();
-        goto end_constructor;
-    }
-
-    bool any_error_ty = false;
-
-    this->ti_ = lhs_->type_instance();
-    if (ti_.type->rank <= 1) {
-        this->ti_ = SALT_TYPE_ERROR;
-        any_error_ty = true;
-    }
-
-    const salt::Type* rhs_type = rhs_->type();
-    if (rhs_type->rank <= 1) {
-        this->ti_ = SALT_TYPE_ERROR;
-        any_error_ty = true;
-    }
-
-    if (rhs_type->rank > this->ti_.type->rank && !any_error_ty) {
-        this->ti_ = rhs_->type_instance();
-    }
-
+    this->lhs_ = lhs;
+    this->rhs_ = rhs;
+    copy_location(lhs_);
+}
 
-    end_constructor:
-        salt::dboutv << f_string("Created new BinExprAST with %s x %s -> %s\n", lhs_->type()->name, rhs_->type()->name, this->ti_.type->name);
-    
+UnaryExprAST::UnaryExprAST(const Token& op, Expression operand) : ExprAST(ExprKind::Unary), op_(op.val()), operand_(operand) {
+    set_location(op);
 }
 
-IfExprAST::IfExprAST(const Token& if_tok, Expression cond, Expression true_expr, Expression false_expr, TypeInstance ti) : 
-    condition_(std::move(cond)), true_expr_(std::move(true_expr)), false_expr_(std::move(false_expr)) {
-    this->ti_ = ti;
-    this->line_ = if_tok.line();
-    this->col_ = if_tok.col();
+IfExprAST::IfExprAST(const Token& if_tok, Expression cond, Expression true_expr, Expression false_expr) :
+    ExprAST(ExprKind::If), condition_(cond), true_expr_(true_expr), false_expr_(false_expr) {
+    set_location(if_tok);
 }
 
-const Expression& BinaryExprAST::lhs() const {
+Expression BinaryExprAST::lhs() const {
     return this->lhs_;
 }
 
-const Expression& BinaryExprAST::rhs() const {
+Expression BinaryExprAST::rhs() const {
     return this->rhs_;
 }
 
@@ -169,39 +162,58 @@ Token_e BinaryExprAST::op() const {
 
 
 
-CallExprAST::CallExprAST(const Token& callee, std::vector<Expression> args, TypeInstance ti) :
-    callee_(callee.data()), args_(std::move(args)) {
-    this->col_ = callee.col();
-    this->line_ = callee.line();
+CallExprAST::CallExprAST(const Token& callee, AstList<Expression> args, TypeInstance ti) :
+    ExprAST(ExprKind::Call), callee_(callee.interned()), args_(args) {
+    set_location(callee);
     this->ti_ = ti;
 }
 
-const std::string& CallExprAST::callee() const {
+Symbol CallExprAST::callee() const {
     return this->callee_;
 }
 
-const std::vector<Expression>& CallExprAST::args() const {
+AstList<Expression> CallExprAST::args() const {
     return this->args_;
 }
 
-std::vector<Expression>& FunctionAST::body() {
+AstList<Expression> FunctionAST::body() {
     return this->body_;
 }
 
-const std::vector<std::unique_ptr<VariableExprAST>>& DeclarationAST::args() const {
+AstList<VariableExprAST*> DeclarationAST::args() const {
     return this->args_;
 }
 
-std::unique_ptr<DeclarationAST>& FunctionAST::decl() {
+DeclarationAST* FunctionAST::decl() {
     return this->decl_;
 }
 
-int RepeatAST::line() const {
-    return this->line_;
+void DeclarationAST::shift_lines(int delta) {
+    this->line_ += delta;
+    for (VariableExprAST* arg : args_)
+        arg->shift_lines(delta);
 }
 
-int RepeatAST::col() const {
-    return this->col_;
+void FunctionAST::shift_lines(int delta) {
+    decl_->shift_lines(delta);
+
+    // With a stack, bodies can be nested deeper than the call stack would let us go
+    std::vector<Expression> stack(body_.begin(), body_.end());
+    while (!stack.empty()) {
+        Expression expr = stack.back();
+        stack.pop_back();
+        if (!expr)
+            continue;
+        expr->shift_lines(delta);
+        expr->children(stack);
+    }
+}
+
+RepeatAST::RepeatAST(int line, int col, Expression loop_until_expr, Expression loop_body) :
+    ExprAST(ExprKind::Repeat), loop_until_expr_(loop_until_expr), loop_body_(loop_body) {
+    this->line_ = line;
+    this->col_ = col;
+    this->ti_ = SALT_TYPE_VOID;
 }
 
 Expression& RepeatAST::loop_until_expr() {
@@ -213,28 +225,20 @@ Expression& RepeatAST::loop_body() {
 }
 
 
-ReturnAST::ReturnAST(const Token& tok, Expression expr) : return_val(std::move(expr)) {
-    this->line_ = tok.line();
-    this->col_ = tok.col();
+ReturnAST::ReturnAST(const Token& tok, Expression expr) : ExprAST(ExprKind::Return), return_val(expr) {
+    set_location(tok);
     this->ti_ = SALT_TYPE_RETURN;
     this->expected_return_type = SALT_TYPE_RETURN;
 }
 
-NewVariableAST::NewVariableAST(const Token& op, std::unique_ptr<VariableExprAST> var, Expression value) :
-    var_(std::move(var)), value_(std::move(value)) {
-    this->line_ = op.line();
-    this->col_ = op.col();
+NewVariableAST::NewVariableAST(const Token& op, VariableExprAST* var, Expression value) :
+    ExprAST(ExprKind::NewVariable), var_(var), value_(value) {
+    set_location(op);
     this->ti_ = SALT_TYPE_RETURN;
 }
 
 
 
-ReturnAST*          ExprAST::to_return()    { return is_return()    ? static_cast<ReturnAST*>(this)         : nullptr; }
-ValExprAST*         ExprAST::to_val()       { return is_val()       ? static_cast<ValExprAST*>(this)        : nullptr; }
-BinaryExprAST*      ExprAST::to_binary()    { return is_binary()    ? static_cast<BinaryExprAST*>(this)     : nullptr; }
-VariableExprAST*    ExprAST::to_variable()  { return is_variable()  ? static_cast<VariableExprAST*>(this)   : nullptr; }
-TypeExprAST*        ExprAST::to_type()      { return is_type()      ? static_cast<TypeExprAST*>(this)       : nullptr; }
-DerefExprAST*       ExprAST::to_deref()     { return is_deref()     ? static_cast<DerefExprAST*>(this)      : nullptr; }
 
 
 // For code generation to IR
@@ -245,13 +249,11 @@ Value* ValExprAST::code_gen() {
     IRGenerator* gen = IRGenerator::get();
     llvm::Type* my_type = const_cast<llvm::Type*>(type()->get());
 
-    // we return the biggest possible int size so we dont lose any data if the user actually does want a (u)i64
-    if (my_type == llvm::Type::getInt64Ty(*gen->context))
-        return llvm::ConstantInt::get(llvm::Type::getInt64Ty(*gen->context), val_.i64, true);
-    else if (my_type == llvm::Type::getDoubleTy(*gen->context))
-        return llvm::ConstantFP::get(llvm::Type::getDoubleTy(*gen->context), val_.f64);
-    else if (my_type == llvm::Type::getInt8Ty(*gen->context))
-        return llvm::ConstantInt::get(llvm::Type::getInt8Ty(*gen->context), val_.i64, true);
+    // Literals are longs, doubles, chars and bools, but the ConstantFolder makes constants of any integer or floating type
+    if (my_type->isIntegerTy())
+        return llvm::ConstantInt::get(my_type, val_.i64, type()->is_signed);
+    else if (my_type->isFloatingPointTy())
+        return llvm::ConstantFP::get(my_type, val_.f64);
     else if (my_type == llvm::Type::getVoidTy(*gen->context))
         return llvm::PoisonValue::get(my_type);
     else if (my_type == llvm::PointerType::get(*gen->context, 0)) {
@@ -264,10 +266,10 @@ Value* ValExprAST::code_gen() {
 
         // type is char*, meaning this is a string
         else if (ti_.pointee == SALT_TYPE_CHAR && ti_.ptr_layers == 1) {
-            if (llvm::Value* ret_val = gen->named_strings[this->data()])
+            if (llvm::Value* ret_val = gen->named_strings[this->str()])
                 return ret_val;
             else
-                return (gen->named_strings[this->data()] = gen->builder->CreateGlobalStringPtr(this->data(), "str"));
+                return (gen->named_strings[this->str()] = gen->builder->CreateGlobalStringPtr(this->str().c_str(), "str"));
         }
 
         else if (ti_.pointee) {
@@ -283,8 +285,6 @@ Value* ValExprAST::code_gen() {
 
         
     }
-    else if (my_type == llvm::Type::getInt1Ty(*gen->context))
-        return llvm::ConstantInt::get(llvm::Type::getInt1Ty(*gen->context), val_.i64, false);
     else
         print_fatal(f_string("%s: wrong type (%s)", __FUNCTION__, type()->name.c_str()));
 
@@ -300,14 +300,14 @@ Value* VariableExprAST::code_gen() {
     // for (const std::pair<std::string, Value*>& pair : gen->named_values) {
     //     salt::dboutv << f_string("Name %s: ptr %p\n", pair.first.c_str(), pair.second);
     // }
-    salt::dboutv << f_string("I am a variable of type %s and my name is %s\n", this->type()->name, this->name());
+    salt::dboutv << f_string("I am a variable of type %s and my name is %s\n", this->type()->name.c_str(), this->name().c_str());
 
 
     llvm::AllocaInst*& alloca_inst = gen->find_in_named_values(this->name());
 
     if (!alloca_inst) {
-        print_error_at(this, f_string("variable %s does not exist", this->name()));
-        alloca_inst = gen->builder->CreateAlloca(llvm::Type::getInt8Ty(*gen->context), nullptr, this->name());
+        print_error_at(this, f_string("variable %s does not exist", this->name().c_str()));
+        alloca_inst = gen->builder->CreateAlloca(llvm::Type::getInt8Ty(*gen->context), nullptr, this->name().c_str());
     }
 
 
@@ -319,34 +319,12 @@ Value* NewVariableAST::code_gen() {
     IRGenerator* gen = IRGenerator::get();
     llvm::Type* llvm_type = const_cast<llvm::Type*>(var_->type()->get());
 
-    // check for void
-    if (llvm_type == SALT_TYPE_VOID->get()) {
-        print_error_at(var_.get(), "cannot create variable of void type");
-        return nullptr;
-    }
-
     // allocate the mem...
-    llvm::AllocaInst* alloca_inst = gen->builder->CreateAlloca(llvm_type, nullptr, var_->name());
-    llvm::AllocaInst*& existing_inst = gen->find_in_named_values(var_->name());
-    if (existing_inst)
-        print_error_at(var_.get(), f_string("variable %s already exists", var_->name().c_str()));
-    existing_inst = alloca_inst;
-
-    // and set it.
-    llvm::Value* right = value_->code_gen();
-    if (!right) {
-        right = llvm::PoisonValue::get(llvm_type);
-        print_error_at(value_.get(), "bad value for assignment!");
-    }
+    llvm::AllocaInst* alloca_inst = gen->builder->CreateAlloca(llvm_type, nullptr, var_->name().c_str());
+    gen->find_in_named_values(var_->name()) = alloca_inst;
 
-    // Make it so that we can't stack-allocate a float and then put a double there (and then crash because the double is too big.)
-    right = convert_implicit(right, llvm_type, value_->type()->is_signed);
-    if (!right) {
-        right = llvm::PoisonValue::get(llvm_type);
-        print_error_at(value_.get(), f_string("cannot create a %s from a %s", var_->type_instance().str().c_str(), value_->type_instance().str().c_str()));
-    }
-    
-    gen->builder->CreateStore(right, alloca_inst);
+    // and set it. Sema already converted the value to the type of the variable
+    gen->builder->CreateStore(value_->code_gen(), alloca_inst);
     return nullptr;
 }
 
@@ -354,16 +332,15 @@ Value* TypeExprAST::code_gen() {
     return nullptr;
 }
 
-TypeExprAST::TypeExprAST(const Token& tok) {
-    this->line_ = tok.line();
-    this->col_ = tok.col();
+TypeExprAST::TypeExprAST(const Token& tok) : ExprAST(ExprKind::Type) {
+    set_location(tok);
 
     if (tok.val() != TOK_TYPE)
-        print_fatal(f_string("Attempted to create TypeInstance with token of type %s and data `%s`", tok.str(), tok.data()));
+        print_fatal(f_string("Attempted to create TypeInstance with token of type %s and data `%s`", tok.str().c_str(), std::string(tok.data()).c_str()));
 
     ti_ = TypeInstance(
-        tok.count() ? SALT_TYPE_PTR : salt::all_types[tok.data()],
-        tok.count() ? salt::all_types[tok.data()] : nullptr,
+        tok.count() ? SALT_TYPE_PTR : salt::all_types[std::string(tok.data())],
+        tok.count() ? salt::all_types[std::string(tok.data())] : nullptr,
         tok.count()
     );
 
@@ -374,573 +351,218 @@ TypeExprAST::TypeExprAST(const Token& tok) {
         ti_ = SALT_TYPE_ERROR;
 }
 
-TypeExprAST::TypeExprAST(const TypeInstance& ti) {
+TypeExprAST::TypeExprAST(const TypeInstance& ti) : ExprAST(ExprKind::Type) {
     if (!ti_)
         print_fatal("Invalid TypeInstance for TypeExprAST ctor");
     ti_ = ti;
 }
 
-DerefExprAST::DerefExprAST(Expression expr) : expr_(std::move(expr)) {
-    this->col_ = expr_->col();
-    this->line_ = expr_->line();
-    if (expr_->ptr_layers() >= 2) {
-        ti_ = expr_->type_instance();
-        ti_.ptr_layers--;
-    } else {
-        ti_ = expr_->pointee() ? expr_->pointee() : SALT_TYPE_ERROR;
-    }
+DerefExprAST::DerefExprAST(Expression expr) : ExprAST(ExprKind::Deref), expr_(expr) {
+    copy_location(expr_);
+}
 
-    salt::dboutv << "Created new DerefExprAST, my type: `" << ti_.str() << "` , my expr's type: `" << expr_->type_instance().str() << "`\n";
+ImplicitCastExprAST::ImplicitCastExprAST(Expression operand, const TypeInstance& ti) : ExprAST(ExprKind::ImplicitCast), operand_(operand) {
+    copy_location(operand_);
+    this->ti_ = ti;
 }
 
 Value* BinaryExprAST::code_gen() {
-
     IRGenerator* gen = IRGenerator::get();
-    Value* left_proto = lhs_->code_gen();
-    if (!left_proto)
-        return nullptr;
-        //print_fatal("Bad LHS to BinaryExprAST::code_gen()");
-
-    Value* right_proto = rhs_->code_gen();
-    if (!right_proto && !rhs_->is_type())
-        return nullptr;
-
-    const salt::Type* new_type = lhs_->type();
-    if (new_type->rank < rhs_->type()->rank)
-        new_type = rhs_->type();
 
-    salt::dboutv << f_string("BinExprAST has types %s and %s, converting to %s\n", lhs_->type()->name.c_str(), rhs_->type()->name.c_str(), new_type->name.c_str());
-
-
-    Value* left = nullptr;
-    Value* right = nullptr;
-    
-    // This is a trivial operation between two non-pointers, so convert both of them to the biggest type of the two
-    // Or, it's not a pointer offset (that is, one of lhs/rhs is ptr, the other one is an integer)
-    if (lhs_->pointee() == nullptr && rhs_->pointee() == nullptr && right_proto) {
-        left = convert_implicit(left_proto, new_type->get(), lhs_->type()->is_signed);
-        right = convert_implicit(right_proto, new_type->get(), rhs_->type()->is_signed);
-
-        if (!left || !right) {
-            print_error_at(this, f_string("unsupported conversion between `%s` and `%s` type", lhs_->type()->name.c_str(), rhs_->type()->name.c_str()));
-            salt::dboutv << "Creating poison value for new type at address " << new_type << std::endl;
-            return llvm::PoisonValue::get(const_cast<llvm::Type*>(new_type->get()));
+    switch (op_) {
+    case TOK_AS: {
+        Value* cast_val = convert_explicit(lhs_->code_gen(), type()->get(), lhs_->type()->is_signed);
+        if (dboutv.is_active()) {
+            dboutv << "Explicit cast success, value: ";
+            cast_val->print(llvm::outs());
+            dboutv << '\n';
         }
+        return cast_val;
     }
 
-    // Both operands are pointers, no conversion necessary
-    else if (lhs_->pointee() != nullptr && rhs_->pointee() != nullptr) {
-        left = left_proto;
-        right = right_proto;
-    }
+    case TOK_ASSIGN: {
+        // The lhs is either *ptr or a variable, Sema made sure of that
+        Value* lhs_ptr = nullptr;
+        if (DerefExprAST* lhs_deref = dyn_cast<DerefExprAST>(lhs_))
+            lhs_ptr = lhs_deref->expr()->code_gen();
+        else
+            lhs_ptr = gen->find_in_named_values(cast<VariableExprAST>(lhs_)->name());
 
-    // Ok but at least it's not a pointer offset (add or sub) so no handling required
-    else if (!!lhs_->ptr_layers() != !!rhs_->ptr_layers() && (op_ != TOK_ADD && op_ != TOK_SUB))
-    {
-        left = left_proto;
-        right = right_proto;
+        Value* rhs_code = rhs_->code_gen();
+        gen->builder->CreateStore(rhs_code, lhs_ptr);
+        return rhs_code;
     }
 
-/*
-    if (!left || !right) {
-        salt::dboutv << "Creating poison value for new type at address " << new_type << std::endl;
-        return llvm::PoisonValue::get(const_cast<llvm::Type*>(new_type->get()));
+    default:
+        break;
     }
-*/
 
+    Value* left = lhs_->code_gen();
+    Value* right = rhs_->code_gen();
 
+    // A pointer plus or minus an integer, which Sema already made an ssize
+    if (type()->get()->isPointerTy()) {
+        const bool ptr_is_lhs = lhs_->ptr_layers() > 0;
+        const TypeInstance& ti_ptr = ptr_is_lhs ? lhs_->type_instance() : rhs_->type_instance();
+        Value* ptr_val = ptr_is_lhs ? left : right;
+        Value* offset_val = ptr_is_lhs ? right : left;
 
-    // what kind of operands are we dealing with here?
-    enum BinType {
-        BIN_TYPE_INT,
-        BIN_TYPE_UINT,
-        BIN_TYPE_FLOAT,
-        BIN_TYPE_PTR,
-        BIN_TYPE_INVALID,
-        BIN_TYPE_EXPLICIT_CAST
-    };
-
-    BinType bin_type;
-    const llvm::Type* llvm_new_type = new_type->get();
-    if (llvm_new_type->isPointerTy())
-        bin_type = BIN_TYPE_PTR;
-    else if (llvm_new_type->isFloatingPointTy())
-        bin_type = BIN_TYPE_FLOAT;
-    else if (llvm_new_type->isIntegerTy())
-        if (new_type->is_signed)
-            bin_type = BIN_TYPE_INT;
+        int offset_size = 0;
+        if (ti_ptr.ptr_layers > 1)
+            offset_size = SALT_TYPE_PTR->get()->getPrimitiveSizeInBits() / 8;
         else
-            bin_type = BIN_TYPE_UINT;
-    else
-        bin_type = BIN_TYPE_INVALID;
+            offset_size = ti_ptr.pointee->get()->getPrimitiveSizeInBits() / 8;
+        offset_size = std::max(1, offset_size);
 
-    if (rhs_->is_type())
-        bin_type = BIN_TYPE_EXPLICIT_CAST;
-    
-    salt::dboutv << "Decided bintype (" << int(bin_type) << ")!\n";
+        if (op_ == TOK_SUB) {
+            offset_val = gen->builder->CreateMul(offset_val, llvm::ConstantInt::get(offset_val->getType(), -offset_size));
+            return gen->builder->CreatePtrAdd(ptr_val, offset_val, "ptrsub");
+        }
 
-    // remember that for all bin_types except BIN_TYPE_PTR, BIN_TYPE_INVALID, left and right are not nullptr
-    switch (this->op_) {
+        offset_val = gen->builder->CreateMul(offset_val, llvm::ConstantInt::get(offset_val->getType(), offset_size), "offsettmp");
+        if (salt::dboutv.is_active()) {
+            salt::dboutv << "Offset val: ";
+            offset_val->print(llvm::outs());
+        }
+        return gen->builder->CreatePtrAdd(ptr_val, offset_val, "ptradd");
+    }
+
+    // Both operands have the same type by now. Pointers are only ever compared, as unsigned integers
+    const salt::Type* operand_type = lhs_->type();
+    const bool is_float = operand_type->get()->isFloatingPointTy();
+    const bool is_signed = operand_type->is_signed && !is_float;
+    if (operand_type->get()->isPointerTy()) {
+        left = gen->builder->CreatePtrToInt(left, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
+        right = gen->builder->CreatePtrToInt(right, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
+    }
+
+    switch (op_) {
 
     /// @todo: mangle these names (like f"$Salt_addtmp_{lhs}_"
     /// @todo: add alignment requirements/auto-align pointers? 
     case TOK_ADD:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateAdd(left, right, "addtmp");
-        case BIN_TYPE_FLOAT:
-            return gen->builder->CreateFAdd(left, right, "addtmp");
-        case BIN_TYPE_PTR:
-            // Try to parse this as a ptr addition if possible
-            if (!left && !right) {
-
-                Value* ptr_val = nullptr;
-                Value* offset_val = nullptr;
-
-                const TypeInstance& ti_left = lhs_->type_instance();
-                const TypeInstance& ti_right = rhs_->type_instance();
-                const TypeInstance* ti_ptr = nullptr;
-                const TypeInstance* ti_offset = nullptr;
-
-                ASSERT(ti_left.type != ti_right.type);
-                if (ti_left.type == SALT_TYPE_PTR) {
-                    ptr_val = left_proto;
-                    offset_val = right_proto;
-                    ti_ptr = &lhs_->type_instance();
-                    ti_offset = &rhs_->type_instance();
-                } else {
-                    ptr_val = right_proto;
-                    offset_val = left_proto;
-                    ti_ptr = &rhs_->type_instance();
-                    ti_offset = &lhs_->type_instance();
-                }
+        return is_float ? gen->builder->CreateFAdd(left, right, "addtmp") : gen->builder->CreateAdd(left, right, "addtmp");
 
-                int offset_size = 0;
-                if (ti_ptr->ptr_layers > 1)
-                    offset_size = SALT_TYPE_PTR->get()->getPrimitiveSizeInBits() / 8;
-                else
-                    offset_size = ti_ptr->pointee->get()->getPrimitiveSizeInBits() / 8;
-
-                if (!offset_val->getType()->isIntegerTy())
-                    RET_POISON_WITH_ERROR_MSG(new_type, f_string("%s - %d:%d: pointer offset must be an integer", salt::file_names[salt::current_file_name_index].c_str(), lhs_->line(), lhs_->col()));
-
-                offset_size = std::max(1, offset_size);
-                offset_val = convert_implicit(offset_val, SALT_TYPE_SSIZE->get(), ti_offset->type->is_signed);
-                offset_val = gen->builder->CreateMul(offset_val, llvm::ConstantInt::get(offset_val->getType(), offset_size), "offsettmp");
-                if (salt::dboutv.is_active()) {
-                    salt::dboutv << "Offset val: ";
-                   offset_val->print(llvm::outs());
-                }
-                    
-                return gen->builder->CreatePtrAdd(ptr_val, offset_val, "ptradd");
-
-            }
-            RET_POISON_WITH_ERROR(new_type);
-            break;
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
-        
     case TOK_SUB:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateSub(left, right, "subtmp");
-        case BIN_TYPE_FLOAT:
-            return gen->builder->CreateFSub(left, right, "subtmp");
-        case BIN_TYPE_PTR:
-            // Try to parse this as a ptr addition if possible
-            if (!left && !right) {
-
-                Value* ptr_val = nullptr;
-                Value* offset_val = nullptr;
-
-                const TypeInstance& ti_left = lhs_->type_instance();
-                const TypeInstance& ti_right = rhs_->type_instance();
-                const TypeInstance* ti_ptr = nullptr;
-                const TypeInstance* ti_offset = nullptr;
-
-                ASSERT(ti_left.type != ti_right.type);
-                if (ti_left.type == SALT_TYPE_PTR) {
-                    ptr_val = left_proto;
-                    offset_val = right_proto;
-                    ti_ptr = &lhs_->type_instance();
-                    ti_offset = &rhs_->type_instance();
-                }
-                else {
-                    ptr_val = right_proto;
-                    offset_val = left_proto;
-                    ti_ptr = &rhs_->type_instance();
-                    ti_offset = &lhs_->type_instance();
-                }
-
-                int offset_size = 0;
-                if (ti_ptr->ptr_layers > 1)
-                    offset_size = SALT_TYPE_PTR->get()->getPrimitiveSizeInBits() / 8;
-                else
-                    offset_size = ti_ptr->pointee->get()->getPrimitiveSizeInBits() / 8;
-
-                if (!offset_val->getType()->isIntegerTy())
-                    RET_POISON_WITH_ERROR_MSG(new_type, f_string("%s - %d:%d: pointer offset must be an integer", salt::file_names[salt::current_file_name_index].c_str(), rhs_->line(), rhs_->col()));
-
-                offset_size = std::max(1, offset_size);
-                offset_val = convert_implicit(offset_val, SALT_TYPE_SSIZE->get(), ti_offset->type->is_signed);
-                offset_val = gen->builder->CreateMul(offset_val, llvm::ConstantInt::get(offset_val->getType(), -offset_size));
-                return gen->builder->CreatePtrAdd(ptr_val, offset_val, "ptrsub");
-            }
-            RET_POISON_WITH_ERROR(new_type);
-            break;
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
+        return is_float ? gen->builder->CreateFSub(left, right, "subtmp") : gen->builder->CreateSub(left, right, "subtmp");
 
     case TOK_MUL:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateMul(left, right, "multmp");
-        case BIN_TYPE_FLOAT:
-            return gen->builder->CreateFMul(left, right, "multmp");
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
+        return is_float ? gen->builder->CreateFMul(left, right, "multmp") : gen->builder->CreateMul(left, right, "multmp");
 
     case TOK_DIV:
-        if (ValExprAST* divisor = rhs_->to_val()) {
-            if ((divisor->type()->is_integer() && divisor->to_int() == 0) || (divisor->type()->is_float() && divisor->to_double() == 0.0)) {
-                print_warning_at(divisor, "division by zero");
-            }
-        }
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-            return gen->builder->CreateSDiv(left, right, "divtmp");
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateUDiv(left, right, "udivtmp");
-        case BIN_TYPE_FLOAT:
+        if (is_float)
             return gen->builder->CreateFDiv(left, right, "fdivtmp");
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
+        if (is_signed)
+            return gen->builder->CreateSDiv(left, right, "divtmp");
+        return gen->builder->CreateUDiv(left, right, "udivtmp");
 
+    case TOK_MODULO: // actually should be remainder
+        if (is_float)
+            return gen->builder->CreateFRem(left, right, "fremtmp");
+        if (is_signed)
+            return gen->builder->CreateSRem(left, right, "sremtmp");
+        return gen->builder->CreateURem(left, right, "uremtmp");
 
     case TOK_LEFT_SHIFT:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateShl(left, right, "shltmp");
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
+        return gen->builder->CreateShl(left, right, "shltmp");
 
+    // arithmetic shift (keeps the sign) for signed types, logical for unsigned ones
     case TOK_RIGHT_SHIFT:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-            return gen->builder->CreateLShr(left, right, "shrtmp");
-        case BIN_TYPE_UINT:
+        if (is_signed)
             return gen->builder->CreateAShr(left, right, "shrtmp");
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
-
+        return gen->builder->CreateLShr(left, right, "shrtmp");
 
-    // Create Integer Comparison Signed L/G Than, since right now all numbers are i32s.
+    // Floating comparisons are ordered (always false if there is a NaN), except for !=
     case TOK_LEFT_ANGLE:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-            return gen->builder->CreateICmpSLT(left, right, "cmptmp");
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateICmpULT(left, right, "cmptmp");
-        case BIN_TYPE_FLOAT:
-            // Create Floating Comparison Ordered Less Than (ordered: always return false if there is a NaN)
+        if (is_float)
             return gen->builder->CreateFCmpOLT(left, right, "cmptmp");
-        case BIN_TYPE_PTR: {
-            Value* left_ptr_to_int = gen->builder->CreatePtrToInt(left, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            Value* right_ptr_to_int = gen->builder->CreatePtrToInt(right, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            return gen->builder->CreateICmpULT(left_ptr_to_int, right_ptr_to_int, "cmptmp");
-        }
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
+        return is_signed ? gen->builder->CreateICmpSLT(left, right, "cmptmp") : gen->builder->CreateICmpULT(left, right, "cmptmp");
 
     case TOK_RIGHT_ANGLE:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-            return gen->builder->CreateICmpSGT(left, right, "cmptmp");
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateICmpUGT(left, right, "cmptmp");
-        case BIN_TYPE_FLOAT:
+        if (is_float)
             return gen->builder->CreateFCmpOGT(left, right, "cmptmp");
-        case BIN_TYPE_PTR: {
-            Value* left_ptr_to_int = gen->builder->CreatePtrToInt(left, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            Value* right_ptr_to_int = gen->builder->CreatePtrToInt(right, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            return gen->builder->CreateICmpUGT(left_ptr_to_int, right_ptr_to_int, "cmptmp");
-        }
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
-
-    case TOK_EQUALS:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateICmpEQ(left, right, "cmptmp");
-        case BIN_TYPE_FLOAT:
-            return gen->builder->CreateFCmpOEQ(left, right, "cmptmp");
-        case BIN_TYPE_PTR: {
-            Value* left_ptr_to_int = gen->builder->CreatePtrToInt(left, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            Value* right_ptr_to_int = gen->builder->CreatePtrToInt(right, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            return gen->builder->CreateICmpEQ(left_ptr_to_int, right_ptr_to_int, "cmptmp");
-        }
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
+        return is_signed ? gen->builder->CreateICmpSGT(left, right, "cmptmp") : gen->builder->CreateICmpUGT(left, right, "cmptmp");
 
     case TOK_EQUALS_LARGER:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-            return gen->builder->CreateICmpSGE(left, right, "cmptmp");
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateICmpUGE(left, right, "cmptmp");
-        case BIN_TYPE_FLOAT:
+        if (is_float)
             return gen->builder->CreateFCmpOGE(left, right, "cmptmp");
-        case BIN_TYPE_PTR: {
-            Value* left_ptr_to_int = gen->builder->CreatePtrToInt(left, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            Value* right_ptr_to_int = gen->builder->CreatePtrToInt(right, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            return gen->builder->CreateICmpUGE(left_ptr_to_int, right_ptr_to_int, "cmptmp");
-        }
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
+        return is_signed ? gen->builder->CreateICmpSGE(left, right, "cmptmp") : gen->builder->CreateICmpUGE(left, right, "cmptmp");
 
     case TOK_EQUALS_SMALLER:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-            return gen->builder->CreateICmpSLE(left, right, "cmptmp");
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateICmpULE(left, right, "cmptmp");
-        case BIN_TYPE_FLOAT:
+        if (is_float)
             return gen->builder->CreateFCmpOLE(left, right, "cmptmp");
-        case BIN_TYPE_PTR: {
-            Value* left_ptr_to_int = gen->builder->CreatePtrToInt(left, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            Value* right_ptr_to_int = gen->builder->CreatePtrToInt(right, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            return gen->builder->CreateICmpULE(left_ptr_to_int, right_ptr_to_int, "cmptmp");
-        }
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
+        return is_signed ? gen->builder->CreateICmpSLE(left, right, "cmptmp") : gen->builder->CreateICmpULE(left, right, "cmptmp");
 
-    case TOK_NOT_EQUALS:
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateICmpNE(left, right, "ncmptmp");
-        case BIN_TYPE_FLOAT:
-            return gen->builder->CreateFCmpUNE(left, right, "ncmptmp"); // unordered here. NaN != X is true for all X
-        case BIN_TYPE_PTR: {
-            Value* left_ptr_to_int = gen->builder->CreatePtrToInt(left, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            Value* right_ptr_to_int = gen->builder->CreatePtrToInt(right, const_cast<llvm::Type*>(SALT_TYPE_USIZE->get()));
-            return gen->builder->CreateICmpNE(left_ptr_to_int, right_ptr_to_int, "ncmptmp");
-        }
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
-
-    case TOK_AS: {
-        if (bin_type != BIN_TYPE_EXPLICIT_CAST)
-            RET_POISON_WITH_ERROR_VAL(rhs_);
-        salt::dboutv << "Attempting expl conversion!!\n";
-        Value* cast_val = convert_explicit(left_proto, rhs_->type_instance().get(), rhs_->type()->is_signed);
-        salt::dboutv << "Expl conversion was possible!\n";
-
-        if (cast_val) {
-            if (dboutv.is_active()) {
-                dboutv << "Explicit cast success, value: ";
-                cast_val->print(llvm::outs());
-                dboutv << '\n';
-            }
-            return cast_val;
-        }
-        
-
-        RET_POISON_WITH_ERROR_VAL(rhs_);
-    }
-
-    case TOK_ASSIGN: {
-        // handle when LHS is dereference
-        if (DerefExprAST* lhs_deref = lhs_->to_deref()) {
-            Value* lhs_ptr_code = lhs_deref->expr()->code_gen();
-            Value* rhs_code = rhs_->code_gen();
-
-            if (!lhs_ptr_code || !lhs_ptr_code->getType()->isPointerTy()) {
-                print_error_at(lhs_.get(), f_string("type `%s` cannot be dereferenced", lhs_->type_instance().str().c_str()));
-                return llvm::PoisonValue::get(const_cast<llvm::Type*>(lhs_->type()->get()));
-            }
-
-            if (!rhs_code) {
-                print_error_at(rhs_.get(), "invalid rhs for assignment");
-                return llvm::PoisonValue::get(const_cast<llvm::Type*>(lhs_->type()->get()));
-            }
-
-            Value* converted_rhs = convert_implicit(rhs_code, lhs_deref->type()->get(), lhs_deref->type()->is_signed);
-
-            if (!converted_rhs) {
-                print_error_at(rhs_.get(), "wrong type for rhs");
-                return llvm::PoisonValue::get(const_cast<llvm::Type*>(lhs_->type()->get()));
-            }
-
-            gen->builder->CreateStore(converted_rhs, lhs_ptr_code);
-            return converted_rhs;
-        }
-
-        // okay, it's not a deref, but instead it's a variable. so we can still assign to this
-        // and this will return rhs, same as above
-        else if (VariableExprAST* lhs_variable = lhs_->to_variable()) {
-
-            AllocaInst*& lhs_code = gen->find_in_named_values(lhs_variable->name());
-            Value* rhs_code = rhs_->code_gen();
-
-            if (!lhs_code) {
-                print_error_at(lhs_variable, f_string("could not create lhs_code (ast.cpp, line %d, please contact salticecream)", __LINE__));
-                return llvm::PoisonValue::get(const_cast<llvm::Type*>(lhs_->type()->get()));
-            }
-
-            if (!rhs_code) {
-                print_error_at(lhs_variable, f_string("invalid rhs for assignment"));
-                return llvm::PoisonValue::get(const_cast<llvm::Type*>(lhs_->type()->get()));
-            }
-
-            Value* converted_rhs = convert_implicit(rhs_code, lhs_variable->type()->get(), lhs_variable->type()->is_signed);
-            
-            if (!converted_rhs) {
-                print_error_at(rhs_.get(), "wrong type for rhs");
-                return llvm::PoisonValue::get(const_cast<llvm::Type*>(lhs_->type()->get()));
-            }
-
-            /// @todo: This always crashes, replace nullptr with the correct value
-            gen->builder->CreateStore(converted_rhs, lhs_code);
-            return converted_rhs;
-        }
-
-        else {
-            print_error_at(lhs_.get(), f_string("cannot assign to `%s`",lhs_->ast_type().c_str()));
-            return llvm::PoisonValue::get(const_cast<llvm::Type*>(lhs_->type()->get()));
-        }
+    case TOK_EQUALS:
+        return is_float ? gen->builder->CreateFCmpOEQ(left, right, "cmptmp") : gen->builder->CreateICmpEQ(left, right, "cmptmp");
 
-    }
-        break;
+    case TOK_NOT_EQUALS:
+        // unordered here. NaN != X is true for all X
+        return is_float ? gen->builder->CreateFCmpUNE(left, right, "ncmptmp") : gen->builder->CreateICmpNE(left, right, "ncmptmp");
 
     case TOK_CARAT: // bitwise xor
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateXor(left, right, "xortmp");
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-            break;
-        }
-        break;
+        return gen->builder->CreateXor(left, right, "xortmp");
 
     case TOK_AMPERSAND: // bitwise and
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateAnd(left, right, "bitandtmp");
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-            break;
-        }
-        break;
+        return gen->builder->CreateAnd(left, right, "bitandtmp");
 
     case TOK_VERTICAL_BAR: // bitwise or
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateOr(left, right, "bitortmp");
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-            break;
-        }
-        break;
-
-    case TOK_MODULO: // actually should be remainder
-        switch (bin_type) {
-        case BIN_TYPE_INT:
-            return gen->builder->CreateSRem(left, right, "sremtmp");
-        case BIN_TYPE_UINT:
-            return gen->builder->CreateURem(left, right, "uremtmp");
-        case BIN_TYPE_FLOAT:
-            if (salt::no_std)
-                print_warning_at(this, "floating - point remainder with no_std flag");
-            return gen->builder->CreateFRem(left, right, "fremtmp");
-        default:
-            RET_POISON_WITH_ERROR(new_type);
-        }
-        break;
+        return gen->builder->CreateOr(left, right, "bitortmp");
 
     default:
         print_fatal("Found bad token " + Token(op_).str() + " in BinaryExprAST::code_gen()");
     }
 }
 
-Value* DerefExprAST::code_gen() {
+Value* UnaryExprAST::code_gen() {
     IRGenerator* gen = IRGenerator::get();
-    if (type() != SALT_TYPE_VOID && type() != SALT_TYPE_ERROR && type() != SALT_TYPE_RETURN && type() != SALT_TYPE_NEVER)
-        return gen->builder->CreateLoad(const_cast<llvm::Type*>(this->type()->get()), this->expr_->code_gen(), "dereftmp");
-    print_error_at(this, f_string("cannot dereference %s", this->expr_->type_instance().str().c_str()));
-    return nullptr;
-}
+    Value* operand = operand_->code_gen();
 
-Value* CallExprAST::code_gen() {
-    IRGenerator* gen = IRGenerator::get();
-    Function* callee_fn = gen->mod->getFunction(this->callee());
+    const salt::Type* type = operand_->type();
+    switch (op_) {
+    case TOK_SUB:
+        if (type->is_float())
+            return gen->builder->CreateFNeg(operand, "negtmp");
+        return gen->builder->CreateNeg(operand, "negtmp");
+
+    case TOK_TILDE:
+        return gen->builder->CreateNot(operand, "nottmp");
+
+    // true iff the operand is 0 (or null)
+    case TOK_EXCLAMATION:
+    case TOK_NOT:
+        if (type == SALT_TYPE_BOOL)
+            return gen->builder->CreateNot(operand, "lnottmp");
+        if (operand->getType()->isPointerTy())
+            return gen->builder->CreateIsNull(operand, "lnottmp");
+        if (type->is_float())
+            return gen->builder->CreateFCmpOEQ(operand, llvm::ConstantFP::get(operand->getType(), 0.0), "lnottmp");
+        return gen->builder->CreateICmpEQ(operand, llvm::ConstantInt::get(operand->getType(), 0), "lnottmp");
 
-    // Error handling: the function must exist, and be passed the correct number of arguments, and the arguments must be of the correct type.
-    // Variadic functions will be added much later or possibly never.
-    if (!callee_fn) {
-        print_error_at(this, f_string("function %s does not exist", this->callee().c_str()));
-        return nullptr;
+    default:
+        print_fatal("Found bad token " + Token(op_).str() + " in UnaryExprAST::code_gen()");
     }
+}
 
-    size_t arg_size = args().size();
-    if (callee_fn->arg_size() != arg_size) {
-        print_error_at(this, f_string("function %s takes %d arguments, but %d were provided", this->callee().c_str(), callee_fn->arg_size(), arg_size));
-        return nullptr;
-    }
+Value* DerefExprAST::code_gen() {
+    IRGenerator* gen = IRGenerator::get();
+    return gen->builder->CreateLoad(const_cast<llvm::Type*>(this->type()->get()), this->expr_->code_gen(), "dereftmp");
+}
 
-    // Ok, this is a valid call (fn exists and correct # of args). Populate the argument vector with the provided arguments.
-    // Make sure to try converting the arguments to the correct type.
-    std::vector<Value*> argv; 
+Value* ImplicitCastExprAST::code_gen() {
+    return convert_implicit(operand_->code_gen(), type()->get(), operand_->type()->is_signed);
+}
 
-    int i = 0;
-    bool failed = false;
-    for (auto itr = callee_fn->arg_begin(); itr != callee_fn->arg_end(); itr++) {
-        Value* arg = args_[i]->code_gen();
-        arg = convert_implicit(arg, const_cast<llvm::Type*>(itr->getType()), args_[i]->type()->is_signed);
-        if (!arg) {
-            failed = true;
-            print_error_at(this, f_string("function %s was called with bad argument types", callee_fn->getName().str().c_str()));
-            arg = llvm::PoisonValue::get(const_cast<llvm::Type*>(itr->getType()));
-        }
-        i++;
-        argv.push_back(arg);
-    }
-        
-        
+Value* CallExprAST::code_gen() {
+    IRGenerator* gen = IRGenerator::get();
+    Function* callee_fn = gen->mod->getFunction(this->callee().c_str());
+    if (!callee_fn)
+        print_fatal(f_string("%s: function %s was never declared", __FUNCTION__, this->callee().c_str()));
 
-    ASSERT(!(!argv.empty() && argv.back() == nullptr));
+    // Sema already checked the number of arguments and converted every one of them to the right type
+    std::vector<Value*> argv;
+    for (Expression arg : args_)
+        argv.push_back(arg->code_gen());
 
     // void expressions must not be named!
     if (callee_fn->getReturnType() == llvm::Type::getVoidTy(*gen->context))
@@ -951,24 +573,9 @@ Value* CallExprAST::code_gen() {
 
 Value* IfExprAST::code_gen() {
     IRGenerator* gen = IRGenerator::get();
-    Value* cond_val = condition_->code_gen();
-
-    // Check for the type of cond_val
-
-    // Try to convert cond_val to an i1
-    cond_val = convert_implicit(cond_val, SALT_TYPE_BOOL->get(), false);
-    if (!cond_val) {
-        print_error_at(this, "bad if condition");
-        cond_val = PoisonValue::get(llvm::Type::getInt1Ty(*gen->context));
-    }
-    else salt::dboutv << f_string("Condval ptr is %p\n", cond_val);
-
-
-    // compare the condition to (llvm::bool)0, and set cond_val to the opposite of the result.
-    cond_val = gen->builder->CreateICmpNE(
-        cond_val, ConstantInt::get(const_cast<llvm::Type*>(SALT_TYPE_BOOL->get()), 0, false), "ifcond");
-
 
+    // Sema made the condition a bool, and both arms the type of this expression
+    Value* cond_val = condition_->code_gen();
 
     // Let fn be the current function that we're working with.
     Function* fn = gen->builder->GetInsertBlock()->getParent();
@@ -983,20 +590,8 @@ Value* IfExprAST::code_gen() {
     gen->builder->CreateCondBr(cond_val, true_expr_bb, false_expr_bb);
 
     // Emit the true_expr value.
-    // However first we must make sure they are both of the same type, thus choose the biggest one of them.
-    const salt::Type* new_type = true_expr_->type();
-    if (false_expr_->type()->rank > new_type->rank)
-        new_type = false_expr_->type();
-
-    
-
     gen->builder->SetInsertPoint(true_expr_bb);
     Value* true_expr_val = true_expr_->code_gen();
-    true_expr_val = convert_implicit(true_expr_val, new_type->get(), new_type->is_signed);
-    if (!true_expr_val) {
-        true_expr_val = PoisonValue::get(const_cast<llvm::Type*>(new_type->get()));
-        print_error_at(this, "both arms of an if-expression must be of the same type");
-    }
     gen->builder->CreateBr(merge_bb); // make code to "return" from the if expression at the end of this block
 
     true_expr_bb = gen->builder->GetInsertBlock(); // save this block for later.
@@ -1005,11 +600,6 @@ Value* IfExprAST::code_gen() {
     fn->insert(fn->end(), false_expr_bb);
     gen->builder->SetInsertPoint(false_expr_bb);
     Value* false_expr_val = false_expr_->code_gen();
-    false_expr_val = convert_implicit(false_expr_val, new_type->get(), new_type->is_signed);
-    if (!false_expr_val) {
-        false_expr_val = PoisonValue::get(const_cast<llvm::Type*>(new_type->get()));
-        print_error_at(false_expr_.get(), f_string("bad type (%s) for variable", false_expr_->type_instance().str().c_str()));
-    }
     gen->builder->CreateBr(merge_bb); // make code to "return" from the if expression at the end of this block
 
     false_expr_bb = gen->builder->GetInsertBlock(); // save this block for later.
@@ -1022,7 +612,7 @@ Value* IfExprAST::code_gen() {
     // The phi node is a value that is currently unknown but will be assigned later
     // We need to do this because SSA
 
-    PHINode* phi_node = gen->builder->CreatePHI(const_cast<llvm::Type*>(new_type->get()), 2, "iftmp");
+    PHINode* phi_node = gen->builder->CreatePHI(const_cast<llvm::Type*>(type()->get()), 2, "iftmp");
 
     phi_node->addIncoming(true_expr_val, true_expr_bb);
     phi_node->addIncoming(false_expr_val, false_expr_bb);
@@ -1033,94 +623,38 @@ Value* IfExprAST::code_gen() {
 
 Value* ReturnAST::code_gen() {
     IRGenerator* gen = IRGenerator::get();
-    TypeInstance& expected_salt_type = this->expected_return_type;
-
-    if (!expected_return_type)
-        print_fatal("No expected return type in ReturnAST");
 
-    else if (expected_return_type == TypeInstance(SALT_TYPE_RETURN))
-        return llvm::PoisonValue::get(llvm::Type::getVoidTy(*gen->context)); // don't create a return here, because it was not initialized
-
-    if (return_val->type() == SALT_TYPE_VOID && expected_salt_type.type == SALT_TYPE_VOID) {
+    // Sema checked (and converted) the value against the return type of the function
+    if (expected_return_type.type == SALT_TYPE_VOID) {
+        // a plain "return" comes with a void literal, anything else (a call to a void function) still has to run
+        if (!isa<ValExprAST>(return_val))
+            return_val->code_gen();
         gen->builder->CreateRetVoid();
-        return llvm::PoisonValue::get(llvm::Type::getVoidTy(*gen->context));
-    }
-
-    if (Expression& ret_expr = this->return_val) {
-        Value* res = ret_expr->code_gen();
-        
-        TypeInstance& actual_salt_type = ret_expr->type_instance();
-
-        const llvm::Type* expected_type = expected_salt_type.get();
-        const llvm::Type* actual_type = nullptr;
-
-        // assert that the salt types map correctly to the LLVM ones!
-        ASSERT(expected_salt_type.type->get() == expected_type);
-
-        if (!res)
-            res = llvm::PoisonValue::get(const_cast<llvm::Type*>(SALT_TYPE_VOID->get()));
-
-        actual_type = res->getType();
-
-        bool should_return_void = expected_type == SALT_TYPE_VOID->get();
-
-        if (expected_type != actual_type || expected_salt_type != actual_salt_type) {
-            Value* attempted_conversion = convert_implicit(res, expected_type, actual_salt_type.type->is_signed);
-            // We can convert pointers to bool for example, but we cant convert a void* to an int*, or an int* to an int**
-            // however we can convert any ptr to a void
-            // remember that if both inp types are fully equal, we wouldnt need to check this
-            if (attempted_conversion != nullptr &&
-                (expected_salt_type.ptr_layers == 0                                                                 // if the expected type is not a pointer, but a ptr is convertible to it, then OK
-                    || actual_salt_type.ptr_layers == 0                                                             // if the expected type is a pointer, but a non-ptr is convertible to it, then OK
-                    || (expected_salt_type.ptr_layers == 1 && expected_salt_type.pointee == SALT_TYPE_VOID))) {     // if the expected type is a void-ptr, then any ptr is convertible to it, then OK
-                res = attempted_conversion;
-            }
-            else {
-                print_error_at(this, f_string("returning %s when %s was expected",
-                    actual_salt_type.str().c_str(),
-                    expected_salt_type.str().c_str()));
-                if (!expected_type || expected_type == llvm::Type::getVoidTy(*gen->context)) {
-                    // Do nothing
-                }
-                else {
-                    res = llvm::PoisonValue::get(const_cast<llvm::Type*>(expected_return_type.get()));
-                }
-            }
-        }
-
-        // Create a return if res is not of void type.
-        // If res is of the wrong type, this will be a poison value
-        if (!should_return_void)
-            gen->builder->CreateRet(res);
-        else
-            gen->builder->CreateRetVoid();
-
-        salt::dbout << "created return" << std::endl;
-
-
-        return llvm::PoisonValue::get(llvm::Type::getVoidTy(*gen->context));
+    } else {
+        gen->builder->CreateRet(return_val->code_gen());
     }
 
+    salt::dbout << "created return" << std::endl;
     return llvm::PoisonValue::get(llvm::Type::getVoidTy(*gen->context));
 }
 
 Function* DeclarationAST::code_gen() {
     IRGenerator* gen = IRGenerator::get();
     std::vector<llvm::Type*> parameter_types;
-    for (const std::unique_ptr<VariableExprAST>& var : args())
+    for (const VariableExprAST* var : args())
         parameter_types.push_back(const_cast<llvm::Type*> (var->type()->get()));
 
 
     FunctionType* ft = FunctionType::get(const_cast<llvm::Type*>(this->type()->get()), parameter_types, false);
 
-    Function* f = Function::Create(ft, Function::ExternalLinkage, this->name(), *gen->mod.get());
+    Function* f = Function::Create(ft, Function::ExternalLinkage, this->name().c_str(), *gen->mod.get());
 
 
     // Name the arguments appropriately to make life easier for us in the future.
 
     int i = 0;
     for (Argument& Arg : f->args())
-        Arg.setName((args()[i++])->name());
+        Arg.setName((args()[i++])->name().c_str());
 
     return f;
 }
@@ -1128,7 +662,7 @@ Function* DeclarationAST::code_gen() {
 Function* FunctionAST::code_gen() {
     IRGenerator* gen = IRGenerator::get();
 
-    Function* f = gen->mod->getFunction(this->decl()->name());
+    Function* f = gen->mod->getFunction(this->decl()->name().c_str());
 
     if (!f)
         f = this->decl()->code_gen();
@@ -1136,14 +670,6 @@ Function* FunctionAST::code_gen() {
     if (!f)
         print_fatal(IRGeneratorException(this->decl()->line(), this->decl()->col(), "In FunctionAST::code_gen(): failed DeclarationAST::code_gen()"));
     
-    // Check that the function has not already been defined (it's ok if it has been declared though)
-    if (!f->empty()) {
-        print_error(f_string("%s - %d:%d: redefinition of function %s", get_current_file_name().c_str(), decl()->line(), decl()->col(), decl()->name().c_str()));
-        return f;
-    }
-
-
-
     // Tell the LLVM builder to generate code inside this block (the function).
     // Control flow comes later.
     BasicBlock* bb = BasicBlock::Create(*gen->context, "entry", f);
@@ -1159,7 +685,7 @@ Function* FunctionAST::code_gen() {
     for (auto& arg : f->args()) {
         AllocaInst* llvm_alloca = temp_builder.CreateAlloca(arg.getType(), nullptr, arg.getName());
         gen->builder->CreateStore(&arg, llvm_alloca);
-        gen->named_values.back()[std::string(arg.getName())] = llvm_alloca;
+        gen->named_values.back()[Interner::get()->intern(std::string_view(arg.getName().data(), arg.getName().size()))] = llvm_alloca;
         salt::dbout << "arg.getName(): " << std::string(arg.getName()) << std::endl;
         salt::dboutv << "allocaInst->getName(): " << std::string(llvm_alloca->getName()) << std::endl;
     }
@@ -1167,48 +693,16 @@ Function* FunctionAST::code_gen() {
     salt::dbout << "created declaration" << std::endl;
 
     TypeInstance& expected_salt_type = this->decl()->type_instance();
-    const llvm::Type* expected_type = this->decl()->type()->get();
 
     // Generate code for all expressions and statements inside this function
-    for (int i = 0; i < this->body().size(); i++) {
-        Expression& current_expr = body()[i];
-        if (ReturnAST* return_expr = current_expr->to_return())
-            return_expr->expected_return_type = expected_salt_type;
-        current_expr->code_gen();
-    }
-
-
-
-
-
-
-
-    if (this->body().size() != 0) {
-        Expression& last_expr = this->body().back();
-        ReturnAST* last_ret = last_expr->to_return();
-        // check if the function ends with a return, if not we kindly add a poison at the end and warn the user
-        if (!last_ret) {
-            if (expected_salt_type.get() == SALT_TYPE_VOID->get()) {
-                gen->builder->CreateRetVoid();
-            } else {
-                salt::dboutv << "Creating an extra poison return with type " << expected_salt_type.str() << '\n';
-                gen->builder->CreateRet(llvm::PoisonValue::get(expected_salt_type.get()));
-                print_warning_at(last_expr.get(), f_string("%s does not end with a return instruction", this->decl()->name().c_str()));
-            }
-        }
-
-    } else {
-        print_warning(f_string("%s - %d:%d: %s does not end with a return instruction", 
-            salt::file_names[salt::current_file_name_index].c_str(), 
-            decl()->line(), 
-            decl()->col(), 
-            decl()->name().c_str()));
+    for (Expression expr : this->body())
+        expr->code_gen();
 
+    // Sema already warned about a missing return, so just add one to keep llvm happy
+    if (this->body().empty() || !isa<ReturnAST>(this->body().back())) {
         if (expected_salt_type.get() == SALT_TYPE_VOID->get()) {
             gen->builder->CreateRetVoid();
-        }
-
-        else {
+        } else {
             salt::dboutv << "Creating an extra poison return with type " << expected_salt_type.str() << '\n';
             gen->builder->CreateRet(llvm::PoisonValue::get(expected_salt_type.get()));
         }
@@ -1244,6 +738,49 @@ Function* FunctionAST::code_gen() {
     return f;
 }
 
+void TranslationUnitAST::code_gen(const std::vector<DeclarationAST*>& prelude, FunctionCache* cache) {
+    IRGenerator* gen = IRGenerator::get();
+
+    auto declare_once = [gen](DeclarationAST* decl) {
+        if (!gen->mod->getFunction(decl->name().c_str()))
+            decl->code_gen();
+    };
+    for (DeclarationAST* decl : prelude)
+        declare_once(decl);
+    for (DeclarationAST* decl : declarations)
+        declare_once(decl);
+    for (FunctionAST* func : functions)
+        declare_once(func->decl());
+
+    // What every call looks like, for the cache keys
+    std::unordered_map<Symbol, DeclarationAST*> signatures;
+    if (cache) {
+        for (DeclarationAST* decl : prelude)
+            signatures[decl->name()] = decl;
+        for (DeclarationAST* decl : declarations)
+            signatures[decl->name()] = decl;
+        for (FunctionAST* func : functions)
+            signatures[func->decl()->name()] = func->decl();
+    }
+
+    for (FunctionAST* func : functions) {
+        const uint64_t key = cache ? cache->key_of(func, signatures) : 0;
+        if (cache && cache->load(key, func)) {
+            if (func->decl()->name().str() == "main")
+                salt::main_function_found = true;
+            continue;
+        }
+
+        llvm::Function* generated_ir = func->code_gen();
+        if (cache)
+            cache->store(key, generated_ir);
+        salt::dbout << "Generated code for function " << func->decl()->name() << ' ';
+        if (salt::dbout.is_active())
+            generated_ir->print(llvm::errs());
+        salt::dbout << std::endl;
+    }
+}
+
 /// @todo: fix
 llvm::Value* RepeatAST::code_gen() {
     
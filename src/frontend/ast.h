@@ -9,6 +9,7 @@
 #include "../common.h"
 #include "frontendllvm.h"
 #include "types.h"
+#include "astarena.h"
 
 
 // Credit where credit is due, this part is heavily "inspired" by the Kaleidoscope
@@ -19,49 +20,83 @@ class ValExprAST;
 class VariableExprAST;
 class ReturnAST;
 class BinaryExprAST;
+class UnaryExprAST;
 class TypeExprAST;
 class DerefExprAST;
 class CallExprAST;
+class AstSerializer;
+class Sema;
+class ConstantFolder;
+class FunctionCache;
+
+// Constructor tag for nodes that are loaded from the AstCache. The node is left empty,
+// and AstSerializer (a friend of every node) fills it in.
+struct AstBlank {};
+
+// What kind of node an ExprAST is. Every class below has a classof() that checks it, so
+// llvm::isa, llvm::cast and llvm::dyn_cast work on them like they do on LLVM's own classes,
+// and ExprVisitor (astvisitor.h) can switch on it.
+enum class ExprKind : uint8_t {
+    Val,
+    Variable,
+    Binary,
+    Unary,
+    Call,
+    If,
+    Repeat,
+    Type,
+    Deref,
+    Return,
+    NewVariable,
+    ImplicitCast,
+};
 
 // Base class for expression nodes in the AST
 // Represents an expression of any kind.
+// The parser types the leaves (it knows what every name is), Sema types the rest.
+// Every node lives in an AstArena, which also takes care of freeing it.
 
 class ExprAST {
+    friend class AstSerializer;
 protected:
-    int line_;
-    int col_;
+    // Until somebody asks for them, line_ is the offset of the node's token and col_ is 0.
+    // Most nodes never get asked, so looking them up in the SourceManager is left to resolve_location()
+    mutable int line_;
+    mutable int col_ : 24;  // the kind fits next to it, so it doesn't make every node 8 bytes bigger
+    unsigned kind_ : 8;
     TypeInstance ti_;
+
+    explicit ExprAST(ExprKind kind) : line_(0), col_(0), kind_(static_cast<unsigned>(kind)) {}
+    void look_up_location() const;
+
+    void set_location(const Token& tok)         { this->line_ = static_cast<int>(tok.offset()); this->col_ = 0; }
+    // Without looking it up, if other didn't yet
+    void copy_location(const ExprAST* other)    { this->line_ = other->line_; this->col_ = other->col_; }
 public:
     virtual ~ExprAST() = default;
 
     // Generate LLVM IR for this node.
     virtual llvm::Value* code_gen() = 0;
 
-    int line() const                            { return line_; }
-    int col() const                             { return col_; }
+    ExprKind kind() const                       { return static_cast<ExprKind>(kind_); }
+    int line() const                            { resolve_location(); return line_; }
+    int col() const                             { resolve_location(); return col_; }
     const salt::Type* type() const              { return ti_.type; }
     const salt::Type* pointee() const           { return ti_.pointee; }
     TypeInstance& type_instance()               { return ti_; }
     int ptr_layers() const                      { return ti_.ptr_layers; };
     void set_type(TypeInstance type)            { this->ti_ = type; }
-    virtual bool is_val() const                 { return false; }
-    virtual bool is_return() const              { return false; }
-    virtual bool is_variable() const            { return false; }
-    virtual bool is_binary() const              { return false; }
-    virtual bool is_type() const                { return false; }
-    virtual bool is_deref() const               { return false; }
-    virtual bool is_call() const                { return false; }
-    virtual bool is_if() const                  { return false; }
-    virtual bool is_new_variable() const        { return false; }
-    ReturnAST* to_return();         // convert this to return expr if possible
-    ValExprAST* to_val();           // convert this to val expr if possible
-    VariableExprAST* to_variable(); // convert this to variable expr if possible
-    BinaryExprAST* to_binary();     // convert this to binary expr if possible
-    TypeExprAST* to_type();         // convert this to type expr if possible
-    DerefExprAST* to_deref();
+    void shift_lines(int delta)                 { if (line() != 0) this->line_ += delta; }
+
+    // Looks up the line and col now, while the SourceManager still has the file.
+    // Needed for nodes that are kept around after it's destroyed, like the prelude's
+    void resolve_location() const               { if (col_ == 0 && line_ != 0) look_up_location(); }
+
+    // Appends the nodes right below this one to out, in source order
+    void children(std::vector<ExprAST*>& out) const;
     std::string ast_type() const;
 };
-typedef std::unique_ptr<ExprAST> Expression;
+typedef ExprAST* Expression;
 
 
 // Value node for literals
@@ -72,15 +107,18 @@ protected:
         double f64;
     }
     val_;
-    std::string data_;
+    Symbol str_;
+    friend class AstSerializer;
+    friend class ConstantFolder;
 
 public:
+    explicit ValExprAST(AstBlank) : ExprAST(ExprKind::Val) {}
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::Val; }
     ValExprAST(const Token& tok, int64_t val, TypeInstance ti = SALT_TYPE_LONG);
     ValExprAST(const Token& tok, double val, TypeInstance ti = SALT_TYPE_DOUBLE);
-    ValExprAST(const Token& tok, std::string str, TypeInstance ti = TypeInstance(SALT_TYPE_CHAR, 1));
+    ValExprAST(const Token& tok, Symbol str, TypeInstance ti = TypeInstance(SALT_TYPE_CHAR, 1));
     virtual llvm::Value* code_gen() override;
-    virtual bool is_val() const override { return true; }
-    std::string& data() { return data_; }
+    Symbol str() const { return str_; }
     int64_t to_int() const;
     double to_double() const;
 };
@@ -88,12 +126,14 @@ public:
 // Variable name node
 class VariableExprAST : public ExprAST {
 protected:
-    const std::string name_;
+    Symbol name_;
+    friend class AstSerializer;
 
 public:
+    explicit VariableExprAST(AstBlank) : ExprAST(ExprKind::Variable) {}
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::Variable; }
     VariableExprAST(const Token& tok, TypeInstance ti = SALT_TYPE_LONG);
-    const std::string& name() const;
-    virtual bool is_variable() const override { return true; }
+    Symbol name() const;
     virtual llvm::Value* code_gen() override;
 };
 
@@ -103,25 +143,50 @@ protected:
     Token_e op_;
     Expression lhs_;
     Expression rhs_;
+    friend class AstSerializer;
+    friend class Sema;
+    friend class ConstantFolder;
 public:
+    explicit BinaryExprAST(AstBlank) : ExprAST(ExprKind::Binary) {}
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::Binary; }
     BinaryExprAST(const Token& op, Expression lhs, Expression rhs);
-    const Expression& lhs() const;
-    const Expression& rhs() const;
+    Expression lhs() const;
+    Expression rhs() const;
     Token_e op() const;
     virtual llvm::Value* code_gen() override;
-    virtual bool is_binary() const override { return true; }
+};
+
+// A prefix operator applied to an expression, like -x, !x or ~x.
+class UnaryExprAST : public ExprAST {
+protected:
+    Token_e op_;
+    Expression operand_;
+    friend class AstSerializer;
+    friend class Sema;
+    friend class ConstantFolder;
+public:
+    explicit UnaryExprAST(AstBlank) : ExprAST(ExprKind::Unary) {}
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::Unary; }
+    UnaryExprAST(const Token& op, Expression operand);
+    Expression operand() const { return operand_; }
+    Token_e op() const { return op_; }
+    virtual llvm::Value* code_gen() override;
 };
 
 // An expression that represents a called function.
 class CallExprAST : public ExprAST {
 protected:
-    std::string callee_;
-    std::vector<Expression> args_;
+    Symbol callee_;
+    AstList<Expression> args_;
+    friend class AstSerializer;
+    friend class Sema;
+    friend class ConstantFolder;
 public:
-    CallExprAST(const Token& callee, std::vector<Expression> args, TypeInstance ti = SALT_TYPE_LONG);
-    const std::string& callee() const;
-    const std::vector<Expression>& args() const;
-    virtual bool is_call() const override { return true; }
+    explicit CallExprAST(AstBlank) : ExprAST(ExprKind::Call) {}
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::Call; }
+    CallExprAST(const Token& callee, AstList<Expression> args, TypeInstance ti = SALT_TYPE_LONG);
+    Symbol callee() const;
+    AstList<Expression> args() const;
     virtual llvm::Value* code_gen() override;
 };
 
@@ -130,32 +195,38 @@ private:
     Expression condition_;
     Expression true_expr_;
     Expression false_expr_;
+    friend class AstSerializer;
+    friend class Sema;
+    friend class ConstantFolder;
+    friend class ExprAST;
 public:
-    virtual bool is_if() const override { return true; }
-    IfExprAST(const Token& if_tok, Expression cond, Expression true_expr, Expression false_expr, TypeInstance ti = SALT_TYPE_LONG);
+    explicit IfExprAST(AstBlank) : ExprAST(ExprKind::If) {}
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::If; }
+    Expression condition() const { return condition_; }
+    Expression true_expr() const { return true_expr_; }
+    Expression false_expr() const { return false_expr_; }
+    IfExprAST(const Token& if_tok, Expression cond, Expression true_expr, Expression false_expr);
     llvm::Value* code_gen() override;
 };
 
 class RepeatAST : public ExprAST {
 protected:
-    int line_;
-    int col_;
     Expression loop_until_expr_;
     Expression loop_body_;
+    friend class ExprAST;
 
 public:
-    RepeatAST(int line, int col, Expression loop_until_expr, Expression loop_body) :
-        line_(line), col_(col), loop_until_expr_(std::move(loop_until_expr)), loop_body_(std::move(loop_body)) { ti_ = SALT_TYPE_VOID; }
+    RepeatAST(int line, int col, Expression loop_until_expr, Expression loop_body);
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::Repeat; }
     Expression& loop_until_expr();
     Expression& loop_body();
-    int line() const;
-    int col() const;
     llvm::Value* code_gen() override;
 };
 
 class TypeExprAST : public ExprAST {
 public:
-    virtual bool is_type() const override { return true; }
+    explicit TypeExprAST(AstBlank) : ExprAST(ExprKind::Type) {}
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::Type; }
     virtual llvm::Value* code_gen() override;
     TypeExprAST(const TypeInstance& ti);
     TypeExprAST(const Token& tok);
@@ -164,8 +235,13 @@ public:
 class DerefExprAST : public ExprAST {
 protected:
     Expression expr_;
+    friend class AstSerializer;
+    friend class Sema;
+    friend class ConstantFolder;
+    friend class ExprAST;
 public:
-    virtual bool is_deref() const override { return true; }
+    explicit DerefExprAST(AstBlank) : ExprAST(ExprKind::Deref) {}
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::Deref; }
     virtual llvm::Value* code_gen() override;
     Expression& expr() { return expr_; }
     DerefExprAST(Expression expr);
@@ -175,54 +251,103 @@ class DeclarationAST {
 private:
     int line_;
     int col_;
-    std::string name_;
-    std::vector<std::unique_ptr<VariableExprAST>> args_;
+    Symbol name_;
+    AstList<VariableExprAST*> args_;
     TypeInstance ti_;
+    bool is_const_ = false;     // "const fn", calls with constant arguments are run while compiling
+    friend class AstSerializer;
 
 public:
-    DeclarationAST(const Token& tok, std::vector<std::unique_ptr<VariableExprAST>> args, TypeInstance ti = SALT_TYPE_VOID)
-    : line_(tok.line()), col_(tok.col()), name_(tok.data()), args_(std::move(args)) { ti_ = ti; }
+    explicit DeclarationAST(AstBlank) {}
+    DeclarationAST(const Token& tok, AstList<VariableExprAST*> args, TypeInstance ti = SALT_TYPE_VOID)
+    : line_(tok.line()), col_(tok.col()), name_(tok.interned()), args_(args) { ti_ = ti; }
 
     int line() const { return line_; }
     int col() const { return col_; }
-    const std::string& name() const {return name_;}
-    const std::vector<std::unique_ptr<VariableExprAST>>& args() const;
+    Symbol name() const {return name_;}
+    AstList<VariableExprAST*> args() const;
     const salt::Type* type() const { return ti_.type; } // return type of this function
     TypeInstance& type_instance() { return ti_; }
+    bool is_const() const { return is_const_; }
+    void set_const(bool is_const) { is_const_ = is_const; }
     llvm::Function* code_gen();
+
+    // Moves the declaration (and its arguments) delta lines down
+    void shift_lines(int delta);
 };
 
 class FunctionAST {
 private:
-    std::unique_ptr<DeclarationAST> decl_;
-    std::vector<Expression> body_;
+    DeclarationAST* decl_;
+    AstList<Expression> body_;
+    friend class AstSerializer;
 
 public:
-    FunctionAST(std::unique_ptr<DeclarationAST> decl, std::vector<Expression> body)
-    : decl_(std::move(decl)), body_(std::move(body)) {}
+    explicit FunctionAST(AstBlank) {}
+    FunctionAST(DeclarationAST* decl, AstList<Expression> body)
+    : decl_(decl), body_(body) {}
 
-    std::unique_ptr<DeclarationAST>& decl();
-    std::vector<Expression>& body();
+    DeclarationAST* decl();
+    AstList<Expression> body();
     llvm::Function* code_gen();
+
+    // Moves the whole function delta lines down, for when it was parsed before and the lines above it changed
+    void shift_lines(int delta);
+};
+
+// Everything parsed out of one file, in order. The nodes live in whichever AstArena
+// the file was parsed (or loaded from the AstCache) into.
+struct TranslationUnitAST {
+    std::vector<DeclarationAST*> declarations;  // extern fn
+    std::vector<FunctionAST*> functions;
+
+    // Declares every function (and everything in prelude) in the module before generating any bodies,
+    // so calls can go to functions further down the file. With a cache, functions that are in it
+    // are taken from there, and the rest are added to it
+    void code_gen(const std::vector<DeclarationAST*>& prelude, FunctionCache* cache = nullptr);
 };
 
 class ReturnAST : public ExprAST {
+    friend class Sema;
+    friend class ConstantFolder;
 public:
     Expression return_val;
-    TypeInstance expected_return_type;
+    TypeInstance expected_return_type;  // set by Sema
+    explicit ReturnAST(AstBlank) : ExprAST(ExprKind::Return) {}
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::Return; }
     ReturnAST(const Token& tok, Expression expr);
-    virtual bool is_return() const override { return true; }
     llvm::Value* code_gen() override;
 };
 
 class NewVariableAST : public ExprAST {
 protected:
-    std::unique_ptr<VariableExprAST> var_;
+    VariableExprAST* var_;
     Expression value_;
+    friend class AstSerializer;
+    friend class Sema;
+    friend class ConstantFolder;
+    friend class ExprAST;
+public:
+    explicit NewVariableAST(AstBlank) : ExprAST(ExprKind::NewVariable) {}
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::NewVariable; }
+    VariableExprAST* var() const { return var_; }
+    Expression value() const { return value_; }
+    llvm::Value* code_gen() override;
+    NewVariableAST(const Token& op, VariableExprAST* var, Expression value);
+};
+
+// A conversion the language does on its own, like the int in int + long becoming a long.
+// Only Sema makes these, so code_gen() never has to work out what to convert to what.
+class ImplicitCastExprAST : public ExprAST {
+protected:
+    Expression operand_;
+    friend class ExprAST;
+    friend class ConstantFolder;
 public:
-    virtual bool is_new_variable() const override { return true; }
+    ImplicitCastExprAST(Expression operand, const TypeInstance& ti);
+    static bool classof(const ExprAST* expr) { return expr->kind() == ExprKind::ImplicitCast; }
+    Expression operand() const { return operand_; }
     llvm::Value* code_gen() override;
-    NewVariableAST(const Token& op, std::unique_ptr<VariableExprAST> var, Expression value);
 };
 
 namespace salt {
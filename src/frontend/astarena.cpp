@@ -0,0 +1,39 @@
+#include "astarena.h"
+#include <algorithm>
+
+AstArena::AstArena() {
+    this->block_ = 0;
+    this->block_used_ = 0;
+    this->bytes_allocated_ = 0;
+}
+
+void* AstArena::allocate(size_t size, size_t align) {
+    size_t start = (block_used_ + align - 1) & ~(align - 1);
+
+    // Move on to the next block that has room, making one if needed.
+    // Blocks we skip over only happen when something is bigger than BLOCK_SIZE, which nothing in the AST is
+    while (block_ >= blocks_.size() || start + size > blocks_[block_].size) {
+        if (block_ < blocks_.size())
+            block_++;
+
+        if (block_ == blocks_.size() || blocks_[block_].size < size) {
+            const size_t block_size = std::max(BLOCK_SIZE, size);
+            blocks_.insert(blocks_.begin() + block_, Block{ std::make_unique<char[]>(block_size), block_size });
+        }
+
+        start = 0;
+    }
+
+    block_used_ = start + size;
+    bytes_allocated_ += size;
+    return blocks_[block_].data.get() + start;
+}
+
+void AstArena::rewind(const Mark& m) {
+    if (m.block > block_ || (m.block == block_ && m.block_used > block_used_))
+        salt::print_fatal("AstArena::rewind(): mark is newer than the arena");
+
+    block_ = m.block;
+    block_used_ = m.block_used;
+    bytes_allocated_ = m.bytes_allocated;
+}
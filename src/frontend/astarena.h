@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../common.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+// A list of AST nodes (or anything else) whose storage lives in an AstArena.
+// Just a pointer and a size, so it costs nothing to copy around.
+template <typename T>
+class AstList {
+private:
+    T* data_;
+    uint32_t size_;
+
+public:
+    AstList() : data_(nullptr), size_(0) {}
+    AstList(T* data, uint32_t size) : data_(data), size_(size) {}
+
+    T* begin() const                            { return data_; }
+    T* end() const                              { return data_ + size_; }
+    size_t size() const                         { return size_; }
+    bool empty() const                          { return size_ == 0; }
+    T& operator[](size_t idx) const             { return data_[idx]; }
+    T& back() const                             { return data_[size_ - 1]; }
+};
+
+// Owns every AST node of a translation unit, and the child lists of those nodes.
+// Nodes are bumped off big blocks and all go away together when the arena does (or on rewind()),
+// their destructors are never run. So nodes must not own anything themselves: they point to their
+// children and keep lists of them in AstLists.
+class AstArena {
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks_;
+    size_t block_;                  // the block we are allocating from
+    size_t block_used_;             // how much of it is taken
+    size_t bytes_allocated_;        // handed out since the last rewind, for the benchmarks
+
+    void* allocate(size_t size, size_t align);
+
+public:
+    // Where the arena was at some point, see rewind()
+    struct Mark {
+        size_t block;
+        size_t block_used;
+        size_t bytes_allocated;
+    };
+
+    AstArena();
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copies the count items at items into the arena
+    template <typename T>
+    AstList<T> copy(const T* items, size_t count) {
+        if (count == 0)
+            return AstList<T>();
+
+        T* data = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::memcpy(data, items, sizeof(T) * count);
+        return AstList<T>(data, static_cast<uint32_t>(count));
+    }
+
+    // Copies the items of scratch from start onwards into the arena, and takes them off scratch.
+    // The Parser uses one scratch vector as a stack for all its child lists, so nested lists don't need
+    // a vector of their own.
+    template <typename T>
+    AstList<T> take(std::vector<T>& scratch, size_t start) {
+        AstList<T> res = copy(scratch.data() + start, scratch.size() - start);
+        scratch.resize(start);
+        return res;
+    }
+
+    Mark mark() const { return { block_, block_used_, bytes_allocated_ }; }
+
+    // Throws away everything allocated since m was taken. The blocks are kept, to be used again.
+    void rewind(const Mark& m);
+
+    size_t bytes_allocated() const { return bytes_allocated_; }
+};
@@ -0,0 +1,561 @@
+#include "astcache.h"
+#include "types.h"
+#include "interner.h"
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include <string_view>
+#include <cstring>
+#include <cstdio>
+
+// Layout of a cache file, everything in the byte order of the machine that wrote it:
+//     "SALTAST" magic, version, key
+//     string table: count, then (length, chars) for every string. Symbols and types are indices into it,
+//                   0 meaning no symbol or no type
+//     declarations: count, then every extern fn
+//     functions:    count, then for every function its declaration and its body
+// A declaration is line, col, name, return type, whether it's a const fn and its arguments (line, col, type, name each).
+// A body is how many expressions it has, how many node records follow, and then the nodes of all its
+// expressions in post-order, so a node's children always come right before it. Both sides walk the tree
+// with a stack instead of recursing, since expressions can be nested very deeply.
+
+namespace {
+    enum NodeKind : uint8_t {
+        NODE_NULL = 0,
+        NODE_VAL,
+        NODE_VARIABLE,
+        NODE_BINARY,
+        NODE_UNARY,
+        NODE_CALL,
+        NODE_IF,
+        NODE_TYPE,
+        NODE_DEREF,
+        NODE_RETURN,
+        NODE_NEW_VARIABLE,
+        NODE_UNKNOWN,           // can't be cached (yet), the whole file isn't stored then
+    };
+
+    constexpr char MAGIC[8] = { 'S', 'A', 'L', 'T', 'A', 'S', 'T', '\0' };
+
+    NodeKind kind_of(const ExprAST* node) {
+        if (!node)
+            return NODE_NULL;
+
+        switch (node->kind()) {
+        case ExprKind::Val:             return NODE_VAL;
+        case ExprKind::Variable:        return NODE_VARIABLE;
+        case ExprKind::Binary:          return NODE_BINARY;
+        case ExprKind::Unary:           return NODE_UNARY;
+        case ExprKind::Call:            return NODE_CALL;
+        case ExprKind::If:              return NODE_IF;
+        case ExprKind::Type:            return NODE_TYPE;
+        case ExprKind::Deref:           return NODE_DEREF;
+        case ExprKind::Return:          return NODE_RETURN;
+        case ExprKind::NewVariable:     return NODE_NEW_VARIABLE;
+        default:                        return NODE_UNKNOWN;
+        }
+    }
+}
+
+// Turns a TranslationUnitAST into bytes and back. A friend of every node class.
+class AstSerializer {
+private:
+    // writing
+    std::string records_;
+    std::vector<std::string_view> strings_;
+    std::unordered_map<std::string_view, uint32_t> string_ids_;
+    std::unordered_map<const salt::Type*, std::string_view> type_keys_;    // what every type is called in salt::all_types
+
+    // reading
+    const std::string* data_;
+    size_t pos_;
+    bool failed_;
+    AstArena* arena_;
+    std::vector<Symbol> symbols_;
+    std::vector<const salt::Type*> types_;
+
+    // both
+    std::vector<std::pair<Expression, bool>> walk_;     // (node, children already pushed)
+    std::vector<Expression> values_;
+    std::vector<Expression> children_;
+    std::vector<VariableExprAST*> arg_scratch_;
+
+    template <typename T>
+    static void put(std::string& out, T val) {
+        out.append(reinterpret_cast<const char*>(&val), sizeof(T));
+    }
+
+    template <typename T>
+    void put(T val) { put(records_, val); }
+
+    uint32_t string_id(std::string_view str) {
+        auto it = string_ids_.find(str);
+        if (it != string_ids_.end())
+            return it->second;
+
+        strings_.push_back(str);
+        const uint32_t id = static_cast<uint32_t>(strings_.size());
+        string_ids_.emplace(str, id);
+        return id;
+    }
+
+    void put_symbol(Symbol sym) { put<uint32_t>(sym ? string_id(sym.str()) : 0); }
+    // Types are written as their key in salt::all_types, which isn't always their name (__ErrorTy is "<error type>")
+    void put_type(const salt::Type* type) {
+        if (!type) {
+            put<uint32_t>(0);
+            return;
+        }
+
+        if (type_keys_.empty())
+            for (const auto& [key, value] : salt::all_types)
+                type_keys_.emplace(value, key);
+
+        auto it = type_keys_.find(type);
+        put<uint32_t>(it != type_keys_.end() ? string_id(it->second) : 0);
+    }
+
+    void put_type_instance(const TypeInstance& ti) {
+        put_type(ti.type);
+        put_type(ti.pointee);
+        put<int32_t>(ti.ptr_layers);
+    }
+
+    void put_declaration(const DeclarationAST* decl) {
+        put<int32_t>(decl->line_);
+        put<int32_t>(decl->col_);
+        put_symbol(decl->name_);
+        put_type_instance(decl->ti_);
+        put<uint8_t>(decl->is_const_);
+        put<uint32_t>(static_cast<uint32_t>(decl->args_.size()));
+        for (const VariableExprAST* arg : decl->args_) {
+            put<int32_t>(arg->line());
+            put<int32_t>(arg->col());
+            put_type_instance(arg->ti_);
+            put_symbol(arg->name_);
+        }
+    }
+
+    // Pushes the children of node onto walk_ so that they come off it (and are written) in order
+    void push_children(Expression node) {
+        children_.clear();
+        node->children(children_);
+        for (auto it = children_.rbegin(); it != children_.rend(); ++it)
+            walk_.push_back({ *it, false });
+    }
+
+    // The children of node have already been written
+    void put_node(Expression node, NodeKind kind) {
+        put<uint8_t>(kind);
+        if (kind == NODE_NULL)
+            return;
+
+        put<int32_t>(node->line());
+        put<int32_t>(node->col());
+        put_type_instance(node->ti_);
+
+        switch (kind) {
+        case NODE_VAL: {
+            const ValExprAST* val = static_cast<ValExprAST*>(node);
+            uint64_t bits;
+            std::memcpy(&bits, &val->val_, sizeof(bits));
+            put<uint64_t>(bits);
+            put_symbol(val->str_);
+            break;
+        }
+        case NODE_VARIABLE:
+            put_symbol(static_cast<VariableExprAST*>(node)->name_);
+            break;
+        case NODE_BINARY:
+            put<int16_t>(static_cast<int16_t>(static_cast<BinaryExprAST*>(node)->op_));
+            break;
+        case NODE_UNARY:
+            put<int16_t>(static_cast<int16_t>(static_cast<UnaryExprAST*>(node)->op_));
+            break;
+        case NODE_CALL:
+            put_symbol(static_cast<CallExprAST*>(node)->callee_);
+            put<uint32_t>(static_cast<uint32_t>(static_cast<CallExprAST*>(node)->args_.size()));
+            break;
+        case NODE_RETURN:
+            put_type_instance(static_cast<ReturnAST*>(node)->expected_return_type);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // False if the body has a node that can't be cached
+    bool put_body(const AstList<Expression>& body) {
+        put<uint32_t>(static_cast<uint32_t>(body.size()));
+        const size_t count_pos = records_.size();
+        put<uint32_t>(0);
+
+        uint32_t records = 0;
+        for (Expression expr : body) {
+            walk_.push_back({ expr, false });
+            while (!walk_.empty()) {
+                auto [node, expanded] = walk_.back();
+                const NodeKind kind = kind_of(node);
+                if (kind == NODE_UNKNOWN) {
+                    walk_.clear();
+                    return false;
+                }
+
+                if (expanded || kind == NODE_NULL) {
+                    walk_.pop_back();
+                    put_node(node, kind);
+                    records++;
+                } else {
+                    walk_.back().second = true;
+                    push_children(node);
+                }
+            }
+        }
+
+        std::memcpy(&records_[count_pos], &records, sizeof(records));
+        return true;
+    }
+
+    template <typename T>
+    T get() {
+        T val = T();
+        if (failed_ || pos_ + sizeof(T) > data_->size()) {
+            failed_ = true;
+            return val;
+        }
+        std::memcpy(&val, data_->data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return val;
+    }
+
+    uint32_t get_index(size_t size) {
+        const uint32_t idx = get<uint32_t>();
+        if (idx > size)
+            failed_ = true;
+        return failed_ ? 0 : idx;
+    }
+
+    // An operator token, that has to be an operator the parser would have made a node for
+    Token_e get_op(bool prefix) {
+        const int16_t op = get<int16_t>();
+        if (op < TOK_MIN || op >= TOK_TOTAL) {
+            failed_ = true;
+            return TOK_NONE;
+        }
+
+        const Token_e tok = static_cast<Token_e>(op);
+        if (prefix ? !Operator::is_prefix(tok) : !Operator::is_infix(tok))
+            failed_ = true;
+        return tok;
+    }
+
+    Symbol get_symbol() {
+        const uint32_t idx = get_index(symbols_.size());
+        return idx ? symbols_[idx - 1] : Symbol();
+    }
+
+    const salt::Type* get_type() {
+        const uint32_t idx = get_index(types_.size());
+        if (idx && !types_[idx - 1])
+            failed_ = true; // a type this compiler doesn't have
+        return idx ? types_[idx - 1] : nullptr;
+    }
+
+    TypeInstance get_type_instance() {
+        TypeInstance ti;
+        ti.type = get_type();
+        ti.pointee = get_type();
+        ti.ptr_layers = get<int32_t>();
+        return ti;
+    }
+
+    bool get_strings() {
+        const uint32_t count = get<uint32_t>();
+        for (uint32_t i = 0; i < count && !failed_; i++) {
+            const uint32_t len = get<uint32_t>();
+            if (failed_ || pos_ + len > data_->size())
+                return false;
+
+            const std::string_view str(data_->data() + pos_, len);
+            pos_ += len;
+            symbols_.push_back(Interner::get()->intern(str));
+
+            auto type = salt::all_types.find(std::string(str));
+            types_.push_back(type != salt::all_types.end() ? type->second : nullptr);
+        }
+        return !failed_;
+    }
+
+    DeclarationAST* get_declaration() {
+        DeclarationAST* decl = arena_->make<DeclarationAST>(AstBlank());
+        decl->line_ = get<int32_t>();
+        decl->col_ = get<int32_t>();
+        decl->name_ = get_symbol();
+        decl->ti_ = get_type_instance();
+        decl->is_const_ = get<uint8_t>() != 0;
+
+        const uint32_t arg_count = get<uint32_t>();
+        arg_scratch_.clear();
+        for (uint32_t i = 0; i < arg_count && !failed_; i++) {
+            VariableExprAST* arg = arena_->make<VariableExprAST>(AstBlank());
+            arg->line_ = get<int32_t>();
+            arg->col_ = get<int32_t>();
+            arg->ti_ = get_type_instance();
+            arg->name_ = get_symbol();
+            arg_scratch_.push_back(arg);
+        }
+        decl->args_ = arena_->copy(arg_scratch_.data(), arg_scratch_.size());
+        return failed_ ? nullptr : decl;
+    }
+
+    // Takes the last count nodes off values_, or fails if there aren't that many
+    bool pop_children(size_t count, Expression* out) {
+        if (values_.size() < count) {
+            failed_ = true;
+            return false;
+        }
+        std::copy(values_.end() - count, values_.end(), out);
+        values_.resize(values_.size() - count);
+        return true;
+    }
+
+    Expression get_node(NodeKind kind) {
+        Expression children[3] = {};
+        Expression node = nullptr;
+
+        switch (kind) {
+        case NODE_VAL:          node = arena_->make<ValExprAST>(AstBlank()); break;
+        case NODE_VARIABLE:     node = arena_->make<VariableExprAST>(AstBlank()); break;
+        case NODE_BINARY:       node = arena_->make<BinaryExprAST>(AstBlank()); break;
+        case NODE_UNARY:        node = arena_->make<UnaryExprAST>(AstBlank()); break;
+        case NODE_CALL:         node = arena_->make<CallExprAST>(AstBlank()); break;
+        case NODE_IF:           node = arena_->make<IfExprAST>(AstBlank()); break;
+        case NODE_TYPE:         node = arena_->make<TypeExprAST>(AstBlank()); break;
+        case NODE_DEREF:        node = arena_->make<DerefExprAST>(AstBlank()); break;
+        case NODE_RETURN:       node = arena_->make<ReturnAST>(AstBlank()); break;
+        case NODE_NEW_VARIABLE: node = arena_->make<NewVariableAST>(AstBlank()); break;
+        default:
+            failed_ = true;
+            return nullptr;
+        }
+
+        node->line_ = get<int32_t>();
+        node->col_ = get<int32_t>();
+        node->ti_ = get_type_instance();
+
+        switch (kind) {
+        case NODE_VAL: {
+            ValExprAST* val = static_cast<ValExprAST*>(node);
+            const uint64_t bits = get<uint64_t>();
+            std::memcpy(&val->val_, &bits, sizeof(bits));
+            val->str_ = get_symbol();
+            break;
+        }
+        case NODE_VARIABLE:
+            static_cast<VariableExprAST*>(node)->name_ = get_symbol();
+            break;
+        case NODE_BINARY: {
+            BinaryExprAST* bin = static_cast<BinaryExprAST*>(node);
+            bin->op_ = get_op(false);
+            if (pop_children(2, children)) {
+                bin->lhs_ = children[0];
+                bin->rhs_ = children[1];
+            }
+            break;
+        }
+        case NODE_UNARY: {
+            UnaryExprAST* un = static_cast<UnaryExprAST*>(node);
+            un->op_ = get_op(true);
+            if (pop_children(1, children))
+                un->operand_ = children[0];
+            break;
+        }
+        case NODE_CALL: {
+            CallExprAST* call = static_cast<CallExprAST*>(node);
+            call->callee_ = get_symbol();
+            const uint32_t arg_count = get<uint32_t>();
+            if (failed_ || values_.size() < arg_count) {
+                failed_ = true;
+                break;
+            }
+            call->args_ = arena_->copy(values_.data() + values_.size() - arg_count, arg_count);
+            values_.resize(values_.size() - arg_count);
+            break;
+        }
+        case NODE_IF: {
+            IfExprAST* if_expr = static_cast<IfExprAST*>(node);
+            if (pop_children(3, children)) {
+                if_expr->condition_ = children[0];
+                if_expr->true_expr_ = children[1];
+                if_expr->false_expr_ = children[2];
+            }
+            break;
+        }
+        case NODE_DEREF:
+            if (pop_children(1, children))
+                static_cast<DerefExprAST*>(node)->expr_ = children[0];
+            break;
+        case NODE_RETURN: {
+            ReturnAST* ret = static_cast<ReturnAST*>(node);
+            ret->expected_return_type = get_type_instance();
+            if (pop_children(1, children))
+                ret->return_val = children[0];
+            break;
+        }
+        case NODE_NEW_VARIABLE: {
+            NewVariableAST* new_var = static_cast<NewVariableAST*>(node);
+            if (pop_children(2, children)) {
+                new_var->var_ = llvm::dyn_cast_or_null<VariableExprAST>(children[0]);
+                if (!new_var->var_)
+                    failed_ = true;
+                new_var->value_ = children[1];
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+        return failed_ ? nullptr : node;
+    }
+
+    bool get_body(AstList<Expression>& body) {
+        const uint32_t count = get<uint32_t>();
+        const uint32_t records = get<uint32_t>();
+
+        values_.clear();
+        for (uint32_t i = 0; i < records && !failed_; i++) {
+            const NodeKind kind = static_cast<NodeKind>(get<uint8_t>());
+            if (kind == NODE_NULL)
+                values_.push_back(nullptr);
+            else if (Expression node = get_node(kind))
+                values_.push_back(node);
+        }
+
+        if (failed_ || values_.size() != count)
+            return false;
+
+        body = arena_->copy(values_.data(), values_.size());
+        return true;
+    }
+
+public:
+    AstSerializer() : data_(nullptr), pos_(0), failed_(false), arena_(nullptr) {}
+
+    // False if unit has something in it that can't be cached
+    bool write(const TranslationUnitAST& unit, uint64_t key, std::string& out) {
+        put<uint32_t>(static_cast<uint32_t>(unit.declarations.size()));
+        for (const DeclarationAST* decl : unit.declarations)
+            put_declaration(decl);
+
+        put<uint32_t>(static_cast<uint32_t>(unit.functions.size()));
+        for (const FunctionAST* fn : unit.functions) {
+            put_declaration(fn->decl_);
+            if (!put_body(fn->body_))
+                return false;
+        }
+
+        out.clear();
+        out.append(MAGIC, sizeof(MAGIC));
+        put<uint32_t>(out, AstCache::VERSION);
+        put<uint64_t>(out, key);
+        put<uint32_t>(out, static_cast<uint32_t>(strings_.size()));
+        for (std::string_view str : strings_) {
+            put<uint32_t>(out, static_cast<uint32_t>(str.size()));
+            out.append(str.data(), str.size());
+        }
+        out += records_;
+        return true;
+    }
+
+    // False if data isn't a (complete) cache file for key
+    bool read(const std::string& data, uint64_t key, AstArena& arena, TranslationUnitAST& unit) {
+        data_ = &data;
+        arena_ = &arena;
+
+        if (data.size() < sizeof(MAGIC) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+            return false;
+        pos_ = sizeof(MAGIC);
+
+        if (get<uint32_t>() != AstCache::VERSION || get<uint64_t>() != key || !get_strings())
+            return false;
+
+        const uint32_t decl_count = get<uint32_t>();
+        for (uint32_t i = 0; i < decl_count && !failed_; i++)
+            if (DeclarationAST* decl = get_declaration())
+                unit.declarations.push_back(decl);
+
+        const uint32_t fn_count = get<uint32_t>();
+        for (uint32_t i = 0; i < fn_count && !failed_; i++) {
+            FunctionAST* fn = arena_->make<FunctionAST>(AstBlank());
+            fn->decl_ = get_declaration();
+            if (fn->decl_ && get_body(fn->body_))
+                unit.functions.push_back(fn);
+        }
+
+        if (failed_ || pos_ != data.size()) {
+            unit.declarations.clear();
+            unit.functions.clear();
+            return false;
+        }
+        return true;
+    }
+};
+
+
+AstCache::AstCache(const std::string& dir, uint64_t seed) {
+    this->dir_ = dir;
+    // With salt::BUILD_ID, ASTs made by another parser (or with other token numbers) are never loaded
+    this->seed_ = salt::hash_bytes(salt::BUILD_ID, std::strlen(salt::BUILD_ID), seed ^ VERSION);
+    this->hits_ = 0;
+    this->misses_ = 0;
+}
+
+uint64_t AstCache::hash_file(const std::string& file_name) {
+    std::string text;
+    salt::read_file(file_name, text);
+    return salt::hash_bytes(text.data(), text.size());
+}
+
+std::string AstCache::path_of(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.ast", (unsigned long long) key);
+    return (std::filesystem::path(dir_) / name).string();
+}
+
+bool AstCache::load(const std::string& file_name, AstArena& arena, TranslationUnitAST& unit) {
+    std::string text;
+    std::string data;
+    if (!salt::read_file(file_name, text)) {
+        misses_++;
+        return false;
+    }
+
+    const uint64_t key = salt::hash_bytes(text.data(), text.size(), seed_);
+    if (!salt::read_file(path_of(key), data) || !AstSerializer().read(data, key, arena, unit)) {
+        salt::dboutv << "AST cache miss: " << file_name << '\n';
+        misses_++;
+        return false;
+    }
+
+    salt::dboutv << "AST cache hit: " << file_name << " (" << data.size() << " bytes)\n";
+    hits_++;
+    return true;
+}
+
+void AstCache::store(const std::string& file_name, const TranslationUnitAST& unit) {
+    std::string text;
+    std::string data;
+    if (!salt::read_file(file_name, text))
+        return;
+
+    const uint64_t key = salt::hash_bytes(text.data(), text.size(), seed_);
+    if (!AstSerializer().write(unit, key, data)) {
+        salt::dboutv << "AST cache: " << file_name << " has nodes that can't be cached\n";
+        return;
+    }
+
+    const std::string path = path_of(key);
+    if (!salt::write_file_atomic(path, data))
+        salt::dbout << "AST cache: could not write " << path << '\n';
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ast.h"
+#include "astarena.h"
+#include <string>
+#include <cstdint>
+
+// Keeps the ASTs of files that were parsed before in a directory, so a file that didn't change since
+// doesn't have to be lexed and parsed again: it gets loaded from the cache file with one read instead.
+// Cache files are named after a hash of the source text (and of everything else the AST depends on,
+// passed in as the seed), so there is nothing to invalidate, a changed file just doesn't match anymore.
+// Anything wrong with a cache file (truncated, old version, unknown type...) is a miss, never an error.
+class AstCache {
+private:
+    std::string dir_;
+    uint64_t seed_;
+    size_t hits_;
+    size_t misses_;
+
+    std::string path_of(uint64_t key) const;
+
+public:
+    // Goes up whenever the format of the cache files or the AST the parser makes changes
+    static constexpr uint32_t VERSION = 3;
+
+    AstCache(const std::string& dir, uint64_t seed);
+
+    // salt::hash_bytes() of the contents of file_name
+    static uint64_t hash_file(const std::string& file_name);
+
+    // Fills unit with the cached AST of file_name, with its nodes in arena. False on a miss,
+    // in which case unit is left empty (but arena may have been used, rewind it if that matters)
+    bool load(const std::string& file_name, AstArena& arena, TranslationUnitAST& unit);
+
+    // Writes unit to the cache as the AST of file_name. Only store files that parsed without errors or warnings,
+    // loading an AST doesn't report the errors or warnings that came with it
+    void store(const std::string& file_name, const TranslationUnitAST& unit);
+
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+};
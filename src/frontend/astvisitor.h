@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ast.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// Calls the visit_ function for the kind of node it gets, with a switch on ExprAST::kind() instead
+// of a chain of virtual calls. Derive from it with yourself as Derived (like clang's StmtVisitor)
+// and hide the visit_ functions of the nodes you care about, everything else ends up in visit_expr:
+//
+//   class CallCounter : public ExprVisitor<CallCounter> {
+//   public:
+//       int calls = 0;
+//       void visit_call(CallExprAST* call) { calls++; }
+//   };
+template <typename Derived, typename RetTy = void>
+class ExprVisitor {
+private:
+    Derived* self() { return static_cast<Derived*>(this); }
+    std::vector<Expression> stack_;
+    std::vector<std::pair<Expression, bool>> bottom_up_stack_;  // and whether its children are done
+    std::vector<Expression> children_;
+
+public:
+    RetTy visit(Expression expr) {
+        switch (expr->kind()) {
+        case ExprKind::Val:             return self()->visit_val(static_cast<ValExprAST*>(expr));
+        case ExprKind::Variable:        return self()->visit_variable(static_cast<VariableExprAST*>(expr));
+        case ExprKind::Binary:          return self()->visit_binary(static_cast<BinaryExprAST*>(expr));
+        case ExprKind::Unary:           return self()->visit_unary(static_cast<UnaryExprAST*>(expr));
+        case ExprKind::Call:            return self()->visit_call(static_cast<CallExprAST*>(expr));
+        case ExprKind::If:              return self()->visit_if(static_cast<IfExprAST*>(expr));
+        case ExprKind::Repeat:          return self()->visit_repeat(static_cast<RepeatAST*>(expr));
+        case ExprKind::Type:            return self()->visit_type(static_cast<TypeExprAST*>(expr));
+        case ExprKind::Deref:           return self()->visit_deref(static_cast<DerefExprAST*>(expr));
+        case ExprKind::Return:          return self()->visit_return(static_cast<ReturnAST*>(expr));
+        case ExprKind::NewVariable:     return self()->visit_new_variable(static_cast<NewVariableAST*>(expr));
+        case ExprKind::ImplicitCast:    return self()->visit_implicit_cast(static_cast<ImplicitCastExprAST*>(expr));
+        }
+        return self()->visit_expr(expr);
+    }
+
+    // Visits root and every node below it, parents before their children and otherwise in source order.
+    // Doesn't recurse, so it is fine with expressions nested as deep as the parser allows.
+    void visit_tree(Expression root) {
+        const size_t base = stack_.size();
+        stack_.push_back(root);
+        while (stack_.size() > base) {
+            Expression expr = stack_.back();
+            stack_.pop_back();
+            if (!expr)
+                continue;
+
+            self()->visit(expr);
+            const size_t first_child = stack_.size();
+            expr->children(stack_);
+            std::reverse(stack_.begin() + first_child, stack_.end());
+        }
+    }
+
+    // Visits every node below root before root itself, so whatever a node's children worked out
+    // is there by the time the node gets visited. Also doesn't recurse.
+    void visit_tree_bottom_up(Expression root) {
+        const size_t base = bottom_up_stack_.size();
+        bottom_up_stack_.emplace_back(root, false);
+        while (bottom_up_stack_.size() > base) {
+            auto [expr, children_done] = bottom_up_stack_.back();
+            if (!expr) {
+                bottom_up_stack_.pop_back();
+                continue;
+            }
+            if (children_done) {
+                bottom_up_stack_.pop_back();
+                self()->visit(expr);
+                continue;
+            }
+
+            bottom_up_stack_.back().second = true;
+            children_.clear();
+            expr->children(children_);
+            for (auto it = children_.rbegin(); it != children_.rend(); it++)
+                bottom_up_stack_.emplace_back(*it, false);
+        }
+    }
+
+    // Every visit_ function ends up here unless it's hidden
+    RetTy visit_expr(Expression)                            { return RetTy(); }
+
+    RetTy visit_val(ValExprAST* expr)                       { return self()->visit_expr(expr); }
+    RetTy visit_variable(VariableExprAST* expr)             { return self()->visit_expr(expr); }
+    RetTy visit_binary(BinaryExprAST* expr)                 { return self()->visit_expr(expr); }
+    RetTy visit_unary(UnaryExprAST* expr)                   { return self()->visit_expr(expr); }
+    RetTy visit_call(CallExprAST* expr)                     { return self()->visit_expr(expr); }
+    RetTy visit_if(IfExprAST* expr)                         { return self()->visit_expr(expr); }
+    RetTy visit_repeat(RepeatAST* expr)                     { return self()->visit_expr(expr); }
+    RetTy visit_type(TypeExprAST* expr)                     { return self()->visit_expr(expr); }
+    RetTy visit_deref(DerefExprAST* expr)                   { return self()->visit_expr(expr); }
+    RetTy visit_return(ReturnAST* expr)                     { return self()->visit_expr(expr); }
+    RetTy visit_new_variable(NewVariableAST* expr)          { return self()->visit_expr(expr); }
+    RetTy visit_implicit_cast(ImplicitCastExprAST* expr)    { return self()->visit_expr(expr); }
+};
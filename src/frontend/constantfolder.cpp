@@ -0,0 +1,212 @@
+#include "constantfolder.h"
+#include "types.h"
+
+using namespace salt;
+
+// A number or a bool. Strings and null are constants too, but there is nothing to fold them into
+static ValExprAST* as_constant(Expression expr) {
+    ValExprAST* val = llvm::dyn_cast_or_null<ValExprAST>(expr);
+    if (!val || val->ptr_layers() || !val->type())
+        return nullptr;
+
+    const llvm::Type* type = val->type()->get();
+    return type->isIntegerTy() || type->isFloatingPointTy() ? val : nullptr;
+}
+
+static ConstValue value_of(const ValExprAST* val) {
+    if (val->type()->get()->isFloatingPointTy())
+        return ConstValue::of_float(val->to_double(), val->type());
+    return ConstValue::of_int(val->to_int(), val->type());
+}
+
+// Finds the variables a function assigns to after creating them
+class AssignmentFinder : public ExprVisitor<AssignmentFinder> {
+private:
+    std::unordered_set<Symbol>& assigned_;
+
+public:
+    explicit AssignmentFinder(std::unordered_set<Symbol>& assigned) : assigned_(assigned) {}
+
+    void visit_binary(BinaryExprAST* expr) {
+        if (expr->op() == TOK_ASSIGN)
+            if (VariableExprAST* var = llvm::dyn_cast<VariableExprAST>(expr->lhs()))
+                assigned_.insert(var->name());
+    }
+};
+
+ConstantFolder::ConstantFolder(const std::string& file_name, DiagnosticSink& diagnostics, AstArena& arena, ConstEvalLimits limits) :
+    file_name_(file_name), diagnostics_(diagnostics), arena_(arena), evaluator_(const_fns_, limits) {}
+
+ValExprAST* ConstantFolder::make_val(ExprAST* at, const ConstValue& val) {
+    ValExprAST* res = arena_.make<ValExprAST>(AstBlank());
+    res->copy_location(at);
+    res->ti_ = val.type;
+    if (val.is_float())
+        res->val_.f64 = val.f64;
+    else
+        res->val_.i64 = val.i64;
+    return res;
+}
+
+// nullptr if res is an Error, the folder leaves those for the runtime
+ValExprAST* ConstantFolder::try_make_val(ExprAST* at, Result<ConstValue> res) {
+    return res ? make_val(at, res.unwrap()) : nullptr;
+}
+
+ValExprAST* ConstantFolder::fold_call(CallExprAST* call) {
+    auto it = const_fns_.find(call->callee_);
+    if (it == const_fns_.end())
+        return nullptr;
+
+    args_.clear();
+    for (Expression arg : call->args_) {
+        ValExprAST* val = as_constant(arg);
+        if (!val)
+            return nullptr;
+        args_.push_back(value_of(val));
+    }
+
+    Result<ConstValue> res = evaluator_.call(it->second, args_);
+    if (res) {
+        evaluated_++;
+        return make_val(call, res.unwrap());
+    }
+
+    // Where in the const fn it happened, which isn't always in this call
+    const Error err = res.unwrap_err();
+    const std::string where = file_name_ + " - " + std::to_string(call->line()) + ':' + std::to_string(call->col()) + ": ";
+    if (err.code() == ErrorCode::LIMIT)
+        diagnostics_.error(where + f_string("evaluating %s took %s (stopped at %u:%u)",
+            call->callee_.c_str(), err.message(), err.line(), err.col()));
+    else
+        diagnostics_.warning(where + f_string("%s is left to be called at runtime: %s at %u:%u",
+            call->callee_.c_str(), err.message(), err.line(), err.col()));
+    return nullptr;
+}
+
+Expression ConstantFolder::fold_expr(Expression expr) {
+    switch (expr->kind()) {
+    case ExprKind::Variable: {
+        // a copy, so every node still has one parent
+        auto it = constants_.find(static_cast<VariableExprAST*>(expr)->name());
+        if (it == constants_.end())
+            return nullptr;
+        return make_val(expr, value_of(it->second));
+    }
+    case ExprKind::ImplicitCast: {
+        ImplicitCastExprAST* cast = static_cast<ImplicitCastExprAST*>(expr);
+        ValExprAST* operand = as_constant(cast->operand_);
+        return operand ? try_make_val(cast, value_of(operand).convert(cast->type())) : nullptr;
+    }
+    case ExprKind::Unary: {
+        UnaryExprAST* unary = static_cast<UnaryExprAST*>(expr);
+        ValExprAST* operand = as_constant(unary->operand_);
+        return operand ? try_make_val(unary, value_of(operand).apply(unary->op_, unary->type())) : nullptr;
+    }
+    case ExprKind::Binary: {
+        BinaryExprAST* binary = static_cast<BinaryExprAST*>(expr);
+        ValExprAST* lhs = as_constant(binary->lhs_);
+        if (!lhs || binary->op_ == TOK_ASSIGN)
+            return nullptr;
+        if (binary->op_ == TOK_AS)
+            return binary->ptr_layers() ? nullptr : try_make_val(binary, value_of(lhs).convert(binary->type()));
+
+        // Sema gave both operands the same type
+        ValExprAST* rhs = as_constant(binary->rhs_);
+        return rhs ? try_make_val(binary, value_of(lhs).apply(binary->op_, value_of(rhs), binary->type())) : nullptr;
+    }
+    case ExprKind::Call:
+        return fold_call(static_cast<CallExprAST*>(expr));
+    case ExprKind::If: {
+        // Sema already made both arms the type of the if
+        IfExprAST* if_expr = static_cast<IfExprAST*>(expr);
+        ValExprAST* condition = as_constant(if_expr->condition_);
+        if (!condition)
+            return nullptr;
+        return condition->val_.i64 ? if_expr->true_expr_ : if_expr->false_expr_;
+    }
+    default:
+        return nullptr;
+    }
+}
+
+void ConstantFolder::fold_slot(Expression& slot) {
+    if (!slot)
+        return;
+    if (Expression folded = fold_expr(slot)) {
+        slot = folded;
+        folded_++;
+    }
+}
+
+// Children are visited first, so all a node has to do is fold the children it has now
+void ConstantFolder::visit_expr(Expression expr) {
+    switch (expr->kind()) {
+    case ExprKind::Binary: {
+        BinaryExprAST* binary = static_cast<BinaryExprAST*>(expr);
+        if (binary->op_ != TOK_ASSIGN)
+            fold_slot(binary->lhs_);
+        fold_slot(binary->rhs_);
+        break;
+    }
+    case ExprKind::Unary:
+        fold_slot(static_cast<UnaryExprAST*>(expr)->operand_);
+        break;
+    case ExprKind::Call:
+        for (Expression& arg : static_cast<CallExprAST*>(expr)->args_)
+            fold_slot(arg);
+        break;
+    case ExprKind::If: {
+        IfExprAST* if_expr = static_cast<IfExprAST*>(expr);
+        fold_slot(if_expr->condition_);
+        fold_slot(if_expr->true_expr_);
+        fold_slot(if_expr->false_expr_);
+        break;
+    }
+    case ExprKind::Deref:
+        fold_slot(static_cast<DerefExprAST*>(expr)->expr_);
+        break;
+    case ExprKind::Return:
+        fold_slot(static_cast<ReturnAST*>(expr)->return_val);
+        break;
+    case ExprKind::ImplicitCast:
+        fold_slot(static_cast<ImplicitCastExprAST*>(expr)->operand_);
+        break;
+    case ExprKind::NewVariable: {
+        // Only at the top level, one in an if arm might not have been made by the time it's used
+        NewVariableAST* new_var = static_cast<NewVariableAST*>(expr);
+        fold_slot(new_var->value_);
+        if (expr == statement_ && !assigned_.count(new_var->var_->name()))
+            if (ValExprAST* val = as_constant(new_var->value_))
+                constants_[new_var->var_->name()] = val;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void ConstantFolder::fold_function(FunctionAST* fn) {
+    assigned_.clear();
+    constants_.clear();
+    AssignmentFinder finder(assigned_);
+    for (Expression statement : fn->body())
+        finder.visit_tree(statement);
+
+    for (Expression& statement : fn->body()) {
+        statement_ = statement;
+        visit_tree_bottom_up(statement);
+        fold_slot(statement);
+    }
+    statement_ = nullptr;
+}
+
+void ConstantFolder::fold(TranslationUnitAST& unit) {
+    const_fns_.clear();
+    for (FunctionAST* fn : unit.functions)
+        if (fn->decl()->is_const())
+            const_fns_[fn->decl()->name()] = fn;
+
+    for (FunctionAST* fn : unit.functions)
+        fold_function(fn);
+}
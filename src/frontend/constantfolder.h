@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ast.h"
+#include "astvisitor.h"
+#include "astarena.h"
+#include "constevaluator.h"
+#include "constvalue.h"
+#include "diagnostics.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Evaluates constant subtrees of a checked AST (run it after Sema, on a unit without errors),
+// so code_gen() gets 5 instead of (int) 2 + (int) 3, and only the arm of an if with a constant condition.
+// Constants are computed like the IR that code_gen() would have made computes them, see ConstValue.
+// Anything that would be poison or trap at runtime (dividing by 0, shifting by too much, a float that doesn't fit an int) is left alone.
+//
+// Variables that get a constant when they are created (at the top level of a function) and are never
+// assigned to again are replaced by that constant too.
+//
+// Calls to a const fn with only constant arguments are run by a ConstEvaluator and replaced by what they return.
+// A call that runs into the limits is an error, one that would do something undefined gets a warning and
+// is left for the runtime. Check the DiagnosticSink for errors again before code_gen().
+class ConstantFolder : public ExprVisitor<ConstantFolder> {
+private:
+    std::string file_name_;
+    DiagnosticSink& diagnostics_;
+    AstArena& arena_;
+    std::unordered_set<Symbol> assigned_;                   // variables of this function that are assigned to
+    std::unordered_map<Symbol, ValExprAST*> constants_;     // and the ones that have a constant value
+    std::unordered_map<Symbol, FunctionAST*> const_fns_;
+    ConstEvaluator evaluator_;
+    std::vector<ConstValue> args_;
+    Expression statement_ = nullptr;
+    size_t folded_ = 0;
+    size_t evaluated_ = 0;
+
+    ValExprAST* make_val(ExprAST* at, const ConstValue& val);
+    ValExprAST* try_make_val(ExprAST* at, salt::Result<ConstValue> res);
+
+    ValExprAST* fold_call(CallExprAST* call);
+
+    // What expr can be replaced with, or nullptr if it isn't constant. Its children are already folded
+    Expression fold_expr(Expression expr);
+    void fold_slot(Expression& slot);
+
+    void fold_function(FunctionAST* fn);
+
+    friend class ExprVisitor<ConstantFolder>;
+    void visit_expr(Expression expr);
+
+public:
+    // file_name is only for the messages. New constants are made in arena, which should be the one the unit was parsed into
+    ConstantFolder(const std::string& file_name, DiagnosticSink& diagnostics, AstArena& arena, ConstEvalLimits limits = {});
+
+    void fold(TranslationUnitAST& unit);
+
+    // How many expressions were replaced by a constant (or by one of their arms) so far
+    size_t folded() const { return folded_; }
+
+    // How many of those were calls to a const fn
+    size_t evaluated() const { return evaluated_; }
+};
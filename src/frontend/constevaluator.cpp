@@ -0,0 +1,238 @@
+#include "constevaluator.h"
+
+using namespace salt;
+
+static Error error_at(Expression expr, const char* message, ErrorCode code = ErrorCode::GENERIC) {
+    return Error(message, code, uint32_t(expr->line()), uint32_t(expr->col()));
+}
+
+static Error error_at(Expression expr, const Error& err) {
+    return err.at(uint32_t(expr->line()), uint32_t(expr->col()));
+}
+
+// A number or a bool, strings and null can't be anything in a const fn
+static bool is_number(const ValExprAST* val) {
+    if (val->ptr_layers() || !val->type())
+        return false;
+    const llvm::Type* type = val->type()->get();
+    return type->isIntegerTy() || type->isFloatingPointTy();
+}
+
+size_t ConstEvaluator::memory_used() const {
+    return work_.size() * sizeof(Work)
+        + values_.size() * sizeof(ConstValue)
+        + frames_.size() * sizeof(Frame)
+        + locals_.size() * sizeof(locals_[0]);
+}
+
+// The arguments are the last arg_count values, they become the first locals of fn
+void ConstEvaluator::push_frame(FunctionAST* fn, size_t arg_count) {
+    const Frame frame = { fn, locals_.size(), work_.size(), values_.size() - arg_count, 0 };
+    AstList<VariableExprAST*> params = fn->decl()->args();
+    for (size_t i = 0; i < arg_count; i++)
+        locals_.emplace_back(params[i]->name(), values_[frame.values_base + i]);
+    values_.resize(frame.values_base);
+    frames_.push_back(frame);
+}
+
+// The newest one, in case an if arm made a variable that is made again later
+ConstValue* ConstEvaluator::find_local(Symbol name) {
+    for (size_t i = locals_.size(); i > frames_.back().locals_base; i--)
+        if (locals_[i - 1].first == name)
+            return &locals_[i - 1].second;
+    return nullptr;
+}
+
+Result<void> ConstEvaluator::step_call(CallExprAST* call, uint32_t state) {
+    AstList<Expression> args = call->args();
+    if (state < args.size()) {
+        work_.push_back({ args[state], 0 });
+        return Result_e::OK;
+    }
+
+    // Came back from the callee, its value is on top already
+    if (state > args.size()) {
+        work_.pop_back();
+        return Result_e::OK;
+    }
+
+    auto it = const_fns_.find(call->callee());
+    if (it == const_fns_.end())
+        return error_at(call, "a function without a body in this file is called");
+    push_frame(it->second, args.size());
+    return Result_e::OK;
+}
+
+Result<void> ConstEvaluator::step() {
+    Frame& frame = frames_.back();
+
+    // Between two statements: forget what the last one was worth, and start the next one
+    if (work_.size() == frame.work_base) {
+        values_.resize(frame.values_base);
+        AstList<Expression> body = frame.fn->body();
+        if (frame.next_statement == body.size()) {
+            DeclarationAST* decl = frame.fn->decl();
+            return Error("the end of a function is reached without a return", ErrorCode::GENERIC, decl->line(), decl->col());
+        }
+        work_.push_back({ body[frame.next_statement++], 0 });
+        return Result_e::OK;
+    }
+
+    // Taken now, since pushing a child moves work_ around
+    const Expression expr = work_.back().expr;
+    const uint32_t state = work_.back().state++;
+    auto push = [this](Expression child) {
+        work_.push_back({ child, 0 });
+        return Result<void>(Result_e::OK);
+    };
+    auto done = [this](const ConstValue& val) {
+        work_.pop_back();
+        values_.push_back(val);
+        return Result<void>(Result_e::OK);
+    };
+    auto pop = [this]() {
+        const ConstValue val = values_.back();
+        values_.pop_back();
+        return val;
+    };
+
+    switch (expr->kind()) {
+    case ExprKind::Val: {
+        ValExprAST* val = static_cast<ValExprAST*>(expr);
+        if (!is_number(val))
+            return error_at(expr, "a value that isn't a number is used");
+        return done(val->type()->get()->isFloatingPointTy()
+            ? ConstValue::of_float(val->to_double(), val->type())
+            : ConstValue::of_int(val->to_int(), val->type()));
+    }
+
+    case ExprKind::Variable: {
+        const ConstValue* val = find_local(static_cast<VariableExprAST*>(expr)->name());
+        if (!val)
+            return error_at(expr, "a variable is read before it was made");
+        return done(*val);
+    }
+
+    case ExprKind::ImplicitCast:
+    case ExprKind::Unary: {
+        Expression operand = expr->kind() == ExprKind::Unary
+            ? static_cast<UnaryExprAST*>(expr)->operand()
+            : static_cast<ImplicitCastExprAST*>(expr)->operand();
+        if (state == 0)
+            return push(operand);
+
+        Result<ConstValue> res = expr->kind() == ExprKind::Unary
+            ? pop().apply(static_cast<UnaryExprAST*>(expr)->op(), expr->type())
+            : pop().convert(expr->type());
+        if (!res)
+            return error_at(expr, res.unwrap_err());
+        return done(res.unwrap());
+    }
+
+    case ExprKind::Binary: {
+        BinaryExprAST* binary = static_cast<BinaryExprAST*>(expr);
+        const Token_e op = binary->op();
+
+        // Sema doesn't let a const fn dereference anything, so this is a variable
+        if (op == TOK_ASSIGN) {
+            if (state == 0)
+                return push(binary->rhs());
+            ConstValue* var = find_local(llvm::cast<VariableExprAST>(binary->lhs())->name());
+            if (!var)
+                return error_at(binary->lhs(), "a variable is assigned to before it was made");
+            *var = pop();
+            return done(*var);
+        }
+
+        if (state == 0)
+            return push(binary->lhs());
+        if (op == TOK_AS) {
+            if (expr->ptr_layers())
+                return error_at(expr, "a number is converted to a pointer");
+            Result<ConstValue> res = pop().convert(expr->type());
+            if (!res)
+                return error_at(expr, res.unwrap_err());
+            return done(res.unwrap());
+        }
+        if (state == 1)
+            return push(binary->rhs());
+
+        const ConstValue rhs = pop();
+        const ConstValue lhs = pop();
+        Result<ConstValue> res = lhs.apply(op, rhs, expr->type());
+        if (!res)
+            return error_at(expr, res.unwrap_err());
+        return done(res.unwrap());
+    }
+
+    // Only the arm that is taken gets evaluated, like at runtime
+    case ExprKind::If: {
+        IfExprAST* if_expr = static_cast<IfExprAST*>(expr);
+        if (state == 0)
+            return push(if_expr->condition());
+        if (state == 1)
+            return push(pop().is_true() ? if_expr->true_expr() : if_expr->false_expr());
+        work_.pop_back();
+        return Result_e::OK;
+    }
+
+    case ExprKind::Call:
+        return step_call(static_cast<CallExprAST*>(expr), state);
+
+    case ExprKind::NewVariable: {
+        NewVariableAST* new_var = static_cast<NewVariableAST*>(expr);
+        if (state == 0)
+            return push(new_var->value());
+        locals_.emplace_back(new_var->var()->name(), pop());
+        return done(ConstValue());
+    }
+
+    // Sema only lets these be statements, so all of the frame is done with
+    case ExprKind::Return: {
+        if (state == 0)
+            return push(static_cast<ReturnAST*>(expr)->return_val);
+
+        const ConstValue val = pop();
+        locals_.resize(frame.locals_base);
+        values_.resize(frame.values_base);
+        work_.resize(frame.work_base);
+        frames_.pop_back();
+        values_.push_back(val);
+        return Result_e::OK;
+    }
+
+    default:
+        return error_at(expr, "this can't be evaluated while compiling");
+    }
+}
+
+Result<ConstValue> ConstEvaluator::call(FunctionAST* fn, const std::vector<ConstValue>& args) {
+    work_.clear();
+    values_.clear();
+    frames_.clear();
+    locals_.clear();
+    steps_ = 0;
+
+    values_.insert(values_.end(), args.begin(), args.end());
+    push_frame(fn, args.size());
+
+    // At what we were about to do when we ran out, or at the function that was about to start a statement
+    auto limit_error = [this](const char* message) {
+        if (work_.size() > frames_.back().work_base)
+            return error_at(work_.back().expr, message, ErrorCode::LIMIT);
+        DeclarationAST* decl = frames_.back().fn->decl();
+        return Error(message, ErrorCode::LIMIT, decl->line(), decl->col());
+    };
+
+    while (!frames_.empty()) {
+        if (++steps_ > limits_.steps)
+            return limit_error("more steps than --const-eval-steps allows");
+        if (memory_used() > limits_.memory)
+            return limit_error("more memory than --const-eval-memory allows");
+
+        if (Result<void> res = step(); !res)
+            return res.unwrap_err();
+    }
+
+    return ConstValue(values_.back());
+}
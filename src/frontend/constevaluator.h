@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ast.h"
+#include "constvalue.h"
+#include <unordered_map>
+#include <vector>
+
+// How much a single call to a const fn may do before we give up on it. The defaults are about what
+// clang allows a constexpr evaluation, change them with --const-eval-steps and --const-eval-memory
+struct ConstEvalLimits {
+    uint64_t steps = 1 << 20;           // nodes evaluated
+    uint64_t memory = 16 << 20;         // bytes on the evaluator's stacks, so also how deep it can recurse
+};
+
+// Runs calls to const fns on a checked AST while compiling, for the ConstantFolder.
+// It keeps its own stacks instead of recursing, so a const fn that recurses forever runs into the limits
+// instead of overflowing the compiler's stack.
+//
+// A call either gives a value, or an Error saying why it can't be done while compiling. Those with
+// ErrorCode::LIMIT ran out of steps or memory, anything else (dividing by zero, reading a variable that
+// was never made) would have to happen at runtime. Errors have the location of the node they happened at.
+class ConstEvaluator {
+private:
+    // An expression being evaluated, and how far along it is (how many children are done)
+    struct Work {
+        Expression expr;
+        uint32_t state;
+    };
+
+    // A const fn being run: its locals are locals_[locals_base...], and everything on work_ and
+    // values_ above the bases is for the statement it's running now
+    struct Frame {
+        FunctionAST* fn;
+        size_t locals_base;
+        size_t work_base;
+        size_t values_base;
+        uint32_t next_statement;
+    };
+
+    const std::unordered_map<Symbol, FunctionAST*>& const_fns_;
+    ConstEvalLimits limits_;
+
+    std::vector<Work> work_;
+    std::vector<ConstValue> values_;
+    std::vector<Frame> frames_;
+    std::vector<std::pair<Symbol, ConstValue>> locals_;
+    uint64_t steps_ = 0;
+
+    size_t memory_used() const;
+    void push_frame(FunctionAST* fn, size_t arg_count);
+
+    // Does the next bit of the work on top of work_, which belongs to the frame on top of frames_
+    salt::Result<void> step();
+    salt::Result<void> step_call(CallExprAST* call, uint32_t state);
+    ConstValue* find_local(Symbol name);
+
+public:
+    // const_fns has every const fn there is a body for, by name
+    ConstEvaluator(const std::unordered_map<Symbol, FunctionAST*>& const_fns, ConstEvalLimits limits) :
+        const_fns_(const_fns), limits_(limits) {}
+
+    // fn called with args, which already have the types of its parameters
+    salt::Result<ConstValue> call(FunctionAST* fn, const std::vector<ConstValue>& args);
+
+    // How many steps the last call() took
+    uint64_t steps() const { return steps_; }
+};
@@ -0,0 +1,169 @@
+#include "constvalue.h"
+#include <cmath>
+
+using namespace salt;
+
+// Width of an integer type in bits (bool is 1)
+static unsigned bits_of(const salt::Type* type) {
+    return type->get()->getIntegerBitWidth();
+}
+
+// val cut down to the width of type, then extended back to 64 bits by its signedness
+static int64_t normalize(uint64_t val, const salt::Type* type) {
+    const unsigned bits = bits_of(type);
+    if (bits >= 64)
+        return int64_t(val);
+
+    val &= (uint64_t(1) << bits) - 1;
+    if (type->is_signed && (val >> (bits - 1)) & 1)
+        val |= ~uint64_t(0) << bits;
+    return int64_t(val);
+}
+
+ConstValue ConstValue::of_int(uint64_t val, const salt::Type* type) {
+    ConstValue res;
+    res.type = type;
+    res.i64 = normalize(val, type);
+    return res;
+}
+
+ConstValue ConstValue::of_float(double val, const salt::Type* type) {
+    ConstValue res;
+    res.type = type;
+    res.f64 = type->get()->isFloatTy() ? double(float(val)) : val;
+    return res;
+}
+
+Result<ConstValue> ConstValue::convert(const salt::Type* to) const {
+    const llvm::Type* from_type = type->get();
+    const llvm::Type* to_type = to->get();
+    if (!(to_type->isIntegerTy() || to_type->isFloatingPointTy()))
+        return Error("can't convert a number to that type while compiling");
+
+    const bool from_float = from_type->isFloatingPointTy();
+    const double d = f64;
+    const int64_t i = i64;
+
+    // same llvm type, like int and uint: the bits stay, only how we read them changes
+    if (from_type == to_type)
+        return from_float ? of_float(d, to) : of_int(i, to);
+
+    // compared with 0, where NaN isn't anything
+    if (to == SALT_TYPE_BOOL)
+        return of_int(from_float ? (d < 0.0 || d > 0.0) : i != 0, to);
+
+    if (!from_float) {
+        if (to_type->isIntegerTy())
+            return of_int(i, to);       // i is already extended by the signedness of its type
+
+        if (type->is_signed)
+            return of_float(to_type->isFloatTy() ? double(float(i)) : double(i), to);
+        return of_float(to_type->isFloatTy() ? double(float(uint64_t(i))) : double(uint64_t(i)), to);
+    }
+
+    if (to_type->isFloatingPointTy())
+        return of_float(d, to);
+
+    // Out of range is poison, fptosi/fptoui truncate first so anything that truncates into the range is fine
+    const unsigned bits = bits_of(to);
+    if (to->is_signed) {
+        const double max = std::pow(2.0, bits - 1);
+        if (!(d > -max - 1.0 && d < max))
+            return Error("float doesn't fit the integer it's converted to");
+        return of_int(uint64_t(int64_t(d)), to);
+    }
+
+    const double max = std::pow(2.0, bits);
+    if (!(d > -1.0 && d < max))
+        return Error("float doesn't fit the integer it's converted to");
+    return of_int(uint64_t(std::trunc(d)), to);
+}
+
+Result<ConstValue> ConstValue::apply(Token_e op, const salt::Type* result_type) const {
+    const bool is_float = this->is_float();
+    const double d = f64;
+    const uint64_t u = i64;
+
+    switch (op) {
+    case TOK_SUB:
+        return is_float ? of_float(-d, result_type) : of_int(0 - u, result_type);
+    case TOK_TILDE:
+        return of_int(~u, result_type);
+    case TOK_EXCLAMATION:
+    case TOK_NOT:
+        return of_int(is_float ? d == 0.0 : u == 0, result_type);
+    default:
+        return Error("unsupported operator");
+    }
+}
+
+Result<ConstValue> ConstValue::apply(Token_e op, const ConstValue& rhs, const salt::Type* result_type) const {
+    if (is_float()) {
+        const double a = f64;
+        const double b = rhs.f64;
+
+        // floats go through double here, which rounds to the same float for all of these
+        switch (op) {
+        case TOK_ADD:               return of_float(a + b, result_type);
+        case TOK_SUB:               return of_float(a - b, result_type);
+        case TOK_MUL:               return of_float(a * b, result_type);
+        case TOK_DIV:               return of_float(a / b, result_type);
+        case TOK_MODULO:            return of_float(std::fmod(a, b), result_type);
+
+        // ordered like the IR, so only != is true for NaN
+        case TOK_LEFT_ANGLE:        return of_int(a < b, result_type);
+        case TOK_RIGHT_ANGLE:       return of_int(a > b, result_type);
+        case TOK_EQUALS_LARGER:     return of_int(a >= b, result_type);
+        case TOK_EQUALS_SMALLER:    return of_int(a <= b, result_type);
+        case TOK_EQUALS:            return of_int(a == b, result_type);
+        case TOK_NOT_EQUALS:        return of_int(a != b, result_type);
+        default:                    return Error("unsupported operator");
+        }
+    }
+
+    const unsigned bits = bits_of(type);
+    const bool is_signed = type->is_signed;
+    const int64_t sa = i64;
+    const int64_t sb = rhs.i64;
+    const uint64_t ua = sa;
+    const uint64_t ub = sb;
+
+    switch (op) {
+    case TOK_ADD:               return of_int(ua + ub, result_type);
+    case TOK_SUB:               return of_int(ua - ub, result_type);
+    case TOK_MUL:               return of_int(ua * ub, result_type);
+
+    // x / 0 and MIN / -1 are undefined
+    case TOK_DIV:
+    case TOK_MODULO:
+        if (ub == 0)
+            return Error("division by zero");
+        if (is_signed && sb == -1 && sa == normalize(uint64_t(1) << (bits - 1), type))
+            return Error("signed division overflows");
+        if (op == TOK_DIV)
+            return of_int(is_signed ? uint64_t(sa / sb) : ua / ub, result_type);
+        return of_int(is_signed ? uint64_t(sa % sb) : ua % ub, result_type);
+
+    // so is shifting by the width of the type or more
+    case TOK_LEFT_SHIFT:
+        if (ub >= bits)
+            return Error("shift amount is too large");
+        return of_int(ua << ub, result_type);
+    case TOK_RIGHT_SHIFT:
+        if (ub >= bits)
+            return Error("shift amount is too large");
+        return of_int(is_signed ? uint64_t(sa >> ub) : ua >> ub, result_type);
+
+    case TOK_LEFT_ANGLE:        return of_int(is_signed ? sa < sb : ua < ub, result_type);
+    case TOK_RIGHT_ANGLE:       return of_int(is_signed ? sa > sb : ua > ub, result_type);
+    case TOK_EQUALS_LARGER:     return of_int(is_signed ? sa >= sb : ua >= ub, result_type);
+    case TOK_EQUALS_SMALLER:    return of_int(is_signed ? sa <= sb : ua <= ub, result_type);
+    case TOK_EQUALS:            return of_int(ua == ub, result_type);
+    case TOK_NOT_EQUALS:        return of_int(ua != ub, result_type);
+
+    case TOK_CARAT:             return of_int(ua ^ ub, result_type);
+    case TOK_AMPERSAND:         return of_int(ua & ub, result_type);
+    case TOK_VERTICAL_BAR:      return of_int(ua | ub, result_type);
+    default:                    return Error("unsupported operator");
+    }
+}
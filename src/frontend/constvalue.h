@@ -0,0 +1,35 @@
+#pragma once
+
+#include "tokens.h"
+#include "types.h"
+#include "../common.h"
+
+// A number or a bool known while compiling, for the ConstantFolder and the ConstEvaluator.
+// They are computed like the IR that code_gen() would have made computes them: integers wrap, and are kept
+// truncated to the width of their type and extended back to 64 bits by its signedness, so int64_t and uint64_t
+// math on them does what the IR would. Floats are kept as a double, rounded to float if that's their type.
+//
+// Anything that would be poison or trap at runtime (dividing by 0, shifting by too much, a float that doesn't
+// fit an int) gives an Error instead of a value, so the caller can leave it for the runtime.
+struct ConstValue {
+    const salt::Type* type = nullptr;   // nullptr for the "value" of something void, like a new variable
+    union {
+        int64_t i64;
+        double f64;
+    };
+
+    ConstValue() : i64(0) {}
+
+    static ConstValue of_int(uint64_t val, const salt::Type* type);
+    static ConstValue of_float(double val, const salt::Type* type);
+
+    bool is_float() const { return type->get()->isFloatingPointTy(); }
+    bool is_true() const { return is_float() ? f64 != 0.0 : i64 != 0; }
+
+    // What convert_implicit() (or "as", which is the same for numbers) does to this
+    salt::Result<ConstValue> convert(const salt::Type* to) const;
+
+    // op applied to this, giving a result_type. Both operands of a binary op already have the same type (Sema made sure)
+    salt::Result<ConstValue> apply(Token_e op, const salt::Type* result_type) const;
+    salt::Result<ConstValue> apply(Token_e op, const ConstValue& rhs, const salt::Type* result_type) const;
+};
@@ -0,0 +1,39 @@
+#include "diagnostics.h"
+
+std::mutex PrintingDiagnosticSink::print_mutex_;
+
+void DiagnosticSink::error(const std::string& message) {
+    error_count_++;
+    emit(DiagnosticLevel::ERROR, message);
+}
+
+void DiagnosticSink::warning(const std::string& message, int min_warning_level) {
+    if (min_warning_level > salt::WARNING_LEVEL)
+        return;
+
+    warning_count_++;
+    emit(DiagnosticLevel::WARNING, message);
+}
+
+void PrintingDiagnosticSink::emit(DiagnosticLevel level, const std::string& message) {
+    std::lock_guard<std::mutex> lock(print_mutex_);
+    if (level == DiagnosticLevel::ERROR)
+        salt::print_error(message);
+    else
+        salt::print_warning(message);
+}
+
+void BufferedDiagnosticSink::emit(DiagnosticLevel level, const std::string& message) {
+    messages_.emplace_back(level, message);
+}
+
+// Warnings that are too quiet for WARNING_LEVEL never made it in here
+void BufferedDiagnosticSink::send_to(DiagnosticSink& sink) {
+    for (const auto& [level, message] : messages_) {
+        if (level == DiagnosticLevel::ERROR)
+            sink.error(message);
+        else
+            sink.warning(message);
+    }
+    messages_.clear();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../common.h"
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+enum class DiagnosticLevel {
+    WARNING,
+    ERROR,
+};
+
+// Where the Parser sends its errors and warnings, instead of printing them itself.
+// Messages arrive fully formatted, including the file name and location.
+class DiagnosticSink {
+private:
+    std::atomic<int> error_count_ = 0;
+    std::atomic<int> warning_count_ = 0;
+
+protected:
+    virtual void emit(DiagnosticLevel level, const std::string& message) = 0;
+
+public:
+    virtual ~DiagnosticSink() = default;
+
+    void error(const std::string& message);
+    void warning(const std::string& message, int min_warning_level = 0);
+
+    int error_count() const { return error_count_; }
+    int warning_count() const { return warning_count_; }
+    bool has_errors() const { return error_count_ > 0; }
+};
+
+// Prints everything right away, like the compiler always did.
+// One of these can be shared between parsers on different threads, every message comes out whole.
+class PrintingDiagnosticSink : public DiagnosticSink {
+private:
+    static std::mutex print_mutex_;
+
+protected:
+    void emit(DiagnosticLevel level, const std::string& message) override;
+};
+
+// Keeps everything, so it can be sent on to another sink later (or dropped, if it turned out not to matter)
+class BufferedDiagnosticSink : public DiagnosticSink {
+private:
+    std::vector<std::pair<DiagnosticLevel, std::string>> messages_;
+
+protected:
+    void emit(DiagnosticLevel level, const std::string& message) override;
+
+public:
+    void send_to(DiagnosticSink& sink);
+};
@@ -8,6 +8,8 @@ namespace Flags {
 		{"--dbo", Flags_e::DEBUG_OUTPUT},				// debug output
 		{"--dbv", Flags_e::DEBUG_OUTPUT_VERBOSE},		// debug output (verbose)
 		{"--nostd", Flags_e::NO_STD},					// doesn't link to any library like libc/kernel32.dll, only core + prelude
+		{"--tokvec", Flags_e::TOKEN_VECTOR},			// tokenize whole files before parsing instead of streaming tokens, for debugging
+		{"--fsyntax-only", Flags_e::SYNTAX_ONLY},		// only parse and check the files, don't generate any code or link
 	};
 }
 
@@ -9,6 +9,8 @@ enum class Flags_e : uint64_t {
     DEBUG_OUTPUT,
     DEBUG_OUTPUT_VERBOSE,
     NO_STD,
+    TOKEN_VECTOR,
+    SYNTAX_ONLY,
     TOTAL,
 };
 
@@ -0,0 +1,328 @@
+#include "functioncache.h"
+#include "irgenerator.h"
+#include "types.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
+#include <filesystem>
+#include <unordered_set>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    // Hashes everything code_gen() looks at when it generates a function. Symbols and types are
+    // hashed by their text, their ids and addresses are different every time the compiler runs
+    class StructuralHasher {
+    private:
+        uint64_t hash_;
+        std::vector<Expression> stack_;
+
+    public:
+        explicit StructuralHasher(uint64_t seed) : hash_(seed) {}
+
+        uint64_t hash() const { return hash_; }
+
+        void add_bytes(const void* data, size_t size) {
+            hash_ = salt::hash_bytes(data, size, hash_);
+        }
+
+        void add_int(uint64_t val) {
+            add_bytes(&val, sizeof(val));
+        }
+
+        // With its length first, so "ab" "c" and "a" "bc" don't hash the same
+        void add_text(std::string_view text) {
+            add_int(text.size());
+            add_bytes(text.data(), text.size());
+        }
+
+        void add_symbol(Symbol sym) {
+            add_text(sym ? sym.str() : std::string_view());
+        }
+
+        void add_type(const TypeInstance& ti) {
+            add_text(ti.type ? std::string_view(ti.type->name) : std::string_view());
+            add_text(ti.pointee ? std::string_view(ti.pointee->name) : std::string_view());
+            add_int(static_cast<uint64_t>(ti.ptr_layers));
+        }
+
+        // What a call to decl looks like in the IR
+        void add_signature(DeclarationAST* decl) {
+            add_symbol(decl->name());
+            add_type(decl->type_instance());
+            add_int(decl->args().size());
+            for (VariableExprAST* arg : decl->args())
+                add_type(arg->type_instance());
+        }
+
+        // Every node of root in pre-order, each with how many children it has, so two different trees
+        // never give the same sequence. Doesn't recurse, expressions can be nested very deeply
+        void add_tree(Expression root, const std::unordered_map<Symbol, DeclarationAST*>& signatures) {
+            stack_.clear();
+            stack_.push_back(root);
+            while (!stack_.empty()) {
+                Expression expr = stack_.back();
+                stack_.pop_back();
+                if (!expr) {
+                    add_int(~uint64_t(0));
+                    continue;
+                }
+
+                add_int(static_cast<uint64_t>(expr->kind()));
+                add_type(expr->type_instance());
+                switch (expr->kind()) {
+                case ExprKind::Val: {
+                    const ValExprAST* val = static_cast<const ValExprAST*>(expr);
+                    add_int(static_cast<uint64_t>(val->to_int()));     // the bits of a double too
+                    add_symbol(val->str());
+                    break;
+                }
+                case ExprKind::Variable:
+                    add_symbol(static_cast<const VariableExprAST*>(expr)->name());
+                    break;
+                case ExprKind::Binary:
+                    add_int(static_cast<const BinaryExprAST*>(expr)->op());
+                    break;
+                case ExprKind::Unary:
+                    add_int(static_cast<const UnaryExprAST*>(expr)->op());
+                    break;
+                case ExprKind::Call: {
+                    // The callee's signature is part of the call, its body isn't
+                    const Symbol callee = static_cast<const CallExprAST*>(expr)->callee();
+                    auto it = signatures.find(callee);
+                    if (it != signatures.end())
+                        add_signature(it->second);
+                    else
+                        add_symbol(callee);
+                    break;
+                }
+                case ExprKind::Return:
+                    add_type(static_cast<const ReturnAST*>(expr)->expected_return_type);
+                    break;
+                default:
+                    break;
+                }
+
+                const size_t first_child = stack_.size();
+                expr->children(stack_);
+                add_int(stack_.size() - first_child);
+                std::reverse(stack_.begin() + first_child, stack_.end());
+            }
+        }
+    };
+
+    // The functions fn calls and the global variables (like string literals) it uses, also through constant expressions
+    void collect_globals(llvm::Function* fn, std::vector<llvm::GlobalValue*>& out) {
+        std::unordered_set<llvm::Value*> seen;
+        std::vector<llvm::Value*> stack;
+        for (llvm::BasicBlock& bb : *fn)
+            for (llvm::Instruction& inst : bb)
+                for (llvm::Value* operand : inst.operands())
+                    stack.push_back(operand);
+
+        while (!stack.empty()) {
+            llvm::Value* val = stack.back();
+            stack.pop_back();
+            if (!seen.insert(val).second)
+                continue;
+            if (llvm::GlobalValue* global = llvm::dyn_cast<llvm::GlobalValue>(val))
+                out.push_back(global);
+            else if (llvm::ConstantExpr* expr = llvm::dyn_cast<llvm::ConstantExpr>(val))
+                for (llvm::Value* operand : expr->operands())
+                    stack.push_back(operand);
+        }
+    }
+
+    // False if mod has something under the name of a function from calls that isn't that function, or from
+    // uses a global variable that we can't give it. into (in mod) is what from becomes
+    bool can_move(const std::vector<llvm::GlobalValue*>& globals, const llvm::Function* from,
+        const llvm::Function* into, const llvm::Module& mod) {
+        for (llvm::GlobalValue* global : globals) {
+            if (const llvm::Function* callee = llvm::dyn_cast<llvm::Function>(global)) {
+                const llvm::Function* target = global == from ? into : mod.getFunction(callee->getName());
+                if (target && target->getFunctionType() != callee->getFunctionType())
+                    return false;
+            }
+            else if (const llvm::GlobalVariable* var = llvm::dyn_cast<llvm::GlobalVariable>(global)) {
+                // string literals are private, so a name that is taken already just gets a number
+                if (!var->hasLocalLinkage() || !var->hasInitializer())
+                    return false;
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The function called name in mod, declared like callee if it isn't there
+    llvm::Function* function_in(llvm::Module& mod, const llvm::Function* callee) {
+        llvm::Function* target = mod.getFunction(callee->getName());
+        if (!target)
+            target = llvm::Function::Create(callee->getFunctionType(), llvm::Function::ExternalLinkage, callee->getName(), mod);
+        return target;
+    }
+
+    // Copies the body of from into into, which is in mod and has the same type. What from calls is
+    // looked up in mod by name (and declared if it isn't there), the global variables it uses are copied.
+    // False (with into left alone) if that can't be done.
+    // Only touches what from uses, so it costs the same in a module with one function or with thousands
+    bool clone_into(llvm::Function* from, llvm::Function* into, llvm::Module& mod) {
+        std::vector<llvm::GlobalValue*> globals;
+        collect_globals(from, globals);
+        if (!can_move(globals, from, into, mod))
+            return false;
+
+        llvm::ValueToValueMapTy value_map;
+        for (llvm::GlobalValue* global : globals) {
+            if (global == from) {
+                value_map[global] = into;
+            }
+            else if (const llvm::Function* callee = llvm::dyn_cast<llvm::Function>(global)) {
+                value_map[global] = function_in(mod, callee);
+            }
+            else {
+                llvm::GlobalVariable* var = llvm::cast<llvm::GlobalVariable>(global);
+                llvm::GlobalVariable* copy = new llvm::GlobalVariable(mod, var->getValueType(), var->isConstant(),
+                    var->getLinkage(), var->getInitializer(), var->getName());
+                copy->copyAttributesFrom(var);
+                value_map[global] = copy;
+            }
+        }
+
+        auto into_arg = into->arg_begin();
+        for (const llvm::Argument& arg : from->args())
+            value_map[&arg] = &*into_arg++;
+
+        llvm::SmallVector<llvm::ReturnInst*, 4> returns;
+        llvm::CloneFunctionInto(into, from, value_map, llvm::CloneFunctionChangeType::DifferentModule, returns);
+        return true;
+    }
+
+    // Like clone_into, but takes the body (and the global variables) away from from instead of copying them.
+    // For a function that was just read from the cache, which is thrown away after this anyway
+    bool move_into(llvm::Function* from, llvm::Function* into, llvm::Module& mod) {
+        std::vector<llvm::GlobalValue*> globals;
+        collect_globals(from, globals);
+        if (!can_move(globals, from, into, mod))
+            return false;
+
+        for (llvm::GlobalValue* global : globals) {
+            if (global == from) {
+                global->replaceAllUsesWith(into);
+            }
+            else if (const llvm::Function* callee = llvm::dyn_cast<llvm::Function>(global)) {
+                global->replaceAllUsesWith(function_in(mod, callee));
+            }
+            else {
+                llvm::GlobalVariable* var = llvm::cast<llvm::GlobalVariable>(global);
+                var->removeFromParent();
+                mod.insertGlobalVariable(var);
+            }
+        }
+
+        auto into_arg = into->arg_begin();
+        for (llvm::Argument& arg : from->args())
+            arg.replaceAllUsesWith(&*into_arg++);
+
+        into->copyAttributesFrom(from);
+        into->splice(into->end(), from);
+        return true;
+    }
+}
+
+
+FunctionCache::FunctionCache(const std::string& dir, uint64_t seed) {
+    this->dir_ = dir;
+    // Bitcode written by another LLVM, or by another build of the compiler, is never used
+    this->seed_ = salt::hash_bytes(LLVM_VERSION_STRING, std::strlen(LLVM_VERSION_STRING), seed ^ VERSION);
+    this->seed_ = salt::hash_bytes(salt::BUILD_ID, std::strlen(salt::BUILD_ID), seed_);
+    this->hits_ = 0;
+    this->misses_ = 0;
+}
+
+std::string FunctionCache::path_of(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bc", (unsigned long long) key);
+    return (std::filesystem::path(dir_) / name).string();
+}
+
+uint64_t FunctionCache::key_of(FunctionAST* fn, const std::unordered_map<Symbol, DeclarationAST*>& signatures) const {
+    StructuralHasher hasher = StructuralHasher(seed_);
+
+    // The names of the arguments end up in the IR too
+    DeclarationAST* decl = fn->decl();
+    hasher.add_signature(decl);
+    for (VariableExprAST* arg : decl->args())
+        hasher.add_symbol(arg->name());
+
+    hasher.add_int(fn->body().size());
+    for (Expression statement : fn->body())
+        hasher.add_tree(statement, signatures);
+    return hasher.hash();
+}
+
+bool FunctionCache::load(uint64_t key, FunctionAST* fn) {
+    IRGenerator* gen = IRGenerator::get();
+    const char* name = fn->decl()->name().c_str();
+    llvm::Function* declared = gen->mod->getFunction(name);
+
+    std::string data;
+    if (!salt::read_file(path_of(key), data))
+        data.clear();
+
+    // Only splice in what is certainly this function. The module is read lazily and only fn is
+    // materialized, reading all of it would run the verifier on it again
+    std::unique_ptr<llvm::Module> cached;
+    llvm::Function* cached_fn = nullptr;
+    if (!data.empty() && declared && declared->isDeclaration()) {
+        llvm::Expected<std::unique_ptr<llvm::Module>> res = llvm::getLazyBitcodeModule(llvm::MemoryBufferRef(data, name), *gen->context);
+        if (res)
+            cached = std::move(*res);
+        else
+            llvm::consumeError(res.takeError());
+    }
+    if (cached)
+        cached_fn = cached->getFunction(name);
+    if (cached_fn && cached_fn->getFunctionType() != declared->getFunctionType())
+        cached_fn = nullptr;
+    if (cached_fn) {
+        if (llvm::Error err = cached_fn->materialize()) {
+            llvm::consumeError(std::move(err));
+            cached_fn = nullptr;
+        }
+    }
+
+    if (!cached_fn || cached_fn->isDeclaration() || !move_into(cached_fn, declared, *gen->mod)) {
+        salt::dboutv << "Function cache miss: " << name << '\n';
+        misses_++;
+        return false;
+    }
+
+    salt::dboutv << "Function cache hit: " << name << " (" << data.size() << " bytes)\n";
+    hits_++;
+    return true;
+}
+
+void FunctionCache::store(uint64_t key, llvm::Function* fn) {
+    // A module with only fn and the globals it uses defined, and whatever it calls declared
+    llvm::Module mod = llvm::Module(fn->getName(), fn->getContext());
+    llvm::Function* copy = llvm::Function::Create(fn->getFunctionType(), fn->getLinkage(), fn->getName(), mod);
+    auto copy_arg = copy->arg_begin();
+    for (const llvm::Argument& arg : fn->args())
+        (copy_arg++)->setName(arg.getName());
+    if (!clone_into(fn, copy, mod))
+        return;
+
+    std::string data;
+    llvm::raw_string_ostream stream = llvm::raw_string_ostream(data);
+    llvm::WriteBitcodeToFile(mod, stream);
+    stream.flush();
+
+    const std::string path = path_of(key);
+    if (!salt::write_file_atomic(path, data))
+        salt::dbout << "Function cache: could not write " << path << '\n';
+}
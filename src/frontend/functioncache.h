@@ -0,0 +1,43 @@
+#pragma once
+
+#include "ast.h"
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+
+// Keeps the IR of functions that were compiled before in a directory, as one bitcode file per function,
+// so a function that didn't change doesn't go through code_gen() and verifyFunction() again: its
+// bitcode is read and its body is moved into the IRGenerator's module instead.
+// Files are named after a structural hash of the checked (and folded) FunctionAST, the signatures of
+// every function it calls and the seed (the flags that change the code, VERSION, the version of LLVM
+// and salt::BUILD_ID).
+// Lines and columns aren't in it, so a function that only moved still hits.
+// Like the AstCache, anything wrong with a cache file is a miss, never an error.
+class FunctionCache {
+private:
+    std::string dir_;
+    uint64_t seed_;
+    size_t hits_;
+    size_t misses_;
+
+    std::string path_of(uint64_t key) const;
+
+public:
+    // Goes up whenever code_gen() makes other IR for the same AST, for builds without a BUILD_ID
+    static constexpr uint32_t VERSION = 1;
+
+    FunctionCache(const std::string& dir, uint64_t seed);
+
+    // The hash fn is cached under. signatures has every function fn could call, by name
+    uint64_t key_of(FunctionAST* fn, const std::unordered_map<Symbol, DeclarationAST*>& signatures) const;
+
+    // Puts the cached IR of fn into IRGenerator::get()->mod, where fn has to be declared already.
+    // False on a miss, in which case the module is left alone
+    bool load(uint64_t key, FunctionAST* fn);
+
+    // Writes the IR of fn (which code_gen() just made, and verified) to the cache
+    void store(uint64_t key, llvm::Function* fn);
+
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+};
@@ -0,0 +1,63 @@
+#include "incrementalparser.h"
+#include "sema.h"
+
+IncrementalParser::IncrementalParser(const std::string& file_name, const std::vector<DeclarationAST*>& prelude) {
+    this->file_name_ = file_name;
+    this->prelude_ = prelude;
+    this->arena_ = std::make_unique<AstArena>();
+    this->signatures_hash_ = 0;
+    this->reparsed_ = 0;
+    this->reused_ = 0;
+}
+
+void IncrementalParser::take(const Parser& parser) {
+    unit_ = parser.unit();
+    functions_ = parser.function_ranges();
+    signatures_hash_ = parser.signatures_hash();
+    reused_ = parser.reused_count();
+    reparsed_ = functions_.size() - reused_;
+}
+
+void IncrementalParser::update(std::string text, DiagnosticSink& diagnostics) {
+    const int errors_before = diagnostics.error_count();
+    size_t live_bytes = 0;
+    for (const FunctionRange& range : functions_)
+        if (range.fn)
+            live_bytes += range.ast_bytes;
+
+    // Too much garbage, so parse everything into a new arena
+    if (arena_->bytes_allocated() > 2 * live_bytes + MIN_GARBAGE_BYTES) {
+        salt::dbout << "IncrementalParser: " << arena_->bytes_allocated() << " bytes in the arena, but only "
+            << live_bytes << " in use, starting over" << std::endl;
+        unit_ = TranslationUnitAST();
+        functions_.clear();
+        arena_ = std::make_unique<AstArena>();
+    }
+
+    // Signatures are only known at the end, and if one changed, the functions we reused might call it with
+    // the wrong types. Then it's parsed again without reusing anything, and the first try never said anything
+    BufferedDiagnosticSink first_try;
+    Parser parser = Parser(file_name_, text, first_try, *arena_);
+    parser.declare(prelude_);
+    parser.reuse(functions_);
+    parser.parse();
+
+    if (parser.reused_count() > 0 && parser.signatures_hash() != signatures_hash_) {
+        salt::dbout << "IncrementalParser: " << file_name_ << ": a signature changed, parsing all of it" << std::endl;
+        Parser again = Parser(file_name_, std::move(text), diagnostics, *arena_);
+        again.declare(prelude_);
+        again.track_functions();
+        again.parse();
+        take(again);
+    }
+    else {
+        first_try.send_to(diagnostics);
+        take(parser);
+    }
+
+    // Sema only fills in types and adds implicit casts, so a function it has already checked comes out the same
+    if (diagnostics.error_count() == errors_before)
+        Sema(file_name_, diagnostics, *arena_).check(unit_, prelude_);
+
+    salt::dbout << "IncrementalParser: " << file_name_ << ": parsed " << reparsed_ << " functions, reused " << reused_ << std::endl;
+}
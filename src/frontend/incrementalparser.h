@@ -0,0 +1,48 @@
+#pragma once
+
+#include "parser.h"
+#include "astarena.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Keeps the AST of one file up to date while it is being edited (for an editor or language server).
+// Every update() gets the whole new text, but only the functions whose text changed since the last
+// update() are parsed again, the rest keep their AST from last time. Then Sema checks all of them,
+// which is fine to do again on the ones it has already checked.
+//
+// Replaced functions stay in the arena until the dead ones take up more room than the live ones, then the
+// next update() starts over in a new arena. The text of every version stays in the SourceManager, so
+// destroy that every now and then if nothing else is using it.
+class IncrementalParser {
+private:
+    static constexpr size_t MIN_GARBAGE_BYTES = 1 << 20;
+
+    std::string file_name_;
+    std::vector<DeclarationAST*> prelude_;
+    std::unique_ptr<AstArena> arena_;
+    TranslationUnitAST unit_;
+    std::vector<FunctionRange> functions_;
+    uint64_t signatures_hash_;
+    size_t reparsed_;
+    size_t reused_;
+
+    // Keeps what parser made
+    void take(const Parser& parser);
+
+public:
+    // prelude has to outlive this
+    IncrementalParser(const std::string& file_name, const std::vector<DeclarationAST*>& prelude = {});
+
+    // text is the whole file as it is now. Syntax errors and warnings go to diagnostics, but only for the
+    // functions that were parsed again: the ones that came with any aren't reused. Type errors are for
+    // every function, and only if there were no syntax errors (like salt itself does)
+    void update(std::string text, DiagnosticSink& diagnostics);
+
+    // Checked by Sema unless there were syntax errors, valid until the next update()
+    const TranslationUnitAST& unit() const { return unit_; }
+
+    // What the last update() did
+    size_t reparsed() const { return reparsed_; }
+    size_t reused() const { return reused_; }
+};
@@ -0,0 +1,87 @@
+#include "interner.h"
+#include <cstring>
+#include <utility>
+
+Interner::Interner() {
+    this->block_used_ = BLOCK_SIZE; // so the first store() allocates a block
+    this->strings_ = { std::string_view("") }; // id 0 is the empty symbol
+    this->ids_ = {};
+}
+
+// Never destroyed, symbols are meant to live as long as the compiler does
+Interner* Interner::get() {
+    static Interner* instance = new Interner();
+    return instance;
+}
+
+// Copies str (plus a null byte) into the arena and returns where it ended up.
+const char* Interner::store(std::string_view str) {
+    const size_t needed = str.size() + 1;
+    char* dest = nullptr;
+
+    // Strings that don't fit in a block get their own, without wasting the current one
+    if (needed > BLOCK_SIZE) {
+        blocks_.push_back(std::make_unique<char[]>(needed));
+        dest = blocks_.back().get();
+        if (blocks_.size() > 1)
+            std::swap(blocks_.back(), blocks_[blocks_.size() - 2]);
+    } else {
+        if (block_used_ + needed > BLOCK_SIZE) {
+            blocks_.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+            block_used_ = 0;
+        }
+        dest = blocks_.back().get() + block_used_;
+        block_used_ += needed;
+    }
+
+    std::memcpy(dest, str.data(), str.size());
+    dest[str.size()] = '\0';
+    return dest;
+}
+
+Symbol Interner::intern(std::string_view str) {
+    if (str.empty())
+        return Symbol();
+
+    // Most strings are already in the table, so try that first without blocking anyone
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = ids_.find(str);
+        if (it != ids_.end())
+            return Symbol(it->second);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = ids_.find(str);
+    if (it != ids_.end())
+        return Symbol(it->second);
+
+    const std::string_view stored = std::string_view(store(str), str.size());
+    const uint32_t id = static_cast<uint32_t>(strings_.size());
+    strings_.push_back(stored);
+    ids_.emplace(stored, id);
+    return Symbol(id);
+}
+
+std::string_view Interner::str(Symbol sym) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return sym.id() < strings_.size() ? strings_[sym.id()] : std::string_view();
+}
+
+size_t Interner::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return strings_.size() - 1;
+}
+
+std::string_view Symbol::str() const {
+    return Interner::get()->str(*this);
+}
+
+const char* Symbol::c_str() const {
+    // Every stored string is null terminated, including the empty one
+    return Interner::get()->str(*this).data();
+}
+
+std::ostream& operator<<(std::ostream& os, Symbol sym) {
+    return os << sym.str();
+}
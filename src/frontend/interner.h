@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../common.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+
+// An interned string. Equal strings always get the same Symbol,
+// so comparing or hashing two symbols is just comparing their ids.
+class Symbol {
+private:
+    uint32_t id_;
+
+public:
+    constexpr Symbol() : id_(0) {}
+    constexpr explicit Symbol(uint32_t id) : id_(id) {}
+
+    uint32_t id() const                         { return id_; }
+    explicit operator bool() const              { return id_ != 0; }
+    bool operator==(Symbol other) const         { return id_ == other.id_; }
+    bool operator!=(Symbol other) const         { return id_ != other.id_; }
+    bool operator<(Symbol other) const          { return id_ < other.id_; }
+
+    // The string this symbol stands for, stays valid until the program exits
+    std::string_view str() const;
+    const char* c_str() const;
+
+    friend std::ostream& operator<<(std::ostream& os, Symbol sym);
+};
+
+namespace std {
+    template <>
+    struct hash<Symbol> {
+        size_t operator()(Symbol sym) const noexcept { return sym.id(); }
+    };
+}
+
+// Process-wide string table. Strings are copied into big arena blocks, never
+// moved or freed, and are null terminated so they can be handed to C APIs.
+// Safe to use from several lexers at once.
+class Interner {
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    size_t block_used_;
+    std::vector<std::string_view> strings_; // strings_[id]
+    std::unordered_map<std::string_view, uint32_t> ids_;
+    mutable std::shared_mutex mutex_;
+
+    Interner();
+    const char* store(std::string_view str);
+
+public:
+    static Interner* get();
+
+    Symbol intern(std::string_view str);
+    std::string_view str(Symbol sym) const;
+    size_t size() const;
+};
@@ -134,7 +134,7 @@ void IRGenerator::add_prelude() {
 		add_std_prelude();
 }
 
-llvm::AllocaInst*& IRGenerator::find_in_named_values(const std::string& variable_name) {
+llvm::AllocaInst*& IRGenerator::find_in_named_values(Symbol variable_name) {
 	salt::dboutv << "Finding " << variable_name << " in named values\n";
 
 	int current_scope = this->named_values.size() - 1;
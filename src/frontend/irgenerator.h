@@ -3,6 +3,7 @@
 #include "frontendllvm.h"
 #include "tokens.h"
 #include <map>
+#include <unordered_map>
 
 /*
 * Defines the IRGenerator class, which generates and optimizes LLVM IR.
@@ -34,16 +35,16 @@ public:
 
 	// Keeps track of all named values
 	// when referencing a variable, we will check the innermost scope (named_values.back()) first, then the one before that etc.
-	std::vector<std::map<std::string, llvm::AllocaInst*>> named_values;
+	std::vector<std::unordered_map<Symbol, llvm::AllocaInst*>> named_values;
 
 	// warning: reference has a very short lifetime!
 	// be careful to not let that value go out of scope when using this function
-	llvm::AllocaInst*& find_in_named_values(const std::string& variable_name);
+	llvm::AllocaInst*& find_in_named_values(Symbol variable_name);
 
 
-	std::map<std::string, llvm::Constant*> named_strings;
+	std::unordered_map<Symbol, llvm::Constant*> named_strings;
 
-	std::map<std::string, llvm::Function*> named_functions;
+	std::unordered_map<Symbol, llvm::Function*> named_functions;
 
 
 	// For optimization purposes
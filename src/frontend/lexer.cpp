@@ -1,18 +1,69 @@
 #include "lexer.h"
+#include "sourcemanager.h"
+#include "runscan.h"
 #include "../common.h"
 #include <iostream>
 #include <vector>
+#include <cstring>
 
 using salt::Result, salt::Result_e;
 
-Lexer* Lexer::instance_ = nullptr;
-int lexer_col = 1;
-int lexer_line = 1;
-/* private: */
 
-// Constructs a new Lexer.
-// This is done in Lexer::tokenize().
+struct Keyword {
+    const char* name;
+    Token_e token;
+};
+
+// Keywords and builtin type names, bucketed by length.
+// Types that don't have their own token (like uint) map to TOK_TYPE.
+static constexpr Keyword KEYWORDS_2[] = {
+    {"fn", TOK_FN}, {"if", TOK_IF}, {"or", TOK_OR}, {"as", TOK_AS},
+};
+static constexpr Keyword KEYWORDS_3[] = {
+    {"mut", TOK_MUT}, {"let", TOK_LET}, {"and", TOK_AND}, {"not", TOK_NOT},
+    {"int", TOK_INT}, {"inf", TOK_INF}, {"nan", TOK_NAN},
+};
+static constexpr Keyword KEYWORDS_4[] = {
+    {"else", TOK_ELSE}, {"then", TOK_THEN}, {"void", TOK_VOID}, {"bool", TOK_BOOL},
+    {"char", TOK_CHAR_TYPE}, {"long", TOK_LONG}, {"null", TOK_NULL}, {"true", TOK_TRUE},
+    {"uint", TOK_TYPE},
+};
+static constexpr Keyword KEYWORDS_5[] = {
+    {"const", TOK_CONST}, {"while", TOK_WHILE}, {"short", TOK_SHORT}, {"float", TOK_FLOAT},
+    {"ssize", TOK_SSIZE}, {"false", TOK_FALSE}, {"uchar", TOK_TYPE}, {"ulong", TOK_TYPE},
+    {"usize", TOK_TYPE},
+};
+static constexpr Keyword KEYWORDS_6[] = {
+    {"extern", TOK_EXTERN}, {"struct", TOK_STRUCT}, {"return", TOK_RETURN}, {"double", TOK_DOUBLE},
+    {"ushort", TOK_TYPE},
+};
+static constexpr Keyword KEYWORDS_8[] = {
+    {"unsigned", TOK_UNSIGNED},
+};
+
+template <size_t N>
+static inline Token_e find_keyword(const Keyword (&bucket)[N], const char* str, size_t length) {
+    for (const Keyword& kw : bucket) {
+        // Check the first char before comparing the rest
+        if (kw.name[0] == str[0] && std::memcmp(kw.name + 1, str + 1, length - 1) == 0)
+            return kw.token;
+    }
+    return TOK_NONE;
+}
 
+// Returns the token of a keyword or builtin type, or TOK_NONE if str is neither.
+static Token_e keyword_token(const char* str, size_t length) {
+    switch (length) {
+    case 2: return find_keyword(KEYWORDS_2, str, length);
+    case 3: return find_keyword(KEYWORDS_3, str, length);
+    case 4: return find_keyword(KEYWORDS_4, str, length);
+    case 5: return find_keyword(KEYWORDS_5, str, length);
+    case 6: return find_keyword(KEYWORDS_6, str, length);
+    case 8: return find_keyword(KEYWORDS_8, str, length);
+    default: return TOK_NONE;
+    }
+}
+// Constructs a new Lexer, which doesn't read anything until open() or tokenize().
 Lexer::Lexer() {
     this->col_ = 1;
     this->line_ = 1;
@@ -20,11 +71,12 @@ Lexer::Lexer() {
     this->current_string = std::string();
     this->identifier_string = std::string();
     this->state_ = LexerState::LEXER_STATE_NORMAL;
-    this->errors_ = std::vector<salt::Exception>();
+    this->errors_ = std::vector<salt::Error>();
     this->stream_ = nullptr;
+    this->source_ = nullptr;
+    this->cursor_ = nullptr;
+    this->buffer_end_ = nullptr;
     this->input_mode_ = LexerInputMode::LEXER_INPUT_MODE_STDIN;
-    lexer_line = 1;
-    lexer_col = 1;
 }
 
 Lexer::~Lexer() {
@@ -37,19 +89,6 @@ Lexer::~Lexer() {
 
 /* public: */
 
-// Returns a pointer to the current Lexer instance.
-Lexer* Lexer::get() {
-    return instance_ ? instance_ : instance_ = new Lexer();
-}
-
-// Destroys the current lexer. 
-void Lexer::destroy() {
-    if (Lexer* lexer = Lexer::get()) {
-        delete lexer;
-        Lexer::instance_ = nullptr;
-    }
-}
-
 // Returns the current line of the lexer.
 inline int Lexer::line() const {
     return this->line_;
@@ -69,12 +108,7 @@ inline LexerState Lexer::state() const {
     return this->state_;
 }
 
-// only for use in testing, might be moved to testing/testing.h
-inline Lexer* Lexer::test_lexer() {
-    return new Lexer();
-}
-
-const std::vector<salt::Exception>& Lexer::errors() {
+const std::vector<salt::Error>& Lexer::errors() {
     return errors_;
 }
 
@@ -87,22 +121,68 @@ LexerInputMode Lexer::input_mode() const {
     return input_mode_;
 }
 
-Token& Lexer::last_non_whitespace() {
-    int current_pos = this->vec.size() - 1;
-    
-    for (int i = current_pos; i >= 0; i--) {
-        if (!(vec[i].is_whitespace())) {
-            return vec[i];
-        }
+
+
+// Reads the whole file into the current SourceFile in one go, so that next_char() only has to move a pointer.
+// The file is only handed to the SourceManager once its text is complete, so files being
+// loaded by other threads at the same time get offsets that don't overlap with this one.
+void Lexer::load_buffer(const char* file_name) {
+    std::ifstream file = std::ifstream(file_name, std::ios::binary);
+    if (!file.is_open())
+        salt::print_fatal(std::string(file_name) + ": could not open file");
+
+    file.seekg(0, std::ios::end);
+    std::streamoff file_size = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    std::string text;
+    text.resize(file_size > 0 ? static_cast<size_t>(file_size) : 0);
+    if (!text.empty() && !file.read(&text[0], text.size()))
+        salt::print_fatal(std::string(file_name) + ": could not read file");
+
+    use_buffer(file_name, std::move(text));
+}
+
+// Hands text to the SourceManager as the contents of file_name and starts reading it.
+// "\r\n" is squashed into "\n" here, since we don't get the help of a text mode stream.
+void Lexer::use_buffer(const std::string& file_name, std::string text) {
+    size_t write_idx = 0;
+    for (size_t read_idx = 0; read_idx < text.size(); read_idx++) {
+        if (text[read_idx] == '\r' && read_idx + 1 < text.size() && text[read_idx + 1] == '\n')
+            continue;
+        text[write_idx++] = text[read_idx];
     }
+    text.resize(write_idx);
 
-    /// @todo? fix memory leak
-    return *(new Token(TOK_NONE));
+    source_ = &SourceManager::get()->add_file(file_name, std::move(text));
+    cursor_ = source_->text.data();
+    buffer_end_ = source_->text.data() + source_->text.size();
 }
 
+// Returns the global offset of the next char to be read.
+uint32_t Lexer::offset() const {
+    if (input_mode_ == LexerInputMode::LEXER_INPUT_MODE_BUFFER)
+        return source_->base + static_cast<uint32_t>(cursor_ - source_->text.data());
+    return source_->base + static_cast<uint32_t>(source_->text.size());
+}
 
+// Makes a string or char literal token out of current_string, which ends right before end.
+Token Lexer::literal_token(Token_e token_val, uint32_t end) {
+    const uint32_t length = static_cast<uint32_t>(current_string.size());
+    Token tok = Token(token_val, end - length, length, Interner::get()->intern(current_string));
+    current_string.clear();
+    return tok;
+}
 
 int Lexer::next_char() {
+    // by far the most common case, so check it first
+    if (input_mode_ == LexerInputMode::LEXER_INPUT_MODE_BUFFER) {
+        if (cursor_ != buffer_end_)
+            return static_cast<unsigned char>(*cursor_++);
+        eof_reached = true;
+        return EOF;
+    }
+
     int res = 0;
     if (input_mode_ == LexerInputMode::LEXER_INPUT_MODE_STDIN)
         res = std::cin.get();
@@ -114,6 +194,8 @@ int Lexer::next_char() {
     }
     if (res == EOF)
         eof_reached = true;
+    else
+        source_->text += static_cast<char>(res); // keep the source around for the tokens
     
     return res;
 }
@@ -134,66 +216,75 @@ Token Lexer::end_token() {
             ;
         } else {
             this->current_string.clear();
+            const uint32_t symbol_offset = this->offset() - 1;
             switch (temp_ch) {
             case EOF:
                 // this only happens when compiling a file
                 // instead of writing it directly using this program
                 // we need to return NONE, since we are inserting an EOF into the vector ourselves at the end 
-                return Token(TOK_EOF);
+                return Token(TOK_EOF, this->offset(), 0);
             case '+':
-                return Token(TOK_ADD);
+                return Token(TOK_ADD, symbol_offset, 1);
             case '-':
-                return Token(TOK_SUB);
+                return Token(TOK_SUB, symbol_offset, 1);
             case '*':
-                return Token(TOK_MUL);
+                return Token(TOK_MUL, symbol_offset, 1);
             case '/':
-                return Token(TOK_DIV);
+                return Token(TOK_DIV, symbol_offset, 1);
             case '%':
-                return Token(TOK_MODULO);
+                return Token(TOK_MODULO, symbol_offset, 1);
             case ' ':
-                return Token(TOK_WHITESPACE);
+                // Take the whole run of spaces at once, tokenize() splits it up again
+                if (input_mode_ == LexerInputMode::LEXER_INPUT_MODE_BUFFER) {
+                    const char* run_end = scan_space_run(cursor_, buffer_end_);
+                    const int run_length = static_cast<int>(run_end - cursor_);
+                    cursor_ = run_end;
+                    this->pos_ += run_length;
+                    this->col_ += run_length;
+                    return Token(TOK_WHITESPACE, symbol_offset, run_length + 1);
+                }
+                return Token(TOK_WHITESPACE, symbol_offset, 1);
             case '\t':
-                return Token(TOK_TAB);
+                return Token(TOK_TAB, symbol_offset, 1);
             case '\n':
-                return Token(TOK_EOL);
+                return Token(TOK_EOL, symbol_offset, 1);
             case '!':
-                return Token(TOK_EXCLAMATION);
+                return Token(TOK_EXCLAMATION, symbol_offset, 1);
             case '&':
-                return Token(TOK_AMPERSAND);
+                return Token(TOK_AMPERSAND, symbol_offset, 1);
             case '|':
-                return Token(TOK_VERTICAL_BAR);
+                return Token(TOK_VERTICAL_BAR, symbol_offset, 1);
             case '~':
-                return Token(TOK_TILDE);
+                return Token(TOK_TILDE, symbol_offset, 1);
             case '<':
-                return Token(TOK_LEFT_ANGLE);
+                return Token(TOK_LEFT_ANGLE, symbol_offset, 1);
             case '>':
-                return Token(TOK_RIGHT_ANGLE);
+                return Token(TOK_RIGHT_ANGLE, symbol_offset, 1);
             case '=':
-                return Token(TOK_ASSIGN);
+                return Token(TOK_ASSIGN, symbol_offset, 1);
             case '(':
-                return Token(TOK_LEFT_BRACKET);
+                return Token(TOK_LEFT_BRACKET, symbol_offset, 1);
             case ')':
-                return Token(TOK_RIGHT_BRACKET);
+                return Token(TOK_RIGHT_BRACKET, symbol_offset, 1);
             case ':':
-                return Token(TOK_COLON);
+                return Token(TOK_COLON, symbol_offset, 1);
             case ',':
-                return Token(TOK_COMMA);
+                return Token(TOK_COMMA, symbol_offset, 1);
             case '.':
-                return Token(TOK_DOT);
+                return Token(TOK_DOT, symbol_offset, 1);
             case '^':
-                return Token(TOK_CARAT);
+                return Token(TOK_CARAT, symbol_offset, 1);
             case '#':
                 this->state_ = LEXER_STATE_LINE_COMMENT;
                 return TOK_NONE;
             case '[':
-                return Token(TOK_LEFT_SQUARE);
+                return Token(TOK_LEFT_SQUARE, symbol_offset, 1);
             case ']':
-                return Token(TOK_RIGHT_SQUARE);
+                return Token(TOK_RIGHT_SQUARE, symbol_offset, 1);
 
 
             default:
-                std::string str = std::string('\'' + std::to_string(temp_ch) + '\'');
-                return Token(TOK_ERROR, std::to_string(int(temp_ch)));
+                return Token(TOK_ERROR, symbol_offset, 1, Interner::get()->intern(std::to_string(int(temp_ch))));
             }
         }
     }
@@ -202,144 +293,31 @@ Token Lexer::end_token() {
     std::string string_res = trim_last(this->current_string);
     std::string& cur_str = this->current_string;
 
-    // Keywords
-
-    if (string_res == "fn") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_FN);
-
-    } else if (string_res == "extern") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_EXTERN);
-
-    } else if (string_res == "struct") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_STRUCT);
-
-    } else if (string_res == "mut") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_MUT);
+    // The separator at the end of cur_str was read from the source, unless it's the EOF
+    const uint32_t length = static_cast<uint32_t>(string_res.size());
+    const uint32_t start = this->offset() - (eof_reached ? 0 : 1) - length;
 
-    } else if (string_res == "const") {
+    // Keywords and builtin types
+    const Token_e keyword = keyword_token(string_res.c_str(), string_res.size());
+    if (keyword != TOK_NONE) {
         lexer->current_string = cur_str.back();
-        return Token(TOK_CONST);
-
-    } else if (string_res == "let") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_LET);
-
-    } else if (string_res == "if") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_IF);
-
-    } else if (string_res == "else") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_ELSE);
-    } else if (string_res == "and") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_AND);
-    } else if (string_res == "not") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_NOT);
-    } else if (string_res == "or") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_OR);
-
-    } else if (string_res == "then") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_THEN);
-    } else if (string_res == "while") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_WHILE);
-
-    } else if (string_res == "return") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_RETURN);
-
-    // Default types
-    } else if (string_res == "void") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_VOID);
-
-    } else if (string_res == "bool") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_BOOL);
-
-    } else if (string_res == "char") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_CHAR_TYPE);
-
-    } else if (string_res == "short") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_SHORT);
-
-    } else if (string_res == "int") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_INT);
-
-    } else if (string_res == "long") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_LONG);
-
-    } else if (string_res == "float") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_FLOAT);
-
-    } else if (string_res == "double") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_DOUBLE);
-
-    } else if (string_res == "ssize") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_SSIZE);
-
-    } else if (string_res == "unsigned") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_UNSIGNED);
-
-    } else if (string_res == "null") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_NULL);
-
-    } else if (string_res == "true") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_TRUE);
-
-    } else if (string_res == "false") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_FALSE);
-
-    } else if (string_res == "inf") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_INF);
-
-    } else if (string_res == "nan") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_NAN);
-
-    } else if (string_res == "as") {
-        lexer->current_string = cur_str.back();
-        return Token(TOK_AS);
-
-
-    // These tokens have data, so before clearing the string, 
-    // we need to copy that data
+        return keyword == TOK_TYPE
+            ? Token(TOK_TYPE, start, length, Interner::get()->intern(string_res))
+            : Token(keyword, start, length);
 
     } else if (is_integer(string_res.c_str())) {
-        std::string _data = string_res;
         lexer->current_string = cur_str.back();
-        return Token(TOK_NUMBER, _data);
+        return Token(TOK_NUMBER, start, length);
         
-    /// @todo: fix is_type so that you dont need to call pointers __SaltPtr
-    } else if (is_type(string_res)) {
-        std::string _data = string_res;
+    // Only the compiler's own types (like __Pointer) are left for the types map,
+    // so regular identifiers don't pay for a hash lookup
+    } else if (string_starts_with(string_res.c_str(), "__") && is_type(string_res)) {
         lexer->current_string = cur_str.back();
-        return Token(TOK_TYPE, _data); 
+        return Token(TOK_TYPE, start, length, Interner::get()->intern(string_res));
 
     } else if (!string_res.empty()){
-        std::string _data = string_res;
         lexer->current_string = cur_str.back();
-        return Token(TOK_IDENT, _data);
+        return Token(TOK_IDENT, start, length, Interner::get()->intern(string_res));
 
     } else {
         return Token(TOK_NONE);
@@ -358,17 +336,26 @@ Result<Token> Lexer::next_token() {
     switch (this->state()) {
     case LEXER_STATE_NORMAL:
         while (true) {
+            // Identifiers and numbers never end a token, so with the whole file in memory
+            // we can copy them over all at once instead of going through next_char().
+            if (input_mode_ == LexerInputMode::LEXER_INPUT_MODE_BUFFER) {
+                const char* run_end = scan_ident_run(cursor_, buffer_end_);
+
+                const int run_length = static_cast<int>(run_end - cursor_);
+                cur_str.append(cursor_, run_end);
+                cursor_ = run_end;
+                this->pos_ += run_length;
+                this->col_ += run_length;
+            }
+
             const char ch = next_char();
             // Move the lexer's position forward.
             this->pos_++;
             this->col_++;
-            lexer_col++;
 
             if (ch == '\n') {
                 this->col_ = 1;
-                lexer_col = 1;
                 this->line_++;
-                lexer_line++;
             }
 
             if (ch == '\'') {
@@ -402,7 +389,7 @@ Result<Token> Lexer::next_token() {
                 return this->end_token();
         }
 
-        return Token(TOK_ERROR, cur_str);
+        return Token(TOK_ERROR, this->offset(), 0, Interner::get()->intern(cur_str));
 
 
     // please only 2 cases in this bracket, otherwise everything breaks
@@ -410,6 +397,34 @@ Result<Token> Lexer::next_token() {
     case LEXER_STATE_STRING: {
         // Not handling escape characters for now
         int end_char = this->state() == LEXER_STATE_CHAR ? '\'' : '"';
+
+        // With the whole file in memory we can jump straight to the closing quote
+        if (input_mode_ == LexerInputMode::LEXER_INPUT_MODE_BUFFER) {
+            const char* closing = static_cast<const char*>(std::memchr(cursor_, end_char, buffer_end_ - cursor_));
+            if (!closing)
+                salt::print_fatal("string or char literal terminated with EOF");
+
+            for (const char* p = cursor_; p < closing; p++) {
+                if (*p == '\n') {
+                    this->col_ = 1;
+                    this->line_++;
+                } else {
+                    this->col_++;
+                }
+            }
+
+            // + 1 for the closing quote
+            this->col_++;
+            this->pos_ += static_cast<int>(closing - cursor_) + 1;
+
+            cur_str.append(cursor_, closing);
+            cursor_ = closing + 1;
+
+            Token_e token_val = this->state() == LEXER_STATE_CHAR ? TOK_CHAR : TOK_STRING;
+            this->state_ = LEXER_STATE_NORMAL;
+            return literal_token(token_val, this->offset() - 1);
+        }
+
         while (true) {
             const int ch_str = next_char();
             // salt::dbout << salt::f_string("Next_char() was: %d\n", ch_str);
@@ -417,22 +432,17 @@ Result<Token> Lexer::next_token() {
             // Move the lexer's position forward.
             this->pos_++;
             this->col_++;
-            lexer_col++;
 
             if (ch_str == '\n') {
                 this->col_ = 1;
                 this->line_++;
-                lexer_col = 1;
-                lexer_line++;
             }
             if (ch_str == EOF)
                 salt::print_fatal("string or char literal terminated with EOF");
             if (ch_str == end_char) {
-                std::string string_to_return = cur_str;
-                cur_str.clear();
                 Token_e token_val = this->state() == LEXER_STATE_CHAR ? TOK_CHAR : TOK_STRING;
                 this->state_ = LEXER_STATE_NORMAL;
-                return Token(token_val, string_to_return);
+                return literal_token(token_val, this->offset() - 1);
             }
 
             cur_str += ch_str;
@@ -440,6 +450,21 @@ Result<Token> Lexer::next_token() {
         break; // Not necessary because of while (true) loop above, but compiler is not smart enough to know this
     }
     case LEXER_STATE_LINE_COMMENT: {
+        // Skip the rest of the comment in one go
+        if (input_mode_ == LexerInputMode::LEXER_INPUT_MODE_BUFFER) {
+            const char* comment_end = scan_to_newline(cursor_, buffer_end_);
+            const char* eol = comment_end != buffer_end_ ? comment_end : nullptr;
+            this->pos_ += static_cast<int>(comment_end - cursor_) + 1;
+            cursor_ = eol ? eol + 1 : buffer_end_;
+            if (!eol)
+                eof_reached = true;
+
+            this->state_ = LEXER_STATE_NORMAL;
+            this->line_++;
+            this->col_ = 1;
+            return eol ? Token(TOK_EOL, this->offset() - 1, 1) : Token(TOK_EOL, this->offset(), 0);
+        }
+
         while (1) {
             switch (this->next_char()) {
             case EOF:
@@ -448,13 +473,10 @@ Result<Token> Lexer::next_token() {
                 this->line_++;
                 this->col_ = 1;
                 this->pos_++;
-                lexer_col = col_;
-                lexer_line = line_;
-                return TOK_EOL; // fix #2
+                return eof_reached ? Token(TOK_EOL, this->offset(), 0) : Token(TOK_EOL, this->offset() - 1, 1); // fix #2
             default:
                 this->col_++;
                 this->pos_++;
-                lexer_col = col_;
                 break;
             }
         }
@@ -462,18 +484,16 @@ Result<Token> Lexer::next_token() {
         break;
 
     default:
-        return Token(TOK_ERROR, cur_str);
+        return Token(TOK_ERROR, this->offset(), 0, Interner::get()->intern(cur_str));
     }
 }
 
-std::vector<Token>& Lexer::tokenize(const char* str) {
-
+// Gets ready to read a new file
+void Lexer::begin() {
     Lexer* lexer = this;
-    Lexer* me = Lexer::get();
 
-    if (this != me) {
-        salt::print_fatal(salt::f_string("Wrong address for lexer.\nThis: %p\n Lexer::get(): %p", this, me).c_str());
-    }
+    if (source_)
+        salt::print_fatal("a Lexer can only read one file, make a new one instead");
     
     vec.clear();
 
@@ -482,7 +502,22 @@ std::vector<Token>& Lexer::tokenize(const char* str) {
             << lexer->current_string;
 
     lexer->current_string.clear();
-    Token NO_TOKEN = Token(TOK_NONE);
+
+    this->at_line_start_ = true;
+    this->line_indent_ = 0;
+    this->spaces_in_a_row_ = 0;
+    this->done_ = false;
+}
+
+void Lexer::open_text(const std::string& name, std::string text) {
+    begin();
+    use_buffer(name, std::move(text));
+    set_input_mode(LexerInputMode::LEXER_INPUT_MODE_BUFFER, nullptr);
+}
+
+// Gets the lexer ready to read str (or stdin if str is nullptr), without reading anything yet
+void Lexer::open(const char* str, LexerInputMode file_mode) {
+    begin();
 
     // if a string was passed into tokenize, try to read that as a file
     if (str) {
@@ -491,298 +526,335 @@ std::vector<Token>& Lexer::tokenize(const char* str) {
             salt::print_fatal(std::string(str) + ": file must end in .sl");
         }
 
-       
-        std::unique_ptr<std::ifstream> new_stream = std::make_unique<std::ifstream>(str);
-        if (!new_stream || !new_stream->is_open()) {
-            salt::print_fatal(std::string(str) + ": could not open file");
-        }
-
         salt::dbout << "compiling " << str << std::endl;
-        set_input_mode(LexerInputMode::LEXER_INPUT_MODE_FILE, std::move(new_stream));
+
+        if (file_mode == LexerInputMode::LEXER_INPUT_MODE_BUFFER) {
+            load_buffer(str);
+            set_input_mode(LexerInputMode::LEXER_INPUT_MODE_BUFFER, nullptr);
+        } else {
+            std::unique_ptr<std::ifstream> new_stream = std::make_unique<std::ifstream>(str);
+            if (!new_stream || !new_stream->is_open()) {
+                salt::print_fatal(std::string(str) + ": could not open file");
+            }
+
+            source_ = &SourceManager::get()->add_file(str);
+            set_input_mode(LexerInputMode::LEXER_INPUT_MODE_FILE, std::move(new_stream));
+        }
+    } else {
+        source_ = &SourceManager::get()->add_file("<stdin>");
     }
+}
 
-    while (true) {
-        if (Result<Token> next_res = lexer->next_token()) {
-            const Token next = next_res.unwrap();
-            // salt::dboutv << next << ' ';
-            Token& last = (vec.empty() ? NO_TOKEN : vec[vec.size() - 1]);
+// Reads one token and merges it into vec. Compound tokens are only ever merged into
+// the last 2 tokens of vec. Returns false once the EOF token has been added.
+bool Lexer::lex_next() {
+    Token NO_TOKEN = Token(TOK_NONE);
+    Lexer* lexer = this;
 
+    if (done_)
+        return false;
 
+    if (Result<Token> next_res = lexer->next_token()) {
+        const Token next = next_res.unwrap();
+        // salt::dboutv << next << ' ';
+        const size_t size_before = vec.size();
 
-            //
-            // Handling of compound tokens, and ignore "NONE" tokens.
-            //
+        // The previous token, and the one that next can be merged with. Compound tokens
+        // can't have anything in between, so last is only set if it ends right where next starts.
+        Token& prev = (vec.empty() ? NO_TOKEN : vec.back());
+        Token& last = (prev.offset() + prev.length() == next.offset() ? prev : NO_TOKEN);
 
-            switch (next.val()) {
-            case TOK_NONE:
-                break;
 
-            // If a whitespace follows another whitespace, it counts as 1 whitespace but
-            // whitespace counter is increased.
-            // If the whitespace counter is increased to 4, replace it with a tab instead.
-            case TOK_WHITESPACE:
-                if (last.val() == TOK_WHITESPACE) {
-                    int wc = last.count();
-
-                    if (wc > 2) {
-                        last = Token(TOK_TAB);
-
-                        #ifndef NDEBUG
-                        std::cerr << "Invalid handling of whitespace: " << wc
-                        << " unhandled whitespaces in a row at " 
-                        << lexer->line() << ':' << lexer->col();
-                        #endif
-                    }
-
-                    if (wc == 2)
-                        last = Token(TOK_TAB);
-                    else if (wc < 2)
-                        last = Token(TOK_WHITESPACE, "", wc + 1);
-                } else {
-                    vec.push_back(next);
-                    
-                }
-                break;
 
+        //
+        // Handling of compound tokens, and ignore "NONE" tokens.
+        //
 
-            case TOK_ADD:
-                if (last.val() == TOK_ADD)
-                    last = Token(TOK_INCREMENT);
-                else {
-                    vec.push_back(next);
-                    
-                }
-                break;
+        switch (next.val()) {
+        case TOK_NONE:
+            break;
 
+        // Whitespace only matters at the start of a line, where every tab or 4 spaces
+        // in a row is one level of indentation. A run of spaces may come in as a single token.
+        case TOK_WHITESPACE:
+            if (at_line_start_) {
+                spaces_in_a_row_ += next.length();
+                line_indent_ += spaces_in_a_row_ / 4;
+                spaces_in_a_row_ %= 4;
+            }
+            break;
 
-            case TOK_SUB:
-                if (last.val() == TOK_SUB)
-                    last = Token(TOK_DECREMENT);
-                else {
-                    vec.push_back(next);
-                    
-                }
-                break;
+        case TOK_TAB:
+            if (at_line_start_) {
+                line_indent_++;
+                spaces_in_a_row_ = 0;
+            }
+            break;
 
+        case TOK_EOL:
+            at_line_start_ = true;
+            line_indent_ = 0;
+            spaces_in_a_row_ = 0;
+            break;
 
-            case TOK_DIV:
-                switch (last.val()) {
-                case TOK_DIV:
-                    vec.pop_back(); // remove this div symbol and just set LexerState to line comment
-                    salt::print_warning(salt::f_string("%d:%d: please use # for line comments instead of //", last.line(), last.col()));
-                    this->state_ = LEXER_STATE_LINE_COMMENT;
-                    break;
-                case TOK_MUL:
-                    last = Token(TOK_COMMENT_END);
-                    break;
-                default:
-                    vec.push_back(next);
-                    break;
-                }
-                break;
 
+        case TOK_ADD:
+            if (last.val() == TOK_ADD)
+                last = last.merged(TOK_INCREMENT, next);
+            else {
+                vec.push_back(next);
+                
+            }
+            break;
+
+
+        case TOK_SUB:
+            if (last.val() == TOK_SUB)
+                last = last.merged(TOK_DECREMENT, next);
+            else {
+                vec.push_back(next);
+                
+            }
+            break;
 
+
+        case TOK_DIV:
+            switch (last.val()) {
+            case TOK_DIV:
+                salt::print_warning(salt::f_string("%d:%d: please use # for line comments instead of //", last.line(), last.col()));
+                vec.pop_back(); // remove this div symbol and just set LexerState to line comment
+                this->state_ = LEXER_STATE_LINE_COMMENT;
+                break;
             case TOK_MUL:
-                switch (last.val()) {
-                case TOK_DIV:
-                    last = Token(TOK_COMMENT_START);
-                    break;
-                case TOK_TYPE:
-                    last = Token(TOK_TYPE, last.data(), last.count() + 1);
-                    break;
-
-                // TOK_PTR deprecated!
-                case TOK_PTR:
-                    last = Token(TOK_PTR, last.data(), last.count() + 1);
-                    break;
-                default:
-                    vec.push_back(next);
-                    break;
-                }
+                last = last.merged(TOK_COMMENT_END, next);
                 break;
+            default:
+                vec.push_back(next);
+                break;
+            }
+            break;
 
 
-            case TOK_LEFT_ANGLE:
-                if (last.val() == TOK_LEFT_ANGLE)
-                    last = Token(TOK_LEFT_SHIFT);
-                else {
-                    vec.push_back(next);
-                }
+        case TOK_MUL:
+            switch (last.val()) {
+            case TOK_DIV:
+                last = last.merged(TOK_COMMENT_START, next);
+                break;
+            case TOK_TYPE:
+                last = last.merged(TOK_TYPE, next, last.count() + 1, last.symbol());
                 break;
-            
 
-            case TOK_RIGHT_ANGLE:
-                switch (last.val()) {
-                case TOK_RIGHT_ANGLE:
-                    last = Token(TOK_RIGHT_SHIFT);
-                    break;
-                case TOK_SUB:
-                    last = Token(TOK_ARROW);
-                    break;
-                default:
-                    vec.push_back(next);
-                    break; 
-                }
+            // TOK_PTR deprecated!
+            case TOK_PTR:
+                last = last.merged(TOK_PTR, next, last.count() + 1, last.symbol());
                 break;
-            
-            
-            case TOK_AMPERSAND:
-                if (last.val() == TOK_AMPERSAND)
-                    last = Token(TOK_AND);
-                else {
-                    vec.push_back(next);
-                }
+            default:
+                vec.push_back(next);
                 break;
+            }
+            break;
 
 
-            case TOK_VERTICAL_BAR:
-                if (last.val() == TOK_VERTICAL_BAR)
-                    last = Token(TOK_OR);
-                else {
-                    vec.push_back(next);
-                    
-                }
+        case TOK_LEFT_ANGLE:
+            if (last.val() == TOK_LEFT_ANGLE)
+                last = last.merged(TOK_LEFT_SHIFT, next);
+            else {
+                vec.push_back(next);
+            }
+            break;
+        
+
+        case TOK_RIGHT_ANGLE:
+            switch (last.val()) {
+            case TOK_RIGHT_ANGLE:
+                last = last.merged(TOK_RIGHT_SHIFT, next);
                 break;
+            case TOK_SUB:
+                last = last.merged(TOK_ARROW, next);
+                break;
+            default:
+                vec.push_back(next);
+                break; 
+            }
+            break;
+        
+        
+        case TOK_AMPERSAND:
+            if (last.val() == TOK_AMPERSAND)
+                last = last.merged(TOK_AND, next);
+            else {
+                vec.push_back(next);
+            }
+            break;
 
 
-            case TOK_ASSIGN:
-                switch (last.val()) {
-                case TOK_ADD:
-                    last = Token(TOK_ADD_ASSIGN);
-                    break;
-                case TOK_SUB:
-                    last = Token(TOK_SUB_ASSIGN);
-                    break;
-                case TOK_MUL:
-                    last = Token(TOK_MUL_ASSIGN);
-                    break;
-                case TOK_DIV:
-                    last = Token(TOK_DIV_ASSIGN);
-                    break;
-                case TOK_MODULO:
-                    last = Token(TOK_MODULO_ASSIGN);
-                    break;
-                case TOK_EXCLAMATION:
-                    last = Token(TOK_NOT_EQUALS);
-                    break;
-                case TOK_AMPERSAND:
-                    last = Token(TOK_AND_ASSIGN);
-                    break;
-                case TOK_VERTICAL_BAR:
-                    last = Token(TOK_OR_ASSIGN);
-                    break;
-                case TOK_TILDE:
-                    last = Token(TOK_TILDE_ASSIGN);
-                    break;
-                case TOK_LEFT_ANGLE:
-                    last = Token(TOK_EQUALS_SMALLER);
-                    break;
-                case TOK_RIGHT_ANGLE:
-                    last = Token(TOK_EQUALS_LARGER);
-                    break;
-                case TOK_ASSIGN:
-                    last = Token(TOK_EQUALS);
-                    break;
-                case TOK_LEFT_SHIFT:
-                    last = Token(TOK_LEFT_SHIFT_ASSIGN);
-                    break;
-                case TOK_RIGHT_SHIFT:
-                    last = Token(TOK_RIGHT_SHIFT_ASSIGN);
-                    break;
-                case TOK_CARAT:
-                    last = Token(TOK_XOR_ASSIGN);
-                    break;
-                default:
-                    vec.push_back(next);
-                    break;
-                }
-                break;
+        case TOK_VERTICAL_BAR:
+            if (last.val() == TOK_VERTICAL_BAR)
+                last = last.merged(TOK_OR, next);
+            else {
+                vec.push_back(next);
+                
+            }
+            break;
 
-            /// @todo: remove TOK_<THISTYPE>, change all to TOK_TYPE in end_token()
-            case TOK_CHAR_TYPE:
-                if (last_non_whitespace().val() == TOK_UNSIGNED)
-                    last_non_whitespace() = Token(TOK_TYPE, "uchar", 0, next.line(), next.col());
-                else
-                    vec.push_back(Token(TOK_TYPE, "char", 0, next.line(), next.col()));
-                break;
 
-            case TOK_SHORT:
-                if (last_non_whitespace().val() == TOK_UNSIGNED)
-                    last_non_whitespace() = Token(TOK_TYPE, "ushort", 0, next.line(), next.col());
-                else
-                    vec.push_back(Token(TOK_TYPE, "short", 0, next.line(), next.col()));
+        case TOK_ASSIGN:
+            switch (last.val()) {
+            case TOK_ADD:
+                last = last.merged(TOK_ADD_ASSIGN, next);
                 break;
-
-            case TOK_INT:
-                if (last_non_whitespace().val() == TOK_UNSIGNED)
-                    last_non_whitespace() = Token(TOK_TYPE, "uint", 0, next.line(), next.col());
-                else
-                    vec.push_back(Token(TOK_TYPE, "int", 0, next.line(), next.col()));
+            case TOK_SUB:
+                last = last.merged(TOK_SUB_ASSIGN, next);
                 break;
-
-            case TOK_LONG:
-                if (last_non_whitespace().val() == TOK_UNSIGNED)
-                    last_non_whitespace() = Token(TOK_TYPE, "ulong", 0, next.line(), next.col());
-                else
-                    vec.push_back(Token(TOK_TYPE, "long", 0, next.line(), next.col()));
+            case TOK_MUL:
+                last = last.merged(TOK_MUL_ASSIGN, next);
                 break;
-
-            case TOK_SSIZE:
-                vec.push_back(Token(TOK_TYPE, "ssize", 0, next.line(), next.col()));
+            case TOK_DIV:
+                last = last.merged(TOK_DIV_ASSIGN, next);
                 break;
-
-            case TOK_FLOAT:
-                vec.push_back(Token(TOK_TYPE, "float", 0, next.line(), next.col()));
+            case TOK_MODULO:
+                last = last.merged(TOK_MODULO_ASSIGN, next);
                 break;
-
-            case TOK_DOUBLE:
-                vec.push_back(Token(TOK_TYPE, "double", 0, next.line(), next.col()));
+            case TOK_EXCLAMATION:
+                last = last.merged(TOK_NOT_EQUALS, next);
                 break;
-
-            case TOK_VOID:
-                vec.push_back(Token(TOK_TYPE, "void", 0, next.line(), next.col()));
+            case TOK_AMPERSAND:
+                last = last.merged(TOK_AND_ASSIGN, next);
                 break;
-
-            case TOK_BOOL:
-                vec.push_back(Token(TOK_TYPE, "bool", 0, next.line(), next.col()));
+            case TOK_VERTICAL_BAR:
+                last = last.merged(TOK_OR_ASSIGN, next);
                 break;
-
-            case TOK_NUMBER:
-                // salt::dboutv << "before the dot: " << vec[vec.size() - 2].str() << '\n';
-                if (vec.size() < 2 || (vec.size() > 0 && last.val() != TOK_DOT)) {
-                    vec.push_back(Token(next.val(), next.data(), 0, next.line(), next.col()));
-                } else {
-                    Token& before_the_dot = vec[vec.size() - 2];
-                    if (before_the_dot.val() == TOK_NUMBER && before_the_dot.count() == 0) {
-                        vec.pop_back();
-                        before_the_dot = Token(TOK_NUMBER, before_the_dot.data() + '.' + next.data(), 1, before_the_dot.line(), before_the_dot.col());
-                    } else {
-                        vec.push_back(next);
-                    }
-                }
+            case TOK_TILDE:
+                last = last.merged(TOK_TILDE_ASSIGN, next);
+                break;
+            case TOK_LEFT_ANGLE:
+                last = last.merged(TOK_EQUALS_SMALLER, next);
+                break;
+            case TOK_RIGHT_ANGLE:
+                last = last.merged(TOK_EQUALS_LARGER, next);
+                break;
+            case TOK_ASSIGN:
+                last = last.merged(TOK_EQUALS, next);
+                break;
+            case TOK_LEFT_SHIFT:
+                last = last.merged(TOK_LEFT_SHIFT_ASSIGN, next);
+                break;
+            case TOK_RIGHT_SHIFT:
+                last = last.merged(TOK_RIGHT_SHIFT_ASSIGN, next);
+                break;
+            case TOK_CARAT:
+                last = last.merged(TOK_XOR_ASSIGN, next);
                 break;
             default:
                 vec.push_back(next);
                 break;
             }
+            break;
 
-            if (next.val() == TOK_EOF)
-                break;
+        /// @todo: remove TOK_<THISTYPE>, change all to TOK_TYPE in end_token()
+        case TOK_CHAR_TYPE:
+            if (prev.val() == TOK_UNSIGNED)
+                prev = prev.merged(TOK_TYPE, next, 0, Interner::get()->intern("uchar"));
+            else
+                vec.push_back(Token(TOK_TYPE, next.offset(), next.length(), Interner::get()->intern(next.data())));
+            break;
 
-        } else /* if Result of next_token() was an Exception */ {
-            lexer->errors_.push_back(next_res.unwrap_err());
-        }
+        case TOK_SHORT:
+            if (prev.val() == TOK_UNSIGNED)
+                prev = prev.merged(TOK_TYPE, next, 0, Interner::get()->intern("ushort"));
+            else
+                vec.push_back(Token(TOK_TYPE, next.offset(), next.length(), Interner::get()->intern(next.data())));
+            break;
+
+        case TOK_INT:
+            if (prev.val() == TOK_UNSIGNED)
+                prev = prev.merged(TOK_TYPE, next, 0, Interner::get()->intern("uint"));
+            else
+                vec.push_back(Token(TOK_TYPE, next.offset(), next.length(), Interner::get()->intern(next.data())));
+            break;
+
+        case TOK_LONG:
+            if (prev.val() == TOK_UNSIGNED)
+                prev = prev.merged(TOK_TYPE, next, 0, Interner::get()->intern("ulong"));
+            else
+                vec.push_back(Token(TOK_TYPE, next.offset(), next.length(), Interner::get()->intern(next.data())));
+            break;
+
+        case TOK_SSIZE:
+            vec.push_back(Token(TOK_TYPE, next.offset(), next.length(), Interner::get()->intern(next.data())));
+            break;
+
+        case TOK_FLOAT:
+            vec.push_back(Token(TOK_TYPE, next.offset(), next.length(), Interner::get()->intern(next.data())));
+            break;
+
+        case TOK_DOUBLE:
+            vec.push_back(Token(TOK_TYPE, next.offset(), next.length(), Interner::get()->intern(next.data())));
+            break;
 
-        if (eof_reached)
+        case TOK_VOID:
+            vec.push_back(Token(TOK_TYPE, next.offset(), next.length(), Interner::get()->intern(next.data())));
             break;
+
+        case TOK_BOOL:
+            vec.push_back(Token(TOK_TYPE, next.offset(), next.length(), Interner::get()->intern(next.data())));
+            break;
+
+        case TOK_NUMBER:
+            // salt::dboutv << "before the dot: " << vec[vec.size() - 2].str() << '\n';
+            if (vec.size() < 2 || (vec.size() > 0 && last.val() != TOK_DOT)) {
+                vec.push_back(next);
+            } else {
+                Token& before_the_dot = vec[vec.size() - 2];
+                const bool touches_dot = before_the_dot.offset() + before_the_dot.length() == last.offset();
+                if (touches_dot && before_the_dot.val() == TOK_NUMBER && before_the_dot.count() == 0) {
+                    vec.pop_back();
+                    before_the_dot = before_the_dot.merged(TOK_NUMBER, next, 1);
+                } else {
+                    vec.push_back(next);
+                }
+            }
+            break;
+        default:
+            vec.push_back(next);
+            break;
+        }
+
+        // The first token we keep on a line gets the line's indentation
+        if (at_line_start_ && vec.size() > size_before) {
+            vec.back().set_indent(line_indent_);
+            at_line_start_ = false;
+        }
+
+        if (next.val() == TOK_EOF) {
+            done_ = true;
+            return false;
+        }
+
+    } else /* if Result of next_token() was an Exception */ {
+        lexer->errors_.push_back(next_res.unwrap_err());
     }
 
+    if (!eof_reached)
+        return true;
+
     if ((!vec.empty() && vec.back().val() != TOK_EOF) || vec.empty()) {
         if (salt::dberr.is_active())
             salt::print_warning("could not read EOF; please try ending your file with a newline character");
-        vec.push_back(Token(TOK_EOF));
+        vec.push_back(Token(TOK_EOF, this->offset(), 0));
+        if (at_line_start_)
+            vec.back().set_indent(line_indent_);
     }
 
+    done_ = true;
+    return false;
+}
+
+std::vector<Token>& Lexer::tokenize(const char* str, LexerInputMode file_mode) {
+    open(str, file_mode);
+    while (lex_next())
+        ;
+
     if (salt::dboutv.is_active())
         for (const Token& tok : vec)
             salt::dboutv << tok << std::endl;
@@ -790,7 +862,21 @@ std::vector<Token>& Lexer::tokenize(const char* str) {
     return vec;
 }
 
-std::vector<Token>& tokenize(const char* str) {
-    Lexer* lexer = Lexer::get();
-    return lexer->tokenize(str);
+// Hands out tokens one at a time. Two tokens are always kept back until the end of the
+// file, since lex_next() might still merge the next token into them.
+Token Lexer::pull() {
+    while (vec.size() < 3 && lex_next())
+        ;
+
+    if (vec.empty())
+        return Token(TOK_EOF, this->offset(), 0);
+
+    const Token tok = vec.front();
+    vec.erase(vec.begin());
+    return tok;
+}
+
+std::vector<Token> tokenize(const char* str) {
+    Lexer lexer;
+    return std::move(lexer.tokenize(str));
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "tokens.h"
 #include "miniregex.h"
+#include "sourcemanager.h"
 #include "../common.h"
 #include <vector>
 
@@ -15,7 +16,8 @@ enum LexerState {
 
 enum class LexerInputMode {
     LEXER_INPUT_MODE_STDIN,
-    LEXER_INPUT_MODE_FILE
+    LEXER_INPUT_MODE_FILE,  // reads the file through an std::ifstream, one char at a time
+    LEXER_INPUT_MODE_BUFFER // reads the whole file at once and walks a const char* cursor over it
 };
 
 class Lexer {
@@ -25,24 +27,36 @@ private:
     int pos_;
     std::vector<Token> vec;
     LexerState state_;
-    static Lexer* instance_;
-    std::vector<salt::Exception> errors_;
+    std::vector<salt::Error> errors_;
     std::unique_ptr<std::ifstream> stream_;
+    SourceFile* source_;            // the file being read, owned by the SourceManager
+    const char* cursor_;            // next char to be read from source_, only used in LEXER_INPUT_MODE_BUFFER
+    const char* buffer_end_;
     int next_char();
+    uint32_t offset() const;
+    Token literal_token(Token_e token_val, uint32_t end);
+    void load_buffer(const char* file_name);
+    void use_buffer(const std::string& file_name, std::string text);
+    void begin();
     LexerInputMode input_mode_;
     bool eof_reached = false;
-    Lexer();
-    ~Lexer();
+    bool done_ = false;             // true once the EOF token is in vec
+    bool at_line_start_ = true;     // no token has been kept on the current line yet
+    int line_indent_ = 0;
+    int spaces_in_a_row_ = 0;
+    bool lex_next();
 
 public:
-    static Lexer* get();
-    static void destroy();
+    // Every file gets its own Lexer, so any number of files can be lexed at the same time
+    // (as long as they are read in LEXER_INPUT_MODE_BUFFER, see SourceManager::add_file())
+    Lexer();
+    ~Lexer();
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
 
 
     salt::Result<Token> next_token();
     Token end_token();
-    Token& last_non_whitespace();
-    Lexer* test_lexer();
     void set_input_mode(LexerInputMode input_mode, std::unique_ptr<std::ifstream> stream);
     LexerInputMode input_mode() const;
     int col() const;
@@ -54,12 +68,22 @@ public:
     std::string current_string; /// @todo: make these 2 private
     std::string identifier_string;
 
-    const std::vector<salt::Exception>& errors();
+    const std::vector<salt::Error>& errors();
+
+    // Starts reading a file, tokens are then read with pull()
+    void open(const char* str = nullptr, LexerInputMode file_mode = LexerInputMode::LEXER_INPUT_MODE_BUFFER);
+
+    // Like open(), but reads text instead of the file called name (which doesn't have to exist), for editors
+    void open_text(const std::string& name, std::string text);
+
+    // Returns the next token of the file given to open(), or EOF forever once the file is over
+    Token pull();
 
-    // don't use Lexer::tokenize(), use simple tokenize() instead
-    std::vector<Token>& tokenize(const char* str = nullptr);
+    // Reads the whole file at once. A Lexer can only tokenize one file.
+    // file_mode is only used if str is not nullptr, stdin is always read as a stream
+    std::vector<Token>& tokenize(const char* str = nullptr, LexerInputMode file_mode = LexerInputMode::LEXER_INPUT_MODE_BUFFER);
 
 };
 
-// Parses the input file into tokens, which are stored in vec.
-std::vector<Token>& tokenize(const char* str);
+// Parses the input file into tokens with a Lexer of its own.
+std::vector<Token> tokenize(const char* str);
@@ -2,6 +2,11 @@
 #include <cstdlib>
 #include "lexer.h"
 #include "parser.h"
+#include "astcache.h"
+#include "functioncache.h"
+#include "sema.h"
+#include "constantfolder.h"
+#include "diagnostics.h"
 #include "../common.h"
 #include "irgenerator.h"
 #include "flags.h"
@@ -19,6 +24,11 @@ static std::vector<std::string> compiled_files; // we will link them all togethe
 static int link_all();
 std::string output_name = "a";
 static bool user_chosen_output_name = false;
+static bool tokenize_whole_files = false;
+static bool syntax_only = false;
+static std::string ast_cache_dir; // --ast-cache DIR, empty if there is no cache
+static std::string fn_cache_dir; // --fn-cache DIR, same for the IR of every function
+static ConstEvalLimits const_eval_limits; // --const-eval-steps N and --const-eval-memory BYTES
 const char* PRELUDE_FILE = "prelude.sl";
 static llvm::OptimizationLevel optimization_level = llvm::OptimizationLevel::O0;
 std::vector<std::string> salt::file_names = { PRELUDE_FILE };
@@ -109,6 +119,12 @@ static void set_flags(const std::vector<CompilerFlag>& flags) {
         case f::NO_STD:
             salt::no_std = true;
             break;
+        case f::TOKEN_VECTOR:
+            tokenize_whole_files = true;
+            break;
+        case f::SYNTAX_ONLY:
+            syntax_only = true;
+            break;
         default:
             salt::print_fatal(salt::f_string("bad flag to set_flags(): %d", flag));
         }
@@ -118,6 +134,15 @@ static void set_flags(const std::vector<CompilerFlag>& flags) {
 }
 
 
+// The number after an option like --const-eval-steps, which has to be a positive integer
+static uint64_t parse_limit(const char* option, const char* arg) {
+    char* end = nullptr;
+    const uint64_t res = arg ? std::strtoull(arg, &end, 10) : 0;
+    if (!arg || *end || res == 0 || arg[0] == '-')
+        salt::print_fatal(salt::f_string("expected a positive number after %s", option));
+    return res;
+}
+
 int main(int argc, const char** argv) {
     register_signal_handlers();
     std::vector<const char*> input_files;
@@ -139,6 +164,40 @@ int main(int argc, const char** argv) {
             }
         }
 
+        // Handle --ast-cache, the directory where parsed files are cached
+        if (argv[i] == std::string("--ast-cache")) {
+            i++;
+            if (i < argc && argv[i]) {
+                ast_cache_dir = argv[i];
+                continue;
+            } else {
+                salt::print_fatal("expected directory after --ast-cache");
+            }
+        }
+
+        // Handle --fn-cache, the directory where the IR of compiled functions is cached
+        if (argv[i] == std::string("--fn-cache")) {
+            i++;
+            if (i < argc && argv[i]) {
+                fn_cache_dir = argv[i];
+                continue;
+            } else {
+                salt::print_fatal("expected directory after --fn-cache");
+            }
+        }
+
+        // Handle --const-eval-steps and --const-eval-memory, how much one call to a const fn can do while compiling
+        if (argv[i] == std::string("--const-eval-steps")) {
+            i++;
+            const_eval_limits.steps = parse_limit("--const-eval-steps", i < argc ? argv[i] : nullptr);
+            continue;
+        }
+        if (argv[i] == std::string("--const-eval-memory")) {
+            i++;
+            const_eval_limits.memory = parse_limit("--const-eval-memory", i < argc ? argv[i] : nullptr);
+            continue;
+        }
+
         if (Flags::all_flags.count(argv[i])) /* if argv[i] is a flag, then */ {
             // add this flag to compiler_flags.
             /// @todo: add flags which are options/have data (for example: -o output.exe)
@@ -157,49 +216,104 @@ int main(int argc, const char** argv) {
         salt::print_fatal("no input files");
 
     set_flags(compiler_flags);
-    BinaryOperator::fill_map();
     salt::fill_types();
 
     try {
+        // read the prelude, which consists of function headers.
+        // It's only parsed once, and then declared again in every file's module
+        AstArena prelude_arena;
+        std::vector<DeclarationAST*> prelude;
+        {
+            salt::current_file_name_index = 0;
+            PrintingDiagnosticSink prelude_diagnostics;
+            {
+                Parser prelude_parser = Parser(PRELUDE_FILE, prelude_diagnostics, prelude_arena, tokenize_whole_files);
+                prelude = prelude_parser.parse_declarations();
+            }
+            SourceManager::destroy();
+            if (prelude_diagnostics.has_errors())
+                salt::print_fatal(std::string(PRELUDE_FILE) + ": could not parse the prelude");
+            salt::dbout << "Parsed " << prelude.size() << " prelude declarations" << std::endl;
+        }
+
+        // The AST of a file also depends on the prelude (calls get the return type of what they call)
+        std::unique_ptr<AstCache> ast_cache;
+        if (!ast_cache_dir.empty())
+            ast_cache = std::make_unique<AstCache>(ast_cache_dir, AstCache::hash_file(PRELUDE_FILE));
+
+        // The IR of a function also depends on the flags that change the code we make
+        std::unique_ptr<FunctionCache> fn_cache;
+        if (!fn_cache_dir.empty()) {
+            const uint64_t flags[3] = {
+                static_cast<uint64_t>(salt::no_std),
+                static_cast<uint64_t>(optimization_level.getSpeedupLevel()),
+                static_cast<uint64_t>(optimization_level.getSizeLevel()),
+            };
+            fn_cache = std::make_unique<FunctionCache>(fn_cache_dir, salt::hash_bytes(flags, sizeof(flags)));
+        }
+
         int next_file_name_index = 0;
         for (const char* input_file : input_files) {
             next_file_name_index++;
             salt::file_names.push_back(input_file);
-            // read the prelude, which consists of function headers
+            // read the current file.
+            // The lexer only reads ahead as far as the parser needs, unless --tokvec is set
             any_compile_error_occured = false;
-            salt::current_file_name_index = 0;
-            Lexer* lexer = Lexer::get();
-            std::vector<Token> vec = lexer->tokenize(PRELUDE_FILE);
-            while (vec.size() && vec.back().val() == TOK_EOF)
-                vec.pop_back();
-            vec.push_back(TOK_EOL); vec.push_back(TOK_EOL);
-            Lexer::destroy();
-
-            // read the current file
             salt::current_file_name_index = next_file_name_index;
-            lexer = Lexer::get();
-            std::vector<Token> input_vec = lexer->tokenize(input_file);
-            vec.insert(vec.end(), std::make_move_iterator(input_vec.begin()), std::make_move_iterator(input_vec.end()));
-            salt::dbout << "Done tokenizing" << std::endl;
-            for (const salt::Exception& e : lexer->errors())
-                salt::dbout << e.what() << std::endl;
-            
-            // Parse tokens and form AST
-            Parser* parser = Parser::get(vec);
-            parser->parse();
-            
+            PrintingDiagnosticSink diagnostics;
+            AstArena arena;
+
+            // Parse tokens and form the AST of the whole file (or load it from the cache), then type check it, fold its constants and generate code for it
+            TranslationUnitAST unit;
+            if (!ast_cache || !ast_cache->load(input_file, arena, unit)) {
+                Parser parser = Parser(input_file, diagnostics, arena, tokenize_whole_files);
+                parser.declare(prelude);
+                parser.parse();
+                unit = parser.unit();
+                salt::dbout << "Done parsing, peak token buffer: " << parser.tokens().capacity() << " tokens, "
+                    << unit.functions.size() << " functions" << std::endl;
+
+                // A hit skips the lexer and parser, so their warnings would be gone next time
+                if (ast_cache && !diagnostics.has_errors() && diagnostics.warning_count() == 0 && !any_compile_error_occured)
+                    ast_cache->store(input_file, unit);
+            }
+
+            // Type check it (also with --fsyntax-only, type errors are errors too)
+            if (!diagnostics.has_errors())
+                Sema(input_file, diagnostics, arena).check(unit, prelude);
+
+            // Folding runs const fns, which can fail too
+            if (!syntax_only && !diagnostics.has_errors() && !any_compile_error_occured) {
+                ConstantFolder folder = ConstantFolder(input_file, diagnostics, arena, const_eval_limits);
+                folder.fold(unit);
+                salt::dbout << "Folded " << folder.folded() << " constant expressions ("
+                    << folder.evaluated() << " const fn calls)" << std::endl;
+                if (!diagnostics.has_errors())
+                    unit.code_gen(prelude, fn_cache.get());
+            }
 
             // Compile the file
-            if (!any_compile_error_occured)
-                compile_to_object(compiler_flags);
-            else
+            if (diagnostics.has_errors() || any_compile_error_occured)
                 any_compile_error_in_any_file = true;
+            else if (!syntax_only)
+                compile_to_object(compiler_flags);
 
             // Reset everything so we can start compiling the next file
-            Lexer::destroy();
-            Parser::destroy();
             IRGenerator::destroy();
+            SourceManager::destroy();
         }
+
+        if (ast_cache && ast_cache->hits() + ast_cache->misses() > 0)
+            salt::dbout << "AST cache: " << ast_cache->hits() << " hits, " << ast_cache->misses() << " misses ("
+                << 100 * ast_cache->hits() / (ast_cache->hits() + ast_cache->misses()) << "% hit rate)" << std::endl;
+        if (fn_cache && fn_cache->hits() + fn_cache->misses() > 0)
+            salt::dbout << "Function cache: " << fn_cache->hits() << " hits, " << fn_cache->misses() << " misses ("
+                << 100 * fn_cache->hits() / (fn_cache->hits() + fn_cache->misses()) << "% hit rate)" << std::endl;
+
+        // With --fsyntax-only there is nothing to link, all we wanted to know was whether there were errors
+        if (syntax_only)
+            return any_compile_error_in_any_file ? EXIT_FAILURE : EXIT_SUCCESS;
+
         if (!any_compile_error_in_any_file && salt::main_function_found)
             salt::dbout << salt::Color::GREEN << "\nCompilation success!\n" << salt::Color::WHITE;
 
@@ -1,33 +1,7 @@
 #include "miniregex.h"
 #include "types.h"
 
-// Data
-const char ALLOWED_CHARS[] = 
-"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!\"@#%&/()=[]<>+-*,.;:|_^ \n\t\r'";
-const int ALLOWED_CHARS_LEN = sizeof(ALLOWED_CHARS) - 1;
-const int ALLOWED_SYMBOLS_START = 62;
-
-
 // Functions
-bool is_alphabetic (const char ch) {
-    if (ch >= 'a' && ch <= 'z')
-        return true;
-    else if (ch >= 'A' && ch <= 'Z')
-        return true;
-    
-    return false;
-}
-
-
-bool is_alphanumeric(const char ch) {
-    if (is_digit(ch))
-        return true;
-    else if (is_alphabetic(ch))
-        return true;
-    
-    return false;
-}
-
 bool is_alphanumeric(const char* str) {
     while (*str) {
         if (!is_alphanumeric(*str))
@@ -38,25 +12,6 @@ bool is_alphanumeric(const char* str) {
 }
 
 
-bool is_valid_symbol(const char ch) {
-    for (int i = ALLOWED_SYMBOLS_START; ALLOWED_CHARS[i] != '\0'; i++)
-        if (ch == ALLOWED_CHARS[i])
-            return true;
-    return false;
-}
-
-
-bool is_allowed(const char ch) {
-    if (is_digit(ch))
-        return true;
-    else if (is_alphabetic(ch))
-        return true;
-    else if (is_valid_symbol(ch))
-        return true;
-    
-    return false;
-}
-
 bool is_integer(const char* s) {
     if (*s == '-')
         s++;
@@ -4,12 +4,47 @@
 #include <string>
 #include "../common.h"
 #include <unordered_map>
+#include <array>
+#include <cstdint>
 
-extern const char ALLOWED_CHARS[];
-extern const int ALLOWED_CHARS_LEN;
-extern const int ALLOWED_SYMBOLS_START;
+inline constexpr char ALLOWED_CHARS[] =
+"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!\"@#%&/()=[]<>+-*,.;:|_^ \n\t\r'";
+inline constexpr int ALLOWED_CHARS_LEN = sizeof(ALLOWED_CHARS) - 1;
+inline constexpr int ALLOWED_SYMBOLS_START = 62;
 extern const char SEPARATOR_CHARS[];
 constexpr size_t INVALID_INDEX = -1;
+
+// Flags for every possible char, so classifying a char is a single table lookup.
+enum CharClass : uint8_t {
+    CHAR_CLASS_ALPHA        = 1 << 0,
+    CHAR_CLASS_DIGIT        = 1 << 1,
+    CHAR_CLASS_SYMBOL       = 1 << 2,   // one of the symbols in ALLOWED_CHARS
+    CHAR_CLASS_SEPARATOR    = 1 << 3,   // a symbol that ends the current token, so anything but '_'
+    CHAR_CLASS_IDENT        = 1 << 4,   // can be part of an identifier or number: [a-zA-Z0-9_]
+    CHAR_CLASS_ALLOWED      = 1 << 5,
+};
+
+inline constexpr std::array<uint8_t, 256> CHAR_CLASS_TABLE = [] {
+    std::array<uint8_t, 256> table = {};
+    for (int ch = 'a'; ch <= 'z'; ch++)
+        table[ch] |= CHAR_CLASS_ALPHA | CHAR_CLASS_IDENT | CHAR_CLASS_ALLOWED;
+    for (int ch = 'A'; ch <= 'Z'; ch++)
+        table[ch] |= CHAR_CLASS_ALPHA | CHAR_CLASS_IDENT | CHAR_CLASS_ALLOWED;
+    for (int ch = '0'; ch <= '9'; ch++)
+        table[ch] |= CHAR_CLASS_DIGIT | CHAR_CLASS_IDENT | CHAR_CLASS_ALLOWED;
+    for (int i = ALLOWED_SYMBOLS_START; i < ALLOWED_CHARS_LEN; i++) {
+        const unsigned char ch = static_cast<unsigned char>(ALLOWED_CHARS[i]);
+        table[ch] |= CHAR_CLASS_SYMBOL | CHAR_CLASS_ALLOWED;
+        if (ch != '_')
+            table[ch] |= CHAR_CLASS_SEPARATOR;
+    }
+    table['_'] |= CHAR_CLASS_IDENT;
+    return table;
+}();
+
+inline bool char_is(const char ch, uint8_t char_class) {
+    return CHAR_CLASS_TABLE[static_cast<unsigned char>(ch)] & char_class;
+}
 inline bool is_digit(const char ch);
 inline bool is_whitespace(const char ch);
 inline bool ends_with_whitespace(const std::string& s);
@@ -20,11 +55,11 @@ inline std::string trim_last(const std::string& s);
 std::string trim_whitespace(const std::string& s);
 bool is_type(const char* s);
 bool is_type(const std::string& s);
-bool is_alphanumeric(const char ch);
+inline bool is_alphanumeric(const char ch);
 bool is_alphanumeric(const char* str);
-bool is_alphabetic(const char ch);
-bool is_valid_symbol(const char ch);
-bool is_allowed(const char ch);
+inline bool is_alphabetic(const char ch);
+inline bool is_valid_symbol(const char ch);
+inline bool is_allowed(const char ch);
 bool is_integer(const char* str);
 bool is_pointer(const std::string& s);
 bool string_ends_with(const char* str, const char* end);
@@ -36,6 +71,22 @@ inline bool is_digit(const char ch) {
     return (ch >= '0' && ch <= '9');
 }
 
+inline bool is_alphabetic(const char ch) {
+    return char_is(ch, CHAR_CLASS_ALPHA);
+}
+
+inline bool is_alphanumeric(const char ch) {
+    return char_is(ch, CHAR_CLASS_ALPHA | CHAR_CLASS_DIGIT);
+}
+
+inline bool is_valid_symbol(const char ch) {
+    return char_is(ch, CHAR_CLASS_SYMBOL);
+}
+
+inline bool is_allowed(const char ch) {
+    return char_is(ch, CHAR_CLASS_ALLOWED);
+}
+
 inline bool is_whitespace(const char ch) {
     return (ch == '\n' || ch == '\r' || ch == '\t' || ch == ' ');
 }
@@ -53,7 +104,7 @@ inline bool ends_with_whitespace_or_eof(const std::string& s) {
 }
 
 inline bool is_separator(const char ch) {
-    return (is_valid_symbol(ch) || ch == EOF) && ch != '_';
+    return char_is(ch, CHAR_CLASS_SEPARATOR) || ch == EOF;
 }
 
 inline std::string trim_last(const std::string& s) {
@@ -1,10 +1,107 @@
 #pragma once
-#include <map>
+#include <array>
+#include <cstdint>
 #include "tokens.h"
 
+// Everything the parser needs to know about an operator, in one table indexed by Token_e.
+// Tokens that aren't operators have fixity NOT_AN_OPERATOR and precedence -1.
+namespace Operator {
+	enum Fixity : uint8_t {
+		NOT_AN_OPERATOR	= 0,
+		PREFIX			= 1 << 0,	// -x
+		INFIX			= 1 << 1,	// x - y
+		POSTFIX			= 1 << 2,	// f(x), x[i]
+	};
 
-namespace BinaryOperator {
-	extern std::map<Token_e, int> BINOP_MAP;
-	void fill_map();
-	int get_precedence(const Token_e val);
-}
\ No newline at end of file
+	enum class Assoc : uint8_t {
+		LEFT,						// a - b - c is (a - b) - c
+		RIGHT,						// a = b = c is a = (b = c)
+	};
+
+	struct Info {
+		uint8_t fixity;
+		int8_t precedence;			// of the infix form, higher binds tighter
+		Assoc assoc;
+	};
+
+	// Prefix operators bind tighter than every infix operator, -x as int is (-x) as int
+	constexpr int PREFIX_PRECEDENCE = 14;
+
+	namespace detail {
+		constexpr std::array<Info, TOK_TOTAL - TOK_MIN> make_table() {
+			std::array<Info, TOK_TOTAL - TOK_MIN> table = {};
+			for (Info& info : table)
+				info = { NOT_AN_OPERATOR, -1, Assoc::LEFT };
+
+			auto infix = [&table](Token_e tok, int precedence, Assoc assoc = Assoc::LEFT) {
+				table[tok - TOK_MIN].fixity |= INFIX;
+				table[tok - TOK_MIN].precedence = static_cast<int8_t>(precedence);
+				table[tok - TOK_MIN].assoc = assoc;
+			};
+			auto prefix = [&table](Token_e tok) { table[tok - TOK_MIN].fixity |= PREFIX; };
+			auto postfix = [&table](Token_e tok) { table[tok - TOK_MIN].fixity |= POSTFIX; };
+
+			infix(TOK_AS, 13);
+
+			infix(TOK_MUL, 12);
+			infix(TOK_DIV, 12);
+			infix(TOK_MODULO, 12);
+
+			infix(TOK_ADD, 11);
+			infix(TOK_SUB, 11);
+
+			infix(TOK_LEFT_SHIFT, 10);
+			infix(TOK_RIGHT_SHIFT, 10);
+
+			infix(TOK_LEFT_ANGLE, 9);
+			infix(TOK_RIGHT_ANGLE, 9);
+			infix(TOK_EQUALS_SMALLER, 9);
+			infix(TOK_EQUALS_LARGER, 9);
+
+			infix(TOK_EQUALS, 8);
+			infix(TOK_NOT_EQUALS, 8);
+
+			infix(TOK_AMPERSAND, 7);		// bitwise and
+			infix(TOK_CARAT, 6);			// bitwise xor
+			infix(TOK_VERTICAL_BAR, 5);		// bitwise or
+			infix(TOK_AND, 4);				// && or "and"
+			infix(TOK_OR, 3);				// || or "or"
+
+			infix(TOK_ASSIGN, 2, Assoc::RIGHT);
+			infix(TOK_ADD_ASSIGN, 2, Assoc::RIGHT);
+			infix(TOK_SUB_ASSIGN, 2, Assoc::RIGHT);
+			infix(TOK_MUL_ASSIGN, 2, Assoc::RIGHT);
+			infix(TOK_DIV_ASSIGN, 2, Assoc::RIGHT);
+			infix(TOK_MODULO_ASSIGN, 2, Assoc::RIGHT);
+			infix(TOK_LEFT_SHIFT_ASSIGN, 2, Assoc::RIGHT);
+			infix(TOK_RIGHT_SHIFT_ASSIGN, 2, Assoc::RIGHT);
+			infix(TOK_AND_ASSIGN, 2, Assoc::RIGHT);
+			infix(TOK_OR_ASSIGN, 2, Assoc::RIGHT);
+			infix(TOK_XOR_ASSIGN, 2, Assoc::RIGHT);
+
+			prefix(TOK_SUB);				// negation
+			prefix(TOK_EXCLAMATION);		// logical not
+			prefix(TOK_NOT);				// "not"
+			prefix(TOK_TILDE);				// bitwise not
+			prefix(TOK_MUL);				// dereference
+
+			postfix(TOK_LEFT_BRACKET);		// call
+			postfix(TOK_LEFT_SQUARE);		// index
+
+			return table;
+		}
+	}
+
+	inline constexpr std::array<Info, TOK_TOTAL - TOK_MIN> TABLE = detail::make_table();
+
+	constexpr const Info& info(Token_e tok)			{ return TABLE[tok - TOK_MIN]; }
+	constexpr int get_precedence(Token_e tok)		{ return info(tok).precedence; }
+	constexpr bool is_infix(Token_e tok)			{ return info(tok).fixity & INFIX; }
+	constexpr bool is_prefix(Token_e tok)			{ return info(tok).fixity & PREFIX; }
+	constexpr bool is_postfix(Token_e tok)			{ return info(tok).fixity & POSTFIX; }
+	constexpr bool is_right_assoc(Token_e tok)		{ return info(tok).assoc == Assoc::RIGHT; }
+
+	static_assert(get_precedence(TOK_MUL) > get_precedence(TOK_ADD), "* must bind tighter than +");
+	static_assert(get_precedence(TOK_ADD_ASSIGN) == get_precedence(TOK_ASSIGN), "all assignments have the same precedence");
+	static_assert(get_precedence(TOK_IDENT) == -1, "identifiers aren't operators");
+}
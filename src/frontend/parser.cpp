@@ -3,100 +3,40 @@
 #include "ast.h"
 #include "miniregex.h"
 #include "irgenerator.h"
+#include "sourcemanager.h"
 
 #define PARSER_MAX_ERRORS 20
 
 using namespace salt;
 
-Parser* Parser::instance = nullptr;
-
-Parser* Parser::get() {
-    return Parser::instance;
-}
-
-Parser* Parser::get(const std::vector<Token>& vec) {
-    Parser::destroy();
-    Parser::instance = new Parser(vec);
-    return Parser::instance;
-}
-
-void Parser::destroy() {
-    if (Parser* p = Parser::get())
-        delete p;
-    Parser::instance = nullptr;
-}
-
-Parser::Parser(const std::vector<Token>& vec_ref) : vec(vec_ref), is_parsing_extern(false) {
+Parser::Parser(const std::string& file_name, DiagnosticSink& diagnostics, AstArena& arena, bool whole_file) :
+    file_name_(file_name), diagnostics_(diagnostics), arena_(arena), vec({ file_name }, whole_file), is_parsing_extern(false) {
     this->current_idx = 0;
     this->current_scope = 0;
-    this->line_just_started = true;
     this->is_suffering_from_syntax_error = false;
     this->is_parsing_extern = false; // dontuse
 }
 
-// Helper functions for Parser::parse().
-bool Parser::skip_whitespace() {
-    int spaces_in_a_row = 0;
-    bool looping = true;
-    bool return_val = false;
-
-    while (looping) {
-        Token_e val = vec[current_idx].val();
-        switch (val) {
-        case TOK_WHITESPACE:
-            current_idx++;
-            spaces_in_a_row++;
-            ASSERT(spaces_in_a_row < 4);
-            break;
-        case TOK_TAB:
-            current_idx++;
-            spaces_in_a_row = 0;
-            current_scope += line_just_started;
-            break;
-        case TOK_EOL:
-            current_idx++;
-            line_just_started = true;
-            current_scope = 0;
-            spaces_in_a_row = 0;
-            return_val = true;
-            break;
-        default:
-            looping = false;
-            spaces_in_a_row = 0;
-            line_just_started = false;
-        }
-    }
+Parser::Parser(const std::string& file_name, std::string text, DiagnosticSink& diagnostics, AstArena& arena) :
+    file_name_(file_name), diagnostics_(diagnostics), arena_(arena), vec(file_name, std::move(text)), is_parsing_extern(false) {
+    this->current_idx = 0;
+    this->current_scope = 0;
+    this->is_suffering_from_syntax_error = false;
+}
 
-    return return_val;
+void Parser::error_at(const Token& tok, const std::string& message) {
+    diagnostics_.error(file_name_ + " - " + std::to_string(tok.line()) + ':' + std::to_string(tok.col()) + ": " + message);
 }
 
-// warning, this function does not set current_scope correctly
-// if you use it remember to restore current_scope!
-bool Parser::skip_whitespace_back() {
-    bool looping = true;
-    bool return_val = false;
-
-    while (looping && current_idx > 0) {
-        Token_e val = vec[current_idx].val();
-        switch (val) {
-        case TOK_WHITESPACE:
-            current_idx--;
-            break;
-        case TOK_TAB:
-            current_idx--;
-            break;
-        case TOK_EOL:
-            current_idx--;
-            return_val = true;
-            break;
-        default:
-            looping = false;
-        }
-    }
+void Parser::warning_at(const Token& tok, const std::string& message) {
+    diagnostics_.warning(file_name_ + " - " + std::to_string(tok.line()) + ':' + std::to_string(tok.col()) + ": " + message);
+}
 
-    return return_val;
+void Parser::warning_at(ExprAST* expr, const std::string& message) {
+    diagnostics_.warning(file_name_ + " - " + std::to_string(expr->line()) + ':' + std::to_string(expr->col()) + ": " + message);
 }
 
+// Helper functions for Parser::parse().
 // warning, this function does not set current_scope correctly
 // if you use it remember to restore current_scope!
 ParserNextType Parser::back() {
@@ -109,40 +49,37 @@ ParserNextType Parser::back() {
         print_fatal("Trying to call Parser::back() when parser's index is 0");
 
     current_idx--;
-    bool skipped_newline = skip_whitespace_back();
-    return { old - current_idx, skipped_newline };
-    
+    return { old - current_idx, vec[old].starts_line() };
 }
 
 bool Parser::can_go_next() {
-    return current_idx < vec.size() - 1;
+    return vec[current_idx].val() != TOK_EOF;
 }
 
 ParserNextType Parser::next() {
     int cur_pos = current_idx;
-    if (current_idx == vec.size() - 1)
-        salt::print_fatal("current_idx reached vec size");
-
-    else if (vec[current_idx].val() == TOK_EOF)
+    if (vec[current_idx].val() == TOK_EOF)
         salt::print_fatal("trying to access token vector past EOF");
 
-    else if (current_idx > vec.size() - 1)
-        salt::print_fatal("current_idx EXCEEDED vec size");
-
     current_idx++;
-    bool new_line_skipped = skip_whitespace();
-    return { current_idx - cur_pos, new_line_skipped };
+
+    // The lexer already worked out the indentation, so the scope only changes when we reach a new line
+    const Token tok = vec[current_idx];
+    if (tok.starts_line())
+        current_scope = tok.indent();
+
+    return { current_idx - cur_pos, tok.starts_line() };
 }
 
-const Token& Parser::current() const { return vec[current_idx]; }
+const Token& Parser::current() { return vec[current_idx]; }
 
 Result<Expression> Parser::parse_number_expr() {
     bool negative = false;
 
     if (vec[current_idx].val() == TOK_SUB) {
+        // any other '-' became a UnaryExprAST in parse_expression()
         negative = true;
-        if (vec[current_idx + 1].val() != TOK_NUMBER)
-            return ParserException(vec[current_idx], "expected number after unary \"-\" (negating expressions NYI, please multiply by -1)");
+        ASSERT(vec[current_idx + 1].val() == TOK_NUMBER);
         this->next();
     }
 
@@ -197,44 +134,30 @@ Result<Expression> Parser::parse_number_expr() {
     int token_delta = this->next().delta;
     if (!error) {
         if (should_return_float)
-            return std::make_unique<ValExprAST>(vec[current_idx - 1], val_float, SALT_TYPE_DOUBLE);
+            return arena_.make<ValExprAST>(vec[current_idx - 1], val_float, SALT_TYPE_DOUBLE);
         else
-            return std::make_unique<ValExprAST>(vec[current_idx - 1], val_int, SALT_TYPE_LONG);
+            return arena_.make<ValExprAST>(vec[current_idx - 1], val_int, SALT_TYPE_LONG);
     }
 
-    print_error_at(vec[current_idx - token_delta], "invalid numeric literal");
+    error_at(vec[current_idx - token_delta], "invalid numeric literal");
 
     if (should_return_float)
-        return std::make_unique<ValExprAST>(vec[current_idx - 1], val_float, SALT_TYPE_DOUBLE);
+        return arena_.make<ValExprAST>(vec[current_idx - 1], val_float, SALT_TYPE_DOUBLE);
     else
-        return std::make_unique<ValExprAST>(vec[current_idx - 1], val_int, SALT_TYPE_LONG);
+        return arena_.make<ValExprAST>(vec[current_idx - 1], val_int, SALT_TYPE_LONG);
 }
 
 Result<Expression> Parser::parse_string_expr() {
     ASSERT(vec[current_idx].val() == TOK_STRING);
-    auto res = std::make_unique<ValExprAST>(vec[current_idx], vec[current_idx].data());
+    Expression res = arena_.make<ValExprAST>(vec[current_idx], vec[current_idx].interned());
     this->next();
-    return std::move(res);
-}
-
-// Note: NOT for function calls. This is for expressions such as 3 * (5 + 3), NOT func(1, 2).
-Result<Expression> Parser::parse_paren_expr() {
-    this->next(); // we must move forward from this left paren
-    Result<Expression> res = parse_expression();
-    if (vec[current_idx].val() != TOK_RIGHT_BRACKET)
-        // We expected parenthesis, we didnt get right parenthesis
-        return ParserException(vec[current_idx], "expected \")\"");
-    this->next(); // ok, move forward from this right paren as well
-    if (res)
-        return res.unwrap();
-    else
-        return res.unwrap_err();
+    return res;
 }
 
 /// @todo: add type here, dont assume "int" (but how?)
 // ans: add an UnknownType, and convert it implicitly to the correct type when generating the code
 Result<Expression> Parser::parse_ident_expr() {
-    std::string ident_name = vec[current_idx].data();
+    const Symbol ident_name = vec[current_idx].interned();
     if (!is_valid_identifier(ident_name.c_str()))
         return ParserException(vec[current_idx], "identifiers must start with a letter");
 
@@ -248,21 +171,21 @@ Result<Expression> Parser::parse_ident_expr() {
     if (vec[current_idx].val() != TOK_LEFT_BRACKET && vec[current_idx].val() != TOK_LEFT_SQUARE) {
 
         // Get the type of that identifier
-        TypeInstance ti = named_values[ident_name];
+        TypeInstance ti = named_values.lookup(ident_name);
         if (!ti) {
-            print_error_at(current(), f_string("variable %s does not exist", ident_name.c_str()));
+            error_at(current(), f_string("variable %s does not exist", ident_name.c_str()));
             ti = SALT_TYPE_ERROR;
         }
 
-        salt::dboutv << f_string("Making variable with name %s and type `%s`\n", vec[ident_idx].data(), named_values[ident_name].str().c_str());
-        return std::make_unique<VariableExprAST>(vec[ident_idx], ti);
+        salt::dboutv << f_string("Making variable with name %s and type `%s`\n", ident_name.c_str(), ti.str().c_str());
+        return arena_.make<VariableExprAST>(vec[ident_idx], ti);
     }
 
     // check if this identifier has [] brackets, if so we are indexing or dereferencing it
     // only type that has a reasonable [] operator is ptr type, except void*
     if (current().val() == TOK_LEFT_SQUARE) {
         TODO();
-        const Token& bracket_tok = current();
+        const Token bracket_tok = current();
         this->next();
         Result<Expression> index_res = parse_expression();
         Expression index_expr = nullptr;
@@ -276,17 +199,16 @@ Result<Expression> Parser::parse_ident_expr() {
         else
             return ParserException(current(), "expected ]");
 
-        std::unique_ptr<VariableExprAST> var_to_deref = nullptr;
+        VariableExprAST* var_to_deref = nullptr;
     }
     
 
     // this identifier is a function call. treat it like one.
-    std::vector<Expression> args;
-    TypeInstance call_return_type = named_functions[ident_name];
-    if (!call_return_type) {
-        print_error_at(vec[ident_idx], f_string("function %s does not exist", ident_name.c_str()));
-        call_return_type = SALT_TYPE_ERROR;
-    }
+    // The args go on top of expr_scratch_, above the args of any call we are already inside of
+    const size_t args_start = expr_scratch_.size();
+    // A function further down the file isn't known yet, Sema types the call (or says it doesn't exist) then
+    auto callee = named_functions.find(ident_name);
+    const TypeInstance call_return_type = callee != named_functions.end() ? callee->second->type_instance() : TypeInstance();
 
     // skip (
     this->next();
@@ -305,7 +227,7 @@ Result<Expression> Parser::parse_ident_expr() {
 
             Expression arg = arg_res.unwrap();
 
-            args.push_back(std::move(arg));
+            expr_scratch_.push_back(arg);
             
             // we should be at a comma, or a ')' now. because of parse_expression()
             // which already calls next() for us
@@ -320,33 +242,33 @@ Result<Expression> Parser::parse_ident_expr() {
     // we finally reached the end of the function call, current token is ). skip that.
     this->next();
 
-    return std::make_unique<CallExprAST>(vec[ident_idx], std::move(args), call_return_type);
+    return arena_.make<CallExprAST>(vec[ident_idx], arena_.take(expr_scratch_, args_start), call_return_type);
 }
 
 Result<Expression> Parser::parse_reserved_constant() {
     Expression res = nullptr;
-    const Token& cur = vec[current_idx];
+    const Token cur = vec[current_idx];
     switch (cur.val()) {
     case TOK_NULL:
-        res = std::make_unique<ValExprAST>(cur, int64_t(0), TypeInstance(SALT_TYPE_VOID, 1));
+        res = arena_.make<ValExprAST>(cur, int64_t(0), TypeInstance(SALT_TYPE_VOID, 1));
         break;
     case TOK_INF:
-        res = std::make_unique<ValExprAST>(cur, 1.0e300 * 1.0e300, SALT_TYPE_DOUBLE);
+        res = arena_.make<ValExprAST>(cur, 1.0e300 * 1.0e300, SALT_TYPE_DOUBLE);
         break;
     case TOK_NAN:
-        res = std::make_unique<ValExprAST>(cur, (1.0e300 * 1.0e300) - (1.0e300 * 1.0e300), SALT_TYPE_DOUBLE);
+        res = arena_.make<ValExprAST>(cur, (1.0e300 * 1.0e300) - (1.0e300 * 1.0e300), SALT_TYPE_DOUBLE);
         break;
     case TOK_TRUE:
-        res = std::make_unique<ValExprAST>(cur, int64_t(1), SALT_TYPE_BOOL);
+        res = arena_.make<ValExprAST>(cur, int64_t(1), SALT_TYPE_BOOL);
         break;
     case TOK_FALSE:
-        res = std::make_unique<ValExprAST>(cur, int64_t(0), SALT_TYPE_BOOL);
+        res = arena_.make<ValExprAST>(cur, int64_t(0), SALT_TYPE_BOOL);
         break;
     default:
         print_fatal(f_string("Expected reserved constant after call to Parser::parse_reserved_constant, found %s", vec[current_idx].str()));
     }
     this->next();
-    return std::move(res);
+    return res;
 }
 
 Result<Expression> Parser::parse_new_variable() {
@@ -361,29 +283,24 @@ Result<Expression> Parser::parse_new_variable() {
     if (current().val() != TOK_IDENT)
         return ParserException(current(), "expected identifier");
 
-    std::unique_ptr<VariableExprAST> new_variable = std::make_unique<VariableExprAST>(current(), ti);
+    VariableExprAST* new_variable = arena_.make<VariableExprAST>(current(), ti);
     this->next();
 
     // now we should be at a '='
     if (current().val() != TOK_ASSIGN)
         return ParserException(current(), "expected \"=\" after new variable");
 
-    const Token& assign_tok = current();
+    const Token assign_tok = current();
     this->next();
 
     // now we should be at an expression, which we will parse
     Result<Expression> rhs_res = parse_expression();
-    Expression rhs = nullptr;
-    if (rhs_res) {
-        rhs = rhs_res.unwrap();
-        if (!rhs->type() || rhs->type()->get() == SALT_TYPE_VOID->get())
-            return Exception(f_string("%s - %d:%d: bad value for assignment", salt::file_names[current_file_name_index].c_str(), rhs->line(), rhs->col()));
-    }
-    else
+    if (!rhs_res)
         return ParserException(current(), "expected expression");
+    Expression rhs = rhs_res.unwrap();
 
-    this->named_values[new_variable->name()] = ti;
-    return std::make_unique<NewVariableAST>(assign_tok, std::move(new_variable), std::move(rhs));
+    this->named_values.declare(new_variable->name(), ti);
+    return arena_.make<NewVariableAST>(assign_tok, new_variable, rhs);
 
 }
 
@@ -391,42 +308,49 @@ Result<Expression> Parser::parse_char() {
     if (current().val() != TOK_CHAR)
         return ParserException(current(), "expected a char");
 
-    const Token& ch = current();
+    const Token ch = current();
     this->next();
 
     if (ch.data().size() >= 2)
-        print_warning_at(ch, "multi-byte char, will be truncated to least significant byte");
+        warning_at(ch, "multi-byte char, will be truncated to least significant byte");
 
     char val = ch.data().back();
-    return std::make_unique<ValExprAST>(ch, int64_t(val), SALT_TYPE_CHAR);
+    return arena_.make<ValExprAST>(ch, int64_t(val), SALT_TYPE_CHAR);
 }
 
-Result<Expression> Parser::parse_neg_expr() {
-    const Token& minus_sign = current();
-    if (minus_sign.val() != TOK_SUB)
-        return ParserException(minus_sign, "expected -");
-
-    this->next();
-    Result<Expression> expr_res = parse_primary();
-    Expression expr = nullptr;
-    if (expr_res)
-        expr = expr_res.unwrap();
-    else
-        return expr_res.unwrap_err();
-
-    const salt::Type* type_of_minus_one = expr->type();
-    if (!type_of_minus_one->is_numeric())
-        return ParserException(minus_sign, f_string("cannot negate expression of type %s", expr->type_instance().str().c_str()).c_str());
+// Applies the prefix operator op to an operand we already have. Whether it makes sense for the
+// operand's type is up to Sema, the operand might not have one yet
+Result<Expression> Parser::make_unary(const Token& op, Expression operand) {
+    switch (op.val()) {
+    case TOK_MUL: // parse_expression() only gets here once the whole operand is there, so *p binds tighter than any binary operator
+        return arena_.make<DerefExprAST>(operand);
+    case TOK_SUB:
+    case TOK_TILDE:
+    case TOK_EXCLAMATION:
+    case TOK_NOT:
+        return arena_.make<UnaryExprAST>(op, operand);
+    default:
+        return ParserException(op, "expected an unary operator");
+    }
+}
 
-    std::unique_ptr<ValExprAST> minus_one = nullptr;
-    if (type_of_minus_one->is_float())
-        minus_one = std::make_unique<ValExprAST>(minus_sign, double(-1.0), type_of_minus_one);
-    else
-        minus_one = std::make_unique<ValExprAST>(minus_sign, int64_t(-1), type_of_minus_one);
+// Applies the operator on top of op_scratch_ to the operand(s) on top of expr_scratch_
+Result<void> Parser::reduce_top() {
+    const PendingOp top = op_scratch_.back();
+    op_scratch_.pop_back();
 
-    Token mul_token = Token(TOK_MUL, "", 0, minus_sign.line(), minus_sign.col());
+    if (top.fixity == Operator::PREFIX) {
+        Result<Expression> res = make_unary(top.tok, expr_scratch_.back());
+        if (!res)
+            return res.unwrap_err();
+        expr_scratch_.back() = res.unwrap();
+        return Result_e::OK;
+    }
 
-    return std::make_unique<BinaryExprAST>(mul_token, std::move(minus_one), std::move(expr));
+    Expression rhs = expr_scratch_.back();
+    expr_scratch_.pop_back();
+    expr_scratch_.back() = arena_.make<BinaryExprAST>(top.tok, expr_scratch_.back(), rhs);
+    return Result_e::OK;
 }
 
 Result<Expression> Parser::parse_primary() {
@@ -437,15 +361,12 @@ Result<Expression> Parser::parse_primary() {
     case TOK_IDENT:
         return parse_ident_expr();
     case TOK_NUMBER:
+    case TOK_SUB: // parse_expression() only sends us a '-' if it's part of a negative number
         return parse_number_expr();
-    case TOK_SUB:
-        return parse_neg_expr();
     case TOK_CHAR: // not the char type, but a char like 'A'
         return parse_char();
     case TOK_STRING:
         return parse_string_expr();
-    case TOK_LEFT_BRACKET:
-        return parse_paren_expr();
     case TOK_IF:
         return parse_if_expr();
     case TOK_WHILE:
@@ -456,8 +377,6 @@ Result<Expression> Parser::parse_primary() {
     case TOK_TRUE:
     case TOK_FALSE:
         return parse_reserved_constant();
-    case TOK_MUL:
-        return parse_deref();
     case TOK_RETURN:
         return parse_return();
     case TOK_TYPE:
@@ -468,106 +387,130 @@ Result<Expression> Parser::parse_primary() {
     }
 }
 
+// Expressions are parsed without recursing into their parts (shunting-yard). Operands wait on expr_scratch_,
+// and operators and "(" wait on op_scratch_ until whatever binds tighter than them is done. So x + x + ... + x
+// or ((((x)))) can be as long as they like without using up the stack.
+// Only calls and "if" still call parse_expression() for their parts.
 Result<Expression> Parser::parse_expression() {
-    // if (Result<Expression> ret_res = parse_return())
-    //    return ret_res.unwrap();
-
-    if (Result<Expression> lhs_res = parse_primary()) {
-        // We parsed a primary expression, and we are currently at what might be a binary op
-        // If the binary op is on the same line as the expression, then create a binary expr
-        // Otherwise, if we had to go to a new line to reach this binary op, just return the lhs
-        int old_pos = current_idx;
-        ParserNextType pnt = this->back();
-        current_idx = old_pos;
-        if (pnt.new_statement) 
-            return lhs_res.unwrap();
-
-        return parse_binop_rhs(0, std::move(lhs_res.unwrap()));
-    }
-    else
-        return lhs_res.unwrap_err();
-}
+    const size_t operands_start = expr_scratch_.size();
+    const size_t ops_start = op_scratch_.size();
+    size_t open_parens = 0;
+
+    // Forget whatever we had, so the scratch vectors are just like we found them
+    auto fail = [&](const Error& err) -> Result<Expression> {
+        expr_scratch_.resize(operands_start);
+        op_scratch_.resize(ops_start);
+        return err;
+    };
+
+    // Prefix operators bind tighter than anything else, so they are applied as soon as their operand is complete
+    auto apply_prefixes = [&]() -> Result<void> {
+        while (op_scratch_.size() > ops_start && op_scratch_.back().fixity == Operator::PREFIX)
+            if (Result<void> res = reduce_top(); !res)
+                return res;
+        return Result_e::OK;
+    };
 
-Result<Expression> Parser::parse_binop_rhs(int prec, Expression lhs) {
     while (true) {
-        // We are currently at what we presume to be a binary op
-        // Therefore, get its precedence.
-        const Token& op = vec[current_idx];
-        int tok_prec = BinaryOperator::get_precedence(op.val());
-
-        // We passed in 0 from the start. If 0 is higher than tok_prec
-        // it means this token has -1 precedence, it's not a binop. So just return lhs
-        // More generally, if "op" has lower precedence than what we passed in to the function
-        // then our calculation (of the LHS of op) is done.
-        if (tok_prec < prec)
-            return lhs;
-
-        // Ok, op is a binary operator and it binds more tightly than whatever we passed in.
-        // Directly following op we expect a primary expression. Therefore, jump to it.
-        this->next();
+        // We are at the start of an operand, which may begin with any number of prefix operators and "("
+        const Token tok = current();
+        if (tok.val() == TOK_LEFT_BRACKET) {
+            op_scratch_.push_back({ tok, Operator::NOT_AN_OPERATOR });
+            open_parens++;
+            this->next();
+            continue;
+        }
+
+        // -5 is just a negative literal, no need to negate anything
+        if (Operator::is_prefix(tok.val()) && !(tok.val() == TOK_SUB && vec[current_idx + 1].val() == TOK_NUMBER)) {
+            op_scratch_.push_back({ tok, Operator::PREFIX });
+            this->next();
+            continue;
+        }
+
+        Result<Expression> operand_res = parse_primary();
+        if (!operand_res)
+            return fail(operand_res.unwrap_err());
+        expr_scratch_.push_back(operand_res.unwrap());
+        if (Result<void> res = apply_prefixes(); !res)
+            return fail(res.unwrap_err());
+
+        // Now we have an operand. It may be followed by any number of ")" and "as <type>",
+        // and then either a binary operator (so another operand follows) or the end of the expression.
+        bool done = false;
+        while (true) {
+            const Token op = current();
+
+            // If we had to go to a new line to reach the next token, the expression is over
+            if (op.starts_line()) {
+                done = true;
+                break;
+            }
 
-        // We evaluate the (primary) expression on the rhs of op. For example, if the expression is 1 + 2 * 3
-        // then lhs is 1, op is '+' and rhs is (currently) 2.
+            if (op.val() == TOK_RIGHT_BRACKET && open_parens > 0) {
+                while (op_scratch_.back().fixity != Operator::NOT_AN_OPERATOR)
+                    if (Result<void> res = reduce_top(); !res)
+                        return fail(res.unwrap_err());
+                op_scratch_.pop_back();
+                open_parens--;
+                this->next();
+                if (Result<void> res = apply_prefixes(); !res)
+                    return fail(res.unwrap_err());
+                continue;
+            }
 
-        // Note that a type (like "int") is allowed here, if "op" is TOK_AS.
-        if (op.val() == TOK_AS) {
-            if (vec[current_idx].val() == TOK_TYPE) {
-                Expression ty = std::make_unique<TypeExprAST>(vec[current_idx]);
+            // "as" binds tighter than every other binary operator, so it can be applied right away
+            if (op.val() == TOK_AS) {
+                this->next();
+                if (current().val() != TOK_TYPE)
+                    return fail(ParserException(current(), "expected a type after \"as\" keyword"));
+                Expression ty = arena_.make<TypeExprAST>(current());
                 this->next();
-                Expression res = std::make_unique<BinaryExprAST>(op, std::move(lhs), std::move(ty));
-                return parse_binop_rhs(BinaryOperator::get_precedence(TOK_AS), std::move(res));
-                // return std::make_unique<BinaryExprAST>(op, std::move(lhs), std::move(ty));
+                expr_scratch_.back() = arena_.make<BinaryExprAST>(op, expr_scratch_.back(), ty);
+                continue;
             }
-            else
-                return ParserException(vec[current_idx], "expected a type after \"as\" keyword");
-        }
 
-        Result<Expression> rhs_res = parse_primary(); 
+            if (!Operator::is_infix(op.val())) {
+                done = true;
+                break;
+            }
 
-        // If parsing the primary expression fails, we return the error contained within.
-        if (!rhs_res)
-            return rhs_res.unwrap_err();
+            // Everything waiting that binds tighter than op is its lhs, and so is an equal one unless op is right associative:
+            // a - b - c is (a - b) - c, but a = b = c is a = (b = c)
+            const int prec = Operator::get_precedence(op.val());
+            const bool right_assoc = Operator::is_right_assoc(op.val());
+            while (op_scratch_.size() > ops_start && op_scratch_.back().fixity == Operator::INFIX) {
+                const int top_prec = Operator::get_precedence(op_scratch_.back().tok.val());
+                if (top_prec < prec || (top_prec == prec && right_assoc))
+                    break;
+                if (Result<void> res = reduce_top(); !res)
+                    return fail(res.unwrap_err());
+            }
 
-        Expression rhs = rhs_res.unwrap();
-    
-        // parse_primary() calls this->next(). So we are currently at what we assume to be another binop.
-        // But we must check if there was a newline between this new binop and the primary we just parsed. 
-        // In that case, we are done.
-        int old_idx = current_idx;
-        bool there_was_newline = this->back().new_statement;
-        current_idx = old_idx;
-
-        if (there_was_newline)
-            return std::make_unique<BinaryExprAST>(op, std::move(lhs), std::move(rhs));
-
-        // Now we check to see if the next token binds more tightly than op. If so, we need to calculate that first.
-        // In our 1 + 2 * 3 example, the RHS of op (2), should be calculated using the *, not with the +.
-        Token_e next_token = vec[current_idx].val();
-        int next_prec = BinaryOperator::get_precedence(next_token);
-
-        // If next_prec binds more tightly (which it does in this case), then we need to calculate rhs first.
-        if (tok_prec < next_prec) {
-            Result<Expression> next_rhs_res = parse_binop_rhs(tok_prec, std::move(rhs));
-            // If parsing this new rhs fails, then we return the error contained within.
-            if (!next_rhs_res)
-                return next_rhs_res.unwrap_err();
-
-
-            // This calculation will recursively occur until a "weaker" token is found.
-            rhs = next_rhs_res.unwrap();
+            op_scratch_.push_back({ op, Operator::INFIX });
+            this->next();
+            break;
         }
-    
-        // And after we have found what our rhs must finally be, we create the binary expression.
 
-        lhs = std::make_unique<BinaryExprAST>(op, std::move(lhs), std::move(rhs));
+        if (done)
+            break;
+    }
 
-        // And the loop repeats.
+    while (op_scratch_.size() > ops_start) {
+        if (op_scratch_.back().fixity == Operator::NOT_AN_OPERATOR)
+            return fail(ParserException(current(), "expected \")\""));
+        if (Result<void> res = reduce_top(); !res)
+            return fail(res.unwrap_err());
     }
+
+    Expression res = expr_scratch_.back();
+    expr_scratch_.resize(operands_start);
+    return res;
 }
 
 Result<Expression> Parser::parse_if_expr() {
     // Assume we're at the keyword "if"
-    const Token& if_token = current();
+    const Token if_token = current();
 
     if (vec[current_idx].val() != TOK_IF)
         return ParserException(vec[current_idx], "expected keyword \"if\"");
@@ -604,22 +547,22 @@ Result<Expression> Parser::parse_if_expr() {
     // We've reached the end with no errors
     // Return a new if expression with cond, true_expr and false_expr.
 
-    return std::make_unique<IfExprAST>(if_token, cond_res.unwrap(), true_expr_res.unwrap(), false_expr_res.unwrap());
+    return arena_.make<IfExprAST>(if_token, cond_res.unwrap(), true_expr_res.unwrap(), false_expr_res.unwrap());
 
 }
 
 
-Result<std::unique_ptr<DeclarationAST>> Parser::parse_declaration() {
-    named_values.clear();
+// The args are declared in the current scope, so callers that parse a body after this should enter a scope for the function first
+Result<DeclarationAST*> Parser::parse_declaration() {
     // We assume that the current token is TOK_FN
     if (vec[current_idx].val() != TOK_FN)
         return ParserException(vec[current_idx], "expected keyword \"fn\"");
     this->next();
 
-    // We could also take the index of the function and use that in std::make_unique at the end
+    // We could also take the index of the function and use that in arena_.make at the end
     // but since we are using the token for other things we just make a reference to it
-    const Token& function_identifier_token = vec[current_idx];
-    const std::string& function_name = function_identifier_token.data();
+    const Token function_identifier_token = vec[current_idx];
+    const Symbol function_name = function_identifier_token.interned();
     if (!is_valid_identifier(function_name.c_str()))
         return ParserException(vec[current_idx], "identifiers must start with a letter");
     
@@ -631,17 +574,17 @@ Result<std::unique_ptr<DeclarationAST>> Parser::parse_declaration() {
 
     // create an arg vector and populate it, just like we did with the function call
     // declaration in parse_ident_expr()
-    std::vector<std::unique_ptr<VariableExprAST>> args;
+    const size_t args_start = arg_scratch_.size();
 
     this->next(); // now we are either at the first argument or at a ')'
     if (vec[current_idx].val() != TOK_RIGHT_BRACKET)
         while (1) {            
             // current argument
 
-            const Token& tok = vec[current_idx];
+            const Token tok = vec[current_idx];
             if (tok.val() != TOK_TYPE)
                 return ParserException(vec[current_idx], "expected type");
-            const salt::Type* type = salt::all_types[tok.data()];
+            const salt::Type* type = salt::all_types[std::string(tok.data())];
             int ptr_layers = tok.count();
 
             if (!type)
@@ -649,21 +592,21 @@ Result<std::unique_ptr<DeclarationAST>> Parser::parse_declaration() {
             this->next(); // go to the name of the argument
 
 
-            const std::string& arg_name = vec[current_idx].data();
+            const Symbol arg_name = vec[current_idx].interned();
             salt::dbout << f_string("arg_name : %s\n", arg_name.c_str());
 
             /// @todo: add more types!!!
             
-            std::unique_ptr<VariableExprAST> arg = nullptr;
+            VariableExprAST* arg = nullptr;
             if (!ptr_layers) {
-                arg = std::make_unique<VariableExprAST>(vec[current_idx], type);
-                named_values.insert({ vec[current_idx].data(), type });
+                arg = arena_.make<VariableExprAST>(vec[current_idx], type);
+                named_values.declare(arg_name, type);
             } else {
-                arg = std::make_unique<VariableExprAST>(vec[current_idx], TypeInstance(type, ptr_layers));
-                named_values.insert({ vec[current_idx].data(), TypeInstance(type, ptr_layers) });
+                arg = arena_.make<VariableExprAST>(vec[current_idx], TypeInstance(type, ptr_layers));
+                named_values.declare(arg_name, TypeInstance(type, ptr_layers));
             }
 
-            args.push_back(std::move(arg));
+            arg_scratch_.push_back(arg);
             this->next(); // we should be at a comma, or a ')' now
             if (vec[current_idx].val() == TOK_COMMA)
                 this->next();
@@ -685,7 +628,7 @@ Result<std::unique_ptr<DeclarationAST>> Parser::parse_declaration() {
 
     if (vec[current_idx].val() == TOK_ARROW) {
         this->next();
-        std::string& type_name = vec[current_idx].data();
+        const std::string type_name(vec[current_idx].data());
         
         if (type_name.empty() || !is_type(type_name))
             return ParserException(vec[current_idx], "expected type name after -> symbol");
@@ -708,8 +651,9 @@ Result<std::unique_ptr<DeclarationAST>> Parser::parse_declaration() {
     // if (named_functions[function_name])
     //    return Exception (f_string("%d:%d: function %s already exists", function_identifier_token.line(), function_identifier_token.col(), function_name.c_str()).c_str());
     
-    named_functions[function_name] = return_type;
-    return std::make_unique<DeclarationAST>(function_identifier_token, std::move(args), return_type);
+    DeclarationAST* decl = arena_.make<DeclarationAST>(function_identifier_token, arena_.take(arg_scratch_, args_start), return_type);
+    named_functions[function_name] = decl;
+    return decl;
 
 }
 
@@ -722,45 +666,45 @@ Result<Expression> Parser::parse_return() {
     this->next();
 
     int old_position = current_idx;
+    const size_t old_scratch_size = expr_scratch_.size();
 
     Result<Expression> res = parse_expression();
     if (res.is_ok()) {
-        return std::make_unique<ReturnAST>(vec[cur], std::move(res.unwrap()));
+        return arena_.make<ReturnAST>(vec[cur], res.unwrap());
     }
     else { // clearly, the user meant to return void, since an expression was not found!
         this->current_idx = old_position;
-        return std::make_unique<ReturnAST>(vec[cur], std::make_unique<ValExprAST>(vec[cur], int64_t(0), SALT_TYPE_VOID));
+        expr_scratch_.resize(old_scratch_size); // forget any half parsed call args
+        return arena_.make<ReturnAST>(vec[cur], arena_.make<ValExprAST>(vec[cur], int64_t(0), SALT_TYPE_VOID));
     }
 }
 
-Result<Expression> Parser::parse_deref() {
-    if (current().val() != TOK_MUL)
-        return ParserException(current(), "expected '*'");
-
-    this->next();
-    Result<Expression> ptr = parse_primary(); // parse primary since '*' is an unary operator. so it must bind more tightly than any binary operator
-    if (ptr)
-        return std::make_unique<DerefExprAST>(ptr.unwrap());
-    else
-        return ptr.unwrap_err();
-}
-
 /// @todo: to check if a function always returns a value, you can remember this
 // a function will return a value iff the last statement is a return, or a conditional that is fully saturated with returns
-Result<std::unique_ptr<FunctionAST>> Parser::parse_function() {
-    // assume that the current token is TOK_FN
+Result<FunctionAST*> Parser::parse_function() {
+    // assume that the current token is TOK_FN, or TOK_CONST for a const fn
+    const bool is_const = current().val() == TOK_CONST;
+    if (is_const) {
+        this->next();
+        if (current().val() != TOK_FN)
+            return ParserException(current(), "expected keyword \"fn\" after \"const\"");
+    }
+
+    // The args and locals of this function are gone once we return, however we return
+    SymbolTable<TypeInstance>::Scope function_scope(named_values);
     auto decl_res = parse_declaration(); // consumes that token
     if (!decl_res)
         return decl_res.unwrap_err();
 
-    std::unique_ptr<DeclarationAST> decl = decl_res.unwrap();
+    DeclarationAST* decl = decl_res.unwrap();
+    decl->set_const(is_const);
 
     // Check the return type, if none is specified then it's implicitly void, otherwise we want an arrow and a type
     if (vec[current_idx].val() != TOK_COLON)
         return ParserException(vec[current_idx], "expected \":\" after non-extern function declaration");
     
     int token_delta = this->next().delta; // move fd from ':'. if the function creation fails then go back this many steps
-    std::vector<Expression> ret_vec;
+    const size_t body_start = expr_scratch_.size();
     bool already_parsed_return = false;
 
     while (this->current_scope == 1) {
@@ -774,18 +718,18 @@ Result<std::unique_ptr<FunctionAST>> Parser::parse_function() {
         Expression body = body_res.unwrap();
 
         if (already_parsed_return)
-            print_warning_at(body.get(), "code after a return will be ignored");
+            warning_at(body, "code after a return will be ignored");
         else
-            ret_vec.push_back(std::move(body));
+            expr_scratch_.push_back(body);
 
-        if (ReturnAST* parsed_ret = ret_vec.back()->to_return()) 
+        if (llvm::isa<ReturnAST>(expr_scratch_.back()))
             already_parsed_return = true;
 
     }
 
     // here we check if the function contains bad variables (like variables of type void)
     bool has_bad_args = false;
-    for (const std::unique_ptr<VariableExprAST>& var : decl->args())
+    for (const VariableExprAST* var : decl->args())
         if (var->type() == SALT_TYPE_VOID) {
             has_bad_args = true;
             break;
@@ -793,19 +737,21 @@ Result<std::unique_ptr<FunctionAST>> Parser::parse_function() {
 
     if (has_bad_args) {
         named_functions.erase(decl->name());
-        return Exception(f_string("Function %s contains variable(s) of void type", decl->name()));
+        return ParserException(decl->line(), decl->col(), f_string("Function %s contains variable(s) of void type", decl->name().c_str()), ErrorCode::TYPE);
     }
 
-    return std::make_unique<FunctionAST>(std::move(decl), std::move(ret_vec));
+    return arena_.make<FunctionAST>(decl, arena_.take(expr_scratch_, body_start));
 }
 
-Result<std::unique_ptr<DeclarationAST>> Parser::parse_extern() {
+Result<DeclarationAST*> Parser::parse_extern() {
     // assume the current token is TOK_EXTERN
     this->next();
     if (vec[current_idx].val() != TOK_FN)
         return ParserException(vec[current_idx], "expected keyword \"fn\" after \"extern\" keyword");
     
     // no this->next() here, bcs parse_declaration() consumes that token
+    // and the args only exist while we parse the declaration
+    SymbolTable<TypeInstance>::Scope function_scope(named_values);
     return parse_declaration();
 }
 
@@ -813,15 +759,15 @@ Result<std::unique_ptr<DeclarationAST>> Parser::parse_extern() {
 // must be removed later when we start compiling programs.
 // Works by creating an anonymous function without params
 // that capture the top level expression.
-Result<std::unique_ptr<FunctionAST>> Parser::parse_top_level_expr() {
+Result<FunctionAST*> Parser::parse_top_level_expr() {
     Result<Expression> expr_res = parse_expression();
     if (!expr_res)
         return expr_res.unwrap_err();
 
     Expression expr = expr_res.unwrap();
-    auto decl = std::make_unique<DeclarationAST>(Token(TOK_NONE), std::vector<std::unique_ptr<VariableExprAST>>());
+    auto decl = arena_.make<DeclarationAST>(Token(TOK_NONE), AstList<VariableExprAST*>());
     print_fatal(f_string("%d:%d: Tried to parse top-level expression, this is unsupported", vec[current_idx].line(), vec[current_idx].col()));
-    return Exception("very very very bad logic error");
+    return Error("very very very bad logic error", ErrorCode::INTERNAL);
 }
 
 Result<Expression> Parser::parse_while_expr() {
@@ -831,21 +777,21 @@ Result<Expression> Parser::parse_while_expr() {
     if (vec[current_idx].val() != TOK_WHILE)
         return ParserException(vec[current_idx], "expected while keyword");
 
-    const Token& while_token = current();
+    const Token while_token = current();
     this->next();
 
 
     int index_before_parse = current_idx;
     Expression cond = nullptr;
-    ParserException fail_ret_value = ParserException(vec[index_before_parse], "Uninitialized parser exception");
+    Error fail_ret_value = ParserException(vec[index_before_parse], "Uninitialized parser exception");
 
     Result expr_res = parse_expression();
     if (expr_res)
         cond = expr_res.unwrap();
     else {
         any_compile_error_occured = true;
-        fail_ret_value = ParserException(vec[index_before_parse], expr_res.unwrap_err().what());
-        cond = std::make_unique<ValExprAST>(while_token, int64_t(0), SALT_TYPE_LONG);
+        fail_ret_value = expr_res.unwrap_err();
+        cond = arena_.make<ValExprAST>(while_token, int64_t(0), SALT_TYPE_LONG);
     }
 
 
@@ -860,7 +806,7 @@ Result<Expression> Parser::parse_while_expr() {
         if (expr_res) {
             if (Result repeat_body_res = parse_expression()) {
                 Expression repeat_body = repeat_body_res.unwrap();
-                return std::make_unique<WhileAST>(
+                return arena_.make<WhileAST>(
                     rep_line, rep_col, std::move(success_ret_value), std::move(repeat_body)
                 );
             }
@@ -881,14 +827,11 @@ Result<Expression> Parser::parse_while_expr() {
 }
 
 Result<void> Parser::handle_extern() {
-    if (Result<std::unique_ptr<DeclarationAST>> decl_res = parse_extern()) {
+    if (Result<DeclarationAST*> decl_res = parse_extern()) {
         is_suffering_from_syntax_error = false;
-        std::unique_ptr<DeclarationAST> decl = decl_res.unwrap();
-        llvm::Function* generated_ir = decl->code_gen();
-        salt::dbout << "Successfully parsed declaration ";
-        if (salt::dbout.is_active())
-            generated_ir->print(llvm::errs());
-        salt::dbout << " at: "
+        DeclarationAST* decl = decl_res.unwrap();
+        unit_.declarations.push_back(decl);
+        salt::dbout << "Successfully parsed declaration " << decl->name() << " at: "
             << decl->line()
             << ':'
             << decl->col()
@@ -903,14 +846,11 @@ Result<void> Parser::handle_extern() {
 }
 
 Result<void> Parser::handle_top_level_expr() {
-    if (Result<std::unique_ptr<FunctionAST>> fn_res = parse_top_level_expr()) {
+    if (Result<FunctionAST*> fn_res = parse_top_level_expr()) {
         is_suffering_from_syntax_error = false;
-        std::unique_ptr<FunctionAST> func = fn_res.unwrap();
-        llvm::Function* generated_ir = func->code_gen();
-        salt::dbout << "Successfully parsed top level expression ";
-        if (salt::dbout.is_active())
-            generated_ir->print(llvm::errs());
-        salt::dbout << " at: "
+        FunctionAST* func = fn_res.unwrap();
+        unit_.functions.push_back(func);
+        salt::dbout << "Successfully parsed top level expression at: "
             << func->decl()->line()
             << ':'
             << func->decl()->col()
@@ -924,14 +864,11 @@ Result<void> Parser::handle_top_level_expr() {
 }
 
 Result<void> Parser::handle_function() {
-    if (Result<std::unique_ptr<FunctionAST>> fn_res = parse_function()) {
+    if (Result<FunctionAST*> fn_res = parse_function()) {
         is_suffering_from_syntax_error = false;
-        std::unique_ptr<FunctionAST> func = fn_res.unwrap();
-        llvm::Function* generated_ir = func->code_gen();
-        salt::dbout << "Successfully parsed function ";
-        if (salt::dbout.is_active())
-            generated_ir->print(llvm::errs());
-        salt::dbout << " at: "
+        FunctionAST* func = fn_res.unwrap();
+        unit_.functions.push_back(func);
+        salt::dbout << "Successfully parsed function " << func->decl()->name() << " at: "
             << func->decl()->line()
             << ':'
             << func->decl()->col()
@@ -947,29 +884,116 @@ Result<void> Parser::handle_function() {
 
 }
 
+// handle_function(), but also remembers the function's FunctionRange, and takes its AST
+// from the older version of the file if it's in there
+Result<void> Parser::handle_tracked_function() {
+    const size_t first = current_idx;
+    const size_t end = function_end(first);
+    FunctionRange range = { first, end, current().line(), hash_range(first, end), 0, nullptr };
+
+    auto old = reusable_.find(range.hash);
+    if (old != reusable_.end()) {
+        range.fn = old->second->fn;
+        range.ast_bytes = old->second->ast_bytes;
+        if (range.line != old->second->line)
+            range.fn->shift_lines(range.line - old->second->line);
+        reusable_.erase(old); // the same function twice would share one AST otherwise
+        named_functions[range.fn->decl()->name()] = range.fn->decl();   // like parse_declaration() would have
+
+        unit_.functions.push_back(range.fn);
+        function_ranges_.push_back(range);
+        reused_count_++;
+        is_suffering_from_syntax_error = false;
+
+        // Straight to the end, next() would only have changed the scope on the way there
+        current_idx = static_cast<int>(end);
+        if (current().starts_line())
+            current_scope = current().indent();
+        return Result_e::OK;
+    }
+
+    const int diagnostics_before = diagnostics_.error_count() + diagnostics_.warning_count();
+    const size_t bytes_before = arena_.bytes_allocated();
+    Result<void> res = handle_function();
+
+    // Only keep functions that ended where we expected, and didn't have anything to say about them,
+    // those errors and warnings would be gone next time
+    if (res && static_cast<size_t>(current_idx) == end && diagnostics_.error_count() + diagnostics_.warning_count() == diagnostics_before) {
+        range.fn = unit_.functions.back();
+        range.ast_bytes = arena_.bytes_allocated() - bytes_before;
+    }
+    function_ranges_.push_back(range);
+    return res;
+}
+
+// Where the function starting at first ends: the next line that isn't indented, or EOF
+size_t Parser::function_end(size_t first) {
+    size_t idx = first + 1;
+    while (true) {
+        const Token tok = vec[idx];
+        if (tok.val() == TOK_EOF || (tok.starts_line() && tok.indent() == 0))
+            return idx;
+        idx++;
+    }
+}
+
+// Hashes the text of the tokens in [first, end), including the comments and whitespace between them,
+// but not where they are in the file
+uint64_t Parser::hash_range(size_t first, size_t end) {
+    const Token first_tok = vec[first];
+    const Token last_tok = vec[end - 1];
+    const int col = first_tok.col();
+    const std::string_view text = SourceManager::get()->text(first_tok.offset(), last_tok.offset() + last_tok.length() - first_tok.offset());
+    return salt::hash_bytes(text.data(), text.size(), salt::hash_bytes(&col, sizeof(col)));
+}
+
+static void push_type(std::vector<uint64_t>& fields, const TypeInstance& ti) {
+    fields.push_back(reinterpret_cast<uintptr_t>(ti.type));
+    fields.push_back(reinterpret_cast<uintptr_t>(ti.pointee));
+    fields.push_back(static_cast<uint64_t>(ti.ptr_layers));
+}
+
+// Adds up a hash of every function's name, constness, return type and argument types,
+// so the order they are in doesn't matter
+uint64_t Parser::hash_signatures() const {
+    uint64_t res = 0;
+    std::vector<uint64_t> fields;
+    for (const auto& [name, decl] : named_functions) {
+        fields = { name.id(), static_cast<uint64_t>(decl->is_const()) };
+        push_type(fields, decl->type_instance());
+        for (VariableExprAST* arg : decl->args())
+            push_type(fields, arg->type_instance());
+        res += salt::hash_bytes(fields.data(), fields.size() * sizeof(uint64_t));
+    }
+    return res;
+}
 
 ParserReturnType Parser::parse() {
+    // The whole file is parsed before any code is generated (see code_gen()), so the AST of every
+    // function stays in the arena
     // for (int i = 0; i < 1; i++)
     try {
         Result<void> res;
         while (1) {
-            if (current_idx >= vec.size())
-                return;
+            // Nothing before a top level item is needed anymore
+            vec.release_before(current_idx);
+            expr_scratch_.clear();
+            arg_scratch_.clear();
+            op_scratch_.clear();
             Token_e val = vec[current_idx].val();
 
             switch (val) {
             case TOK_EOF:
+                // Only now is every signature known
+                if (track_functions_)
+                    signatures_hash_ = hash_signatures();
                 return;
-            case TOK_EOL:
-            case TOK_WHITESPACE:
-            case TOK_TAB:
-                this->next();
-                break;
             case TOK_EXTERN:
                 res = handle_extern();
                 break;
             case TOK_FN:
-                res = handle_function();
+            case TOK_CONST:
+                res = track_functions_ ? handle_tracked_function() : handle_function();
                 break;
             /*
             case TOK_NUMBER:
@@ -986,39 +1010,70 @@ ParserReturnType Parser::parse() {
 
             if (!res && !is_suffering_from_syntax_error) {
                 is_suffering_from_syntax_error = true;
-                print_error(res.unwrap_err().what());
+                diagnostics_.error(res.unwrap_err().str(file_name_));
             }
         }
     }
 
-    catch (const ParserException& e) {
-        std::cerr << e.what() << std::endl;
-        if (can_go_next())
-            this->next();
+    catch (const salt::Exception& e) {
+        diagnostics_.error(std::string("Exception: ") + e.what());
     }
+}
 
-    catch (const salt::Exception& e) {
-        std::cerr << "Exception: " << e.what() << std::endl;
+
+std::vector<DeclarationAST*> Parser::parse_declarations() {
+    std::vector<DeclarationAST*> decls;
+
+    while (current().val() != TOK_EOF) {
+        vec.release_before(current_idx);
+        if (current().val() != TOK_EXTERN) {
+            diagnostics_.error(ParserException(current(), "expected an extern declaration").str(file_name_));
+            this->next();
+            continue;
+        }
+
+        if (Result<DeclarationAST*> decl_res = parse_extern()) {
+            // these outlive the SourceManager that has our file, so their nodes can't look up where they are later
+            DeclarationAST* decl = decl_res.unwrap();
+            for (VariableExprAST* arg : decl->args())
+                arg->resolve_location();
+            decls.push_back(decl);
+        } else {
+            diagnostics_.error(decl_res.unwrap_err().str(file_name_));
+            if (can_go_next())
+                this->next();
+        }
     }
+
+    return decls;
+}
+
+void Parser::declare(const std::vector<DeclarationAST*>& decls) {
+    for (DeclarationAST* decl : decls)
+        named_functions[decl->name()] = decl;
+}
+
+void Parser::track_functions() {
+    track_functions_ = true;
+}
+
+void Parser::reuse(const std::vector<FunctionRange>& previous) {
+    track_functions_ = true;
+    reusable_.clear();
+    for (const FunctionRange& range : previous)
+        if (range.fn)
+            reusable_.emplace(range.hash, &range);
 }
 
 
-ParserException::ParserException(const Token& tok, const char* str) :
-    Exception(
-        salt::file_names[salt::current_file_name_index]
-        + " - "
-        + (std::to_string(tok.line())
-        + ':'
-        + std::to_string(tok.col())
-        + ": found token "
-        + tok.str()
-        + "[\""
-        + (tok.has_data() ? tok.data() : "")
-        + "\", "
-        + std::to_string(tok.count())
-        + "], "
-        + str
-        )) {}
+ParserException::ParserException(const Token& tok, const char* str, ErrorCode code) :
+    Error(str, code, tok.line(), tok.col()) {}
 
+ParserException::ParserException(const Token& tok, const std::string& str, ErrorCode code) :
+    ParserException(tok.line(), tok.col(), str, code) {}
 
+ParserException::ParserException(ExprAST* expr, const char* str, ErrorCode code) :
+    Error(str, code, expr->line(), expr->col()) {}
 
+ParserException::ParserException(int line, int col, const std::string& str, ErrorCode code) :
+    Error(str, code, line, col) {}
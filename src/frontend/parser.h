@@ -4,82 +4,155 @@
 #include "tokens.h"
 #include "../common.h"
 #include "irgenerator.h"
+#include "tokenstream.h"
+#include "diagnostics.h"
+#include "symboltable.h"
 #include <vector>
 
 // typedef void ParserReturnType (temporaily for parse() function)
 typedef void ParserReturnType;
 
-// return difference between current_idx and old current_idx, and also true/false for if a newline was encountered
+// return difference between current_idx and old current_idx, and also true/false for if the token we moved from/to starts a new line
 struct ParserNextType {
     int delta;
     bool new_statement;
 };
 
+// A top level fn and the tokens it was parsed from. Parser::reuse() takes these from an older version
+// of the same file, so it doesn't have to parse the functions that didn't change again.
+struct FunctionRange {
+    size_t first_token;     // the "fn"
+    size_t end_token;       // one past its last token
+    int line;               // of the "fn", which is also where its AST thinks it is
+    uint64_t hash;          // of its text, which doesn't change when the function is moved around
+    size_t ast_bytes;       // how much of the arena its AST takes up
+    FunctionAST* fn;        // nullptr if it can't be reused, because it didn't parse or came with warnings
+};
+
+// Parses one translation unit. Every Parser owns its tokens and symbol maps, and sends its
+// errors to the DiagnosticSink it was given, so it doesn't share anything with other Parsers.
 class Parser {
 private:
     int current_idx;
     int current_scope;
-    bool line_just_started;
     bool is_suffering_from_syntax_error;
-    static Parser* instance; // Singleton just like Lexer.
-    const std::vector<Token>& vec;
-    const Token& current() const;
-    /// @todo:
-    // there should be a vector of scopes, scopes[0] will be named_values in global scope, scopes[1] will be named_values in scope 1 etc, and current scope will be scopes.back()
-
-    std::unordered_map<std::string, TypeInstance> named_values;
-    std::unordered_map<std::string, TypeInstance> named_functions; /// @todo: include expected args also
-    std::unordered_map<std::string, llvm::Constant*> named_strings;
+    std::string file_name_;
+    DiagnosticSink& diagnostics_;
+    AstArena& arena_;
+    TokenStream vec;
+    const Token& current();
+
+    // Types of the variables we can see from here. Every function gets its own scope on top of the global one
+    SymbolTable<TypeInstance> named_values;
+    std::unordered_map<Symbol, DeclarationAST*> named_functions;
+    std::unordered_map<Symbol, llvm::Constant*> named_strings;
     bool is_parsing_extern;
-    Parser(const std::vector<Token>& vec_ref);
+
+    // Everything in this file, in order
+    TranslationUnitAST unit_;
+
+    // Only kept track of after track_functions() or reuse()
+    bool track_functions_ = false;
+    std::vector<FunctionRange> function_ranges_;
+    std::unordered_map<uint64_t, const FunctionRange*> reusable_;   // by hash, from the older version of the file
+    uint64_t signatures_hash_ = 0;
+    size_t reused_count_ = 0;
+
+    // An operator (or a "(", with fixity NOT_AN_OPERATOR) that parse_expression() hasn't applied yet
+    struct PendingOp {
+        Token tok;
+        uint8_t fixity;
+    };
+
+    // Child lists are collected on top of these and then copied into the arena in one go.
+    // parse_expression() also keeps its operands on expr_scratch_, and its operators on op_scratch_
+    std::vector<Expression> expr_scratch_;
+    std::vector<VariableExprAST*> arg_scratch_;
+    std::vector<PendingOp> op_scratch_;
+
+    // Errors and warnings about this file
+    void error_at(const Token& tok, const std::string& message);
+    void warning_at(const Token& tok, const std::string& message);
+    void warning_at(ExprAST* expr, const std::string& message);
 
     // Helper functions for Parser::parse().
-    /// @todo: add SCOPES
     salt::Result<Expression> parse_number_expr();
     salt::Result<Expression> parse_string_expr();
-    salt::Result<Expression> parse_paren_expr();
     salt::Result<Expression> parse_ident_expr();
     salt::Result<Expression> parse_primary();
     salt::Result<Expression> parse_expression();
-    salt::Result<Expression> parse_binop_rhs(int prec, Expression lhs);
+    salt::Result<Expression> make_unary(const Token& op, Expression operand);
+    salt::Result<void> reduce_top();
     salt::Result<Expression> parse_if_expr();
     salt::Result<Expression> parse_while_expr();
     salt::Result<Expression> parse_reserved_constant();
     salt::Result<Expression> parse_return();
-    salt::Result<Expression> parse_deref();
     salt::Result<Expression> parse_new_variable();
     salt::Result<Expression> parse_char();
-    salt::Result<Expression> parse_neg_expr();
-    salt::Result<std::unique_ptr<DeclarationAST>> parse_declaration();
-    salt::Result<std::unique_ptr<FunctionAST>> parse_function();
-    salt::Result<std::unique_ptr<DeclarationAST>> parse_extern();
-    salt::Result<std::unique_ptr<FunctionAST>> parse_top_level_expr();
+    salt::Result<DeclarationAST*> parse_declaration();
+    salt::Result<FunctionAST*> parse_function();
+    salt::Result<DeclarationAST*> parse_extern();
+    salt::Result<FunctionAST*> parse_top_level_expr();
 
     
 
-    bool skip_whitespace(); // returns true if newline occured.
-    bool skip_whitespace_back();
     ParserNextType next(); // returns delta between new and old positions
     ParserNextType back(); // returns delta between new and old positions
     bool can_go_next();
 
     salt::Result<void> handle_extern();
     salt::Result<void> handle_function();
+    salt::Result<void> handle_tracked_function();
+    size_t function_end(size_t first);
+    uint64_t hash_range(size_t first, size_t end);
+    uint64_t hash_signatures() const;
     salt::Result<void> handle_top_level_expr();
     salt::Result<void> handle_if_expr();
 
 
 public:
-    static Parser* get();
-    static Parser* get(const std::vector<Token>& vec_ref);
-    static void destroy();
+    // Reads file_name as it goes, or all at once if whole_file is set (--tokvec).
+    // The AST of the whole file goes in arena, and has to stay there until it has been code_gen()'d.
+    Parser(const std::string& file_name, DiagnosticSink& diagnostics, AstArena& arena, bool whole_file = false);
+
+    // Parses text as the contents of file_name, for editors that haven't saved it yet
+    Parser(const std::string& file_name, std::string text, DiagnosticSink& diagnostics, AstArena& arena);
+
+    // Parses the whole file without generating any code. Functions may call functions declared anywhere in it.
     ParserReturnType parse();
+
+    const std::string& file_name() const { return file_name_; }
+    const TokenStream& tokens() const { return vec; }
+    const TranslationUnitAST& unit() const { return unit_; }
+
+    // For files that only contain extern declarations, like the prelude.
+    // Parses them without generating any code, so they can be kept around (as long as the arena is) and declare()d later.
+    std::vector<DeclarationAST*> parse_declarations();
+
+    // Makes the functions in decls known to this parser. They still need to be declared in the module, see TranslationUnitAST::code_gen()
+    void declare(const std::vector<DeclarationAST*>& decls);
+
+    // Makes parse() remember the tokens and a hash of every top level fn, see function_ranges()
+    void track_functions();
+
+    // Makes parse() take the AST of every fn that is the same as one in previous (the function_ranges() of an older version
+    // of this file) from there, instead of parsing it again. Functions that moved get their line numbers fixed, in place.
+    // The signatures are only known once the whole file is parsed, so compare signatures_hash() with the old one afterwards:
+    // if it changed, the calls in the reused functions can have the wrong types, and the file has to be parsed again without reuse().
+    // previous has to stay around until parse() is done, and the reused nodes stay where they are, so their arena has to
+    // live as long as the AST of this Parser does.
+    void reuse(const std::vector<FunctionRange>& previous);
+
+    const std::vector<FunctionRange>& function_ranges() const { return function_ranges_; }
+    uint64_t signatures_hash() const { return signatures_hash_; }
+    size_t reused_count() const { return reused_count_; }
 };
 
-class ParserException : public salt::Exception {
-private:
-    std::string what_;
+// A syntax (or type) error at some token. Doesn't format or copy anything, see salt::Error
+class ParserException : public salt::Error {
 public:
-    ParserException(const Token& tok, const char* str);
-    ParserException(const char* str);
+    ParserException(const Token& tok, const char* str, salt::ErrorCode code = salt::ErrorCode::SYNTAX);
+    ParserException(const Token& tok, const std::string& str, salt::ErrorCode code = salt::ErrorCode::SYNTAX);
+    ParserException(ExprAST* expr, const char* str, salt::ErrorCode code = salt::ErrorCode::SYNTAX);
+    ParserException(int line, int col, const std::string& str, salt::ErrorCode code = salt::ErrorCode::SYNTAX);
 };
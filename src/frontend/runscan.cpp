@@ -0,0 +1,231 @@
+#include "runscan.h"
+#include "miniregex.h"
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SALT_RUNSCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// gcc and clang only let us use AVX2 intrinsics in functions marked for it,
+// msvc lets us use them anywhere
+#if defined(__GNUC__) || defined(__clang__)
+#define SALT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SALT_TARGET_AVX2
+#endif
+
+typedef const char* (*RunScanFn)(const char* p, const char* end);
+
+enum RunKind {
+    RUN_IDENT,
+    RUN_SPACE,
+    RUN_NOT_NEWLINE,
+};
+
+
+// Scalar versions, used for the tail of the buffer and on cpus without SSE2
+
+static const char* scan_ident_run_scalar(const char* p, const char* end) {
+    while (p != end && char_is(*p, CHAR_CLASS_IDENT))
+        p++;
+    return p;
+}
+
+static const char* scan_space_run_scalar(const char* p, const char* end) {
+    while (p != end && *p == ' ')
+        p++;
+    return p;
+}
+
+static const char* scan_to_newline_scalar(const char* p, const char* end) {
+    while (p != end && *p != '\n')
+        p++;
+    return p;
+}
+
+template <RunKind kind>
+static const char* scan_scalar(const char* p, const char* end) {
+    switch (kind) {
+    case RUN_IDENT:
+        return scan_ident_run_scalar(p, end);
+    case RUN_SPACE:
+        return scan_space_run_scalar(p, end);
+    default:
+        return scan_to_newline_scalar(p, end);
+    }
+}
+
+
+#ifdef SALT_RUNSCAN_X86
+
+static inline int lowest_set_bit(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// SSE2, 16 chars at a time
+
+// 0xff in every byte where lo <= ch <= hi. The range is moved down to start at -128
+// first, since SSE2 can only compare signed bytes.
+static inline __m128i in_range_sse2(__m128i chars, char lo, char hi) {
+    const __m128i shifted = _mm_add_epi8(chars, _mm_set1_epi8(static_cast<char>(0x80 - lo)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + (hi - lo) + 1)));
+}
+
+template <RunKind kind>
+static inline __m128i run_mask_sse2(__m128i chars) {
+    switch (kind) {
+    case RUN_IDENT: {
+        // OR-ing with 0x20 turns uppercase letters into lowercase ones, and nothing else into a letter
+        const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+        const __m128i alpha = in_range_sse2(lower, 'a', 'z');
+        const __m128i digit = in_range_sse2(chars, '0', '9');
+        const __m128i underscore = _mm_cmpeq_epi8(chars, _mm_set1_epi8('_'));
+        return _mm_or_si128(_mm_or_si128(alpha, digit), underscore);
+    }
+    case RUN_SPACE:
+        return _mm_cmpeq_epi8(chars, _mm_set1_epi8(' '));
+    default: {
+        const __m128i newline = _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n'));
+        return _mm_xor_si128(newline, _mm_set1_epi8(-1));
+    }
+    }
+}
+
+template <RunKind kind>
+static const char* scan_sse2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const uint32_t outside_run = ~static_cast<uint32_t>(_mm_movemask_epi8(run_mask_sse2<kind>(chars))) & 0xFFFF;
+        if (outside_run)
+            return p + lowest_set_bit(outside_run);
+        p += 16;
+    }
+    return scan_scalar<kind>(p, end);
+}
+
+// AVX2, 32 chars at a time, same idea as above
+
+SALT_TARGET_AVX2
+static inline __m256i in_range_avx2(__m256i chars, char lo, char hi) {
+    const __m256i shifted = _mm256_add_epi8(chars, _mm256_set1_epi8(static_cast<char>(0x80 - lo)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + (hi - lo) + 1)), shifted);
+}
+
+template <RunKind kind>
+SALT_TARGET_AVX2
+static inline __m256i run_mask_avx2(__m256i chars) {
+    switch (kind) {
+    case RUN_IDENT: {
+        const __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+        const __m256i alpha = in_range_avx2(lower, 'a', 'z');
+        const __m256i digit = in_range_avx2(chars, '0', '9');
+        const __m256i underscore = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('_'));
+        return _mm256_or_si256(_mm256_or_si256(alpha, digit), underscore);
+    }
+    case RUN_SPACE:
+        return _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' '));
+    default: {
+        const __m256i newline = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n'));
+        return _mm256_xor_si256(newline, _mm256_set1_epi8(-1));
+    }
+    }
+}
+
+template <RunKind kind>
+SALT_TARGET_AVX2
+static const char* scan_avx2(const char* p, const char* end) {
+    while (end - p >= 32) {
+        const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const uint32_t outside_run = ~static_cast<uint32_t>(_mm256_movemask_epi8(run_mask_avx2<kind>(chars)));
+        if (outside_run)
+            return p + lowest_set_bit(outside_run);
+        p += 32;
+    }
+    // Finish off with SSE2, which every AVX2 cpu has
+    return scan_sse2<kind>(p, end);
+}
+
+static bool cpu_has_sse2() {
+#if defined(_M_X64) || defined(__x86_64__)
+    return true; // part of x86-64
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return info[3] & (1 << 26);
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // The cpu has to support AVX, and the OS has to save the ymm registers for us
+    __cpuid(info, 1);
+    const bool osxsave = info[2] & (1 << 27);
+    const bool avx = info[2] & (1 << 28);
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // SALT_RUNSCAN_X86
+
+
+struct RunScanners {
+    const char* name;
+    RunScanFn ident;
+    RunScanFn space;
+    RunScanFn to_newline;
+};
+
+static RunScanners pick_run_scanners() {
+#ifdef SALT_RUNSCAN_X86
+    if (cpu_has_avx2())
+        return { "avx2", scan_avx2<RUN_IDENT>, scan_avx2<RUN_SPACE>, scan_avx2<RUN_NOT_NEWLINE> };
+    if (cpu_has_sse2())
+        return { "sse2", scan_sse2<RUN_IDENT>, scan_sse2<RUN_SPACE>, scan_sse2<RUN_NOT_NEWLINE> };
+#endif
+    return { "scalar", scan_scalar<RUN_IDENT>, scan_scalar<RUN_SPACE>, scan_scalar<RUN_NOT_NEWLINE> };
+}
+
+// Picked once, the first time the lexer needs it
+static const RunScanners& run_scanners() {
+    static const RunScanners scanners = pick_run_scanners();
+    return scanners;
+}
+
+const char* scan_ident_run(const char* p, const char* end) {
+    return run_scanners().ident(p, end);
+}
+
+const char* scan_space_run(const char* p, const char* end) {
+    return run_scanners().space(p, end);
+}
+
+const char* scan_to_newline(const char* p, const char* end) {
+    return run_scanners().to_newline(p, end);
+}
+
+const char* run_scanner_name() {
+    return run_scanners().name;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// Helpers for the Lexer to skip over long runs of chars at once when the whole file is in memory.
+// Every function returns a pointer to the first char in [p, end) that is not part of the run,
+// or end if the run goes on until the end of the buffer.
+// Uses AVX2 or SSE2 if the cpu supports it, and a table-driven scalar loop otherwise.
+
+// [a-zA-Z0-9_], so identifiers, keywords and numbers
+const char* scan_ident_run(const char* p, const char* end);
+
+// ' '
+const char* scan_space_run(const char* p, const char* end);
+
+// Everything up to (but not including) the next '\n', for line comments
+const char* scan_to_newline(const char* p, const char* end);
+
+// Name of the implementation that was picked for this cpu, for debug output and benchmarks
+const char* run_scanner_name();
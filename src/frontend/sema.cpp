@@ -0,0 +1,359 @@
+#include "sema.h"
+#include "types.h"
+
+using namespace salt;
+
+// Anything typed like this already has an error, so don't complain about it again
+static bool is_error(const TypeInstance& ti) {
+    return !ti.type || ti.type == SALT_TYPE_ERROR;
+}
+
+// Whether convert_implicit() can turn a from into a to
+static bool converts_implicitly(const llvm::Type* from, const llvm::Type* to) {
+    if (from == to)
+        return true;
+    if (to == SALT_TYPE_BOOL->get())
+        return from->isIntegerTy() || from->isFloatingPointTy() || from->isPointerTy();
+    if (from->isIntegerTy() || from->isFloatingPointTy())
+        return to->isIntegerTy() || to->isFloatingPointTy();
+    return false;
+}
+
+// Whether convert_explicit() can, for "x as T"
+static bool converts_explicitly(const llvm::Type* from, const llvm::Type* to) {
+    return converts_implicitly(from, to)
+        || to == SALT_TYPE_VOID->get()
+        || (from->isIntegerTy() && to->isPointerTy());
+}
+
+static bool is_comparison(Token_e op) {
+    switch (op) {
+    case TOK_LEFT_ANGLE:
+    case TOK_RIGHT_ANGLE:
+    case TOK_EQUALS_LARGER:
+    case TOK_EQUALS_SMALLER:
+    case TOK_EQUALS:
+    case TOK_NOT_EQUALS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// What a const fn can work with, it has nowhere to keep anything else while compiling
+static bool is_const_value(const TypeInstance& ti) {
+    return !ti.ptr_layers && (ti.type->is_numeric() || ti.type == SALT_TYPE_BOOL);
+}
+
+Sema::Sema(const std::string& file_name, DiagnosticSink& diagnostics, AstArena& arena) :
+    file_name_(file_name), diagnostics_(diagnostics), arena_(arena) {}
+
+std::string Sema::location(int line, int col) const {
+    return file_name_ + " - " + std::to_string(line) + ':' + std::to_string(col) + ": ";
+}
+
+void Sema::error_at(ExprAST* expr, const std::string& message) {
+    diagnostics_.error(location(expr->line(), expr->col()) + message);
+}
+
+void Sema::error_at(DeclarationAST* decl, const std::string& message) {
+    diagnostics_.error(location(decl->line(), decl->col()) + message);
+}
+
+void Sema::warning_at(ExprAST* expr, const std::string& message) {
+    diagnostics_.warning(location(expr->line(), expr->col()) + message);
+}
+
+void Sema::warning_at(DeclarationAST* decl, const std::string& message) {
+    diagnostics_.warning(location(decl->line(), decl->col()) + message);
+}
+
+bool Sema::implicit_cast(Expression& slot, const TypeInstance& to) {
+    if (slot->type() == to.type)
+        return true;
+    if (!converts_implicitly(slot->type()->get(), to.type->get()))
+        return false;
+
+    slot = arena_.make<ImplicitCastExprAST>(slot, to);
+    return true;
+}
+
+void Sema::check(TranslationUnitAST& unit, const std::vector<DeclarationAST*>& prelude) {
+    functions_.clear();
+    for (DeclarationAST* decl : prelude)
+        functions_[decl->name()] = decl;
+    for (DeclarationAST* decl : unit.declarations)
+        functions_[decl->name()] = decl;
+
+    // It's fine to declare a function again, but not to define it twice
+    std::unordered_set<Symbol> defined;
+    for (FunctionAST* fn : unit.functions) {
+        if (!defined.insert(fn->decl()->name()).second)
+            error_at(fn->decl(), f_string("redefinition of function %s", fn->decl()->name().c_str()));
+        functions_[fn->decl()->name()] = fn->decl();
+    }
+
+    for (FunctionAST* fn : unit.functions)
+        check_function(fn);
+}
+
+void Sema::check_function(FunctionAST* fn) {
+    current_fn_ = fn->decl();
+    locals_.clear();
+    for (const VariableExprAST* arg : current_fn_->args())
+        locals_.insert(arg->name());
+
+    if (current_fn_->is_const()) {
+        if (!is_const_value(current_fn_->type_instance()))
+            error_at(current_fn_, f_string("const fn %s must return a number or a bool, not %s",
+                current_fn_->name().c_str(), current_fn_->type_instance().str().c_str()));
+        for (VariableExprAST* arg : current_fn_->args())
+            if (!is_error(arg->type_instance()) && !is_const_value(arg->type_instance()))
+                error_at(arg, f_string("const fn %s can only take numbers and bools, not %s",
+                    current_fn_->name().c_str(), arg->type_instance().str().c_str()));
+    }
+
+    for (Expression statement : fn->body()) {
+        statement_ = statement;
+        visit_tree_bottom_up(statement);
+    }
+    statement_ = nullptr;
+
+    // code_gen() adds the missing return, we only warn about it
+    const bool returns_void = current_fn_->type() == SALT_TYPE_VOID;
+    if (fn->body().empty())
+        warning_at(current_fn_, f_string("%s does not end with a return instruction", current_fn_->name().c_str()));
+    else if (!returns_void && !llvm::isa<ReturnAST>(fn->body().back()))
+        warning_at(fn->body().back(), f_string("%s does not end with a return instruction", current_fn_->name().c_str()));
+}
+
+void Sema::visit_binary(BinaryExprAST* expr) {
+    const TypeInstance lhs_ti = expr->lhs_->type_instance();
+    const TypeInstance rhs_ti = expr->rhs_->type_instance();
+
+    // "x as T" is whatever T is, even if x is wrong
+    if (expr->op_ == TOK_AS) {
+        expr->ti_ = rhs_ti;
+        if (!is_error(lhs_ti) && !is_error(rhs_ti) && !converts_explicitly(lhs_ti.type->get(), rhs_ti.type->get()))
+            error_at(expr, f_string("cannot convert %s to %s", lhs_ti.str().c_str(), rhs_ti.str().c_str()));
+        return;
+    }
+
+    if (expr->op_ == TOK_ASSIGN) {
+        expr->ti_ = lhs_ti;
+        if (!llvm::isa<DerefExprAST>(expr->lhs_) && !llvm::isa<VariableExprAST>(expr->lhs_)) {
+            error_at(expr->lhs_, f_string("cannot assign to `%s`", expr->lhs_->ast_type().c_str()));
+            return;
+        }
+        if (!is_error(lhs_ti) && !is_error(rhs_ti) && !implicit_cast(expr->rhs_, lhs_ti))
+            error_at(expr->rhs_, f_string("cannot assign a %s to a %s", rhs_ti.str().c_str(), lhs_ti.str().c_str()));
+        return;
+    }
+
+    expr->ti_ = SALT_TYPE_ERROR;
+    if (is_error(lhs_ti) || is_error(rhs_ti))
+        return;
+
+    // Pointers can be compared with each other, and moved around by an integer
+    const bool lhs_is_ptr = lhs_ti.ptr_layers > 0;
+    const bool rhs_is_ptr = rhs_ti.ptr_layers > 0;
+    if (lhs_is_ptr || rhs_is_ptr) {
+        if (lhs_is_ptr && rhs_is_ptr && is_comparison(expr->op_)) {
+            expr->ti_ = SALT_TYPE_BOOL;
+        }
+        else if (lhs_is_ptr != rhs_is_ptr && (expr->op_ == TOK_ADD || (expr->op_ == TOK_SUB && lhs_is_ptr))) {
+            Expression& offset = lhs_is_ptr ? expr->rhs_ : expr->lhs_;
+            if (!offset->type()->get()->isIntegerTy())
+                error_at(offset, "pointer offset must be an integer");
+            else if (implicit_cast(offset, SALT_TYPE_SSIZE))
+                expr->ti_ = lhs_is_ptr ? lhs_ti : rhs_ti;
+        }
+        else {
+            error_at(expr, f_string("unsupported operation between `%s` and `%s`", lhs_ti.str().c_str(), rhs_ti.str().c_str()));
+        }
+        return;
+    }
+
+    // Both go to the bigger of the two types
+    const TypeInstance common = rhs_ti.type->rank > lhs_ti.type->rank ? rhs_ti : lhs_ti;
+    const llvm::Type* common_type = common.type->get();
+    if (!converts_implicitly(lhs_ti.type->get(), common_type) || !converts_implicitly(rhs_ti.type->get(), common_type)) {
+        error_at(expr, f_string("unsupported conversion between `%s` and `%s` type", lhs_ti.type->name.c_str(), rhs_ti.type->name.c_str()));
+        return;
+    }
+
+    bool supported = false;
+    switch (expr->op_) {
+    case TOK_ADD:
+    case TOK_SUB:
+    case TOK_MUL:
+    case TOK_DIV:
+    case TOK_MODULO:
+    case TOK_LEFT_ANGLE:
+    case TOK_RIGHT_ANGLE:
+    case TOK_EQUALS_LARGER:
+    case TOK_EQUALS_SMALLER:
+    case TOK_EQUALS:
+    case TOK_NOT_EQUALS:
+        supported = common_type->isIntegerTy() || common_type->isFloatingPointTy();
+        break;
+    case TOK_LEFT_SHIFT:
+    case TOK_RIGHT_SHIFT:
+    case TOK_CARAT:
+    case TOK_AMPERSAND:
+    case TOK_VERTICAL_BAR:
+        supported = common_type->isIntegerTy();
+        break;
+    default:
+        break;
+    }
+    if (!supported) {
+        error_at(expr, f_string("unsupported operation for `%s` type", common.str().c_str()));
+        return;
+    }
+
+    if (expr->op_ == TOK_DIV) {
+        if (ValExprAST* divisor = llvm::dyn_cast<ValExprAST>(expr->rhs_))
+            if ((divisor->type()->is_integer() && divisor->to_int() == 0) || (divisor->type()->is_float() && divisor->to_double() == 0.0))
+                warning_at(divisor, "division by zero");
+    }
+    if (expr->op_ == TOK_MODULO && common.type->is_float() && salt::no_std)
+        warning_at(expr, "floating - point remainder with no_std flag");
+
+    implicit_cast(expr->lhs_, common);
+    implicit_cast(expr->rhs_, common);
+    expr->ti_ = is_comparison(expr->op_) ? TypeInstance(SALT_TYPE_BOOL) : common;
+}
+
+void Sema::visit_unary(UnaryExprAST* expr) {
+    const TypeInstance& operand_ti = expr->operand_->type_instance();
+    expr->ti_ = SALT_TYPE_ERROR;
+    if (is_error(operand_ti))
+        return;
+
+    const salt::Type* type = operand_ti.type;
+    switch (expr->op_) {
+    case TOK_SUB:
+        if (!type->is_numeric())
+            return error_at(expr, f_string("cannot negate expression of type %s", operand_ti.str().c_str()));
+        expr->ti_ = operand_ti;
+        break;
+    case TOK_TILDE:
+        if (!type->is_integer() && type != SALT_TYPE_BOOL)
+            return error_at(expr, f_string("cannot take bitwise not of expression of type %s", operand_ti.str().c_str()));
+        expr->ti_ = operand_ti;
+        break;
+    case TOK_EXCLAMATION:
+    case TOK_NOT:
+        if (!type->is_numeric() && type != SALT_TYPE_BOOL && !operand_ti.ptr_layers)
+            return error_at(expr, f_string("cannot take logical not of expression of type %s", operand_ti.str().c_str()));
+        expr->ti_ = SALT_TYPE_BOOL;
+        break;
+    default:
+        break;
+    }
+}
+
+void Sema::visit_deref(DerefExprAST* expr) {
+    const TypeInstance& ptr_ti = expr->expr_->type_instance();
+    expr->ti_ = SALT_TYPE_ERROR;
+    if (is_error(ptr_ti))
+        return;
+
+    if (ptr_ti.ptr_layers >= 2) {
+        expr->ti_ = ptr_ti;
+        expr->ti_.ptr_layers--;
+    }
+    else if (ptr_ti.ptr_layers == 1 && ptr_ti.pointee && ptr_ti.pointee != SALT_TYPE_VOID)
+        expr->ti_ = ptr_ti.pointee;
+    else
+        error_at(expr, f_string("cannot dereference %s", ptr_ti.str().c_str()));
+
+    if (current_fn_->is_const())
+        error_at(expr, f_string("const fn %s can't dereference pointers", current_fn_->name().c_str()));
+}
+
+void Sema::visit_if(IfExprAST* expr) {
+    if (!is_error(expr->condition_->type_instance()) && !implicit_cast(expr->condition_, SALT_TYPE_BOOL))
+        error_at(expr, "bad if condition");
+
+    const TypeInstance true_ti = expr->true_expr_->type_instance();
+    const TypeInstance false_ti = expr->false_expr_->type_instance();
+    expr->ti_ = SALT_TYPE_ERROR;
+    if (is_error(true_ti) || is_error(false_ti))
+        return;
+
+    const TypeInstance common = false_ti.type->rank > true_ti.type->rank ? false_ti : true_ti;
+    if (!implicit_cast(expr->true_expr_, common) || !implicit_cast(expr->false_expr_, common))
+        return error_at(expr, "both arms of an if-expression must be of the same type");
+    expr->ti_ = common;
+}
+
+void Sema::visit_call(CallExprAST* expr) {
+    auto it = functions_.find(expr->callee_);
+    if (it == functions_.end()) {
+        expr->ti_ = SALT_TYPE_ERROR;
+        return error_at(expr, f_string("function %s does not exist", expr->callee_.c_str()));
+    }
+
+    DeclarationAST* callee = it->second;
+    expr->ti_ = callee->type_instance();
+    if (current_fn_->is_const() && !callee->is_const())
+        error_at(expr, f_string("const fn %s can't call %s, which isn't const", current_fn_->name().c_str(), expr->callee_.c_str()));
+    if (callee->args().size() != expr->args_.size())
+        return error_at(expr, f_string("function %s takes %d arguments, but %d were provided",
+            expr->callee_.c_str(), int(callee->args().size()), int(expr->args_.size())));
+
+    for (size_t i = 0; i < expr->args_.size(); i++) {
+        Expression& arg = expr->args_[i];
+        if (!is_error(arg->type_instance()) && !implicit_cast(arg, callee->args()[i]->type_instance()))
+            return error_at(expr, f_string("function %s was called with bad argument types", expr->callee_.c_str()));
+    }
+}
+
+void Sema::visit_new_variable(NewVariableAST* expr) {
+    VariableExprAST* var = expr->var_;
+    if (!locals_.insert(var->name()).second)
+        error_at(var, f_string("variable %s already exists", var->name().c_str()));
+
+    const TypeInstance var_ti = var->type_instance();
+    const TypeInstance value_ti = expr->value_->type_instance();
+    if (var_ti.type == SALT_TYPE_VOID)
+        return error_at(var, "cannot create variable of void type");
+    if (value_ti.type == SALT_TYPE_VOID)
+        return error_at(expr->value_, "bad value for assignment");
+    if (is_error(var_ti) || is_error(value_ti))
+        return;
+    if (current_fn_->is_const() && !is_const_value(var_ti))
+        return error_at(var, f_string("const fn %s can only have numbers and bools, not %s", current_fn_->name().c_str(), var_ti.str().c_str()));
+
+    if (!implicit_cast(expr->value_, var_ti))
+        error_at(expr->value_, f_string("cannot create a %s from a %s", var_ti.str().c_str(), value_ti.str().c_str()));
+}
+
+void Sema::visit_return(ReturnAST* expr) {
+    if (expr != statement_) {
+        expr->ti_ = SALT_TYPE_ERROR;
+        return error_at(expr, "return can only be used as a statement of its own");
+    }
+
+    const TypeInstance& expected = current_fn_->type_instance();
+    const TypeInstance actual = expr->return_val->type_instance();
+    expr->expected_return_type = expected;
+    if (is_error(actual))
+        return;
+    if (expected.type == SALT_TYPE_VOID && actual.type == SALT_TYPE_VOID)
+        return;
+
+    // We can convert pointers to bool for example, but we can't convert a void* to an int*, or an int* to an int**.
+    // Any pointer goes to a void* though
+    const bool ok = expected == actual
+        || (converts_implicitly(actual.type->get(), expected.type->get())
+            && (expected.ptr_layers == 0
+                || actual.ptr_layers == 0
+                || (expected.ptr_layers == 1 && expected.pointee == SALT_TYPE_VOID)));
+    if (!ok)
+        return error_at(expr, f_string("returning %s when %s was expected", actual.str().c_str(), expected.str().c_str()));
+
+    implicit_cast(expr->return_val, expected);
+}
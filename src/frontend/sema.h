@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ast.h"
+#include "astvisitor.h"
+#include "astarena.h"
+#include "diagnostics.h"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Type checks a parsed TranslationUnitAST, between the Parser and code_gen().
+// The parser only types the leaves (it knows what every name is), Sema types every other node
+// from its children and wraps children that have to be converted in an ImplicitCastExprAST, so
+// code_gen() can trust the types it finds and doesn't report anything itself.
+//
+// Errors and warnings go to the DiagnosticSink like the parser's do. Don't code_gen() a unit
+// that came back with errors, the types in it aren't worth anything then.
+class Sema : public ExprVisitor<Sema> {
+private:
+    std::string file_name_;
+    DiagnosticSink& diagnostics_;
+    AstArena& arena_;       // for the casts
+
+    std::unordered_map<Symbol, DeclarationAST*> functions_;
+    std::unordered_set<Symbol> locals_;     // of the function being checked
+    DeclarationAST* current_fn_ = nullptr;
+    Expression statement_ = nullptr;        // the top level statement being checked
+
+    std::string location(int line, int col) const;
+    void error_at(ExprAST* expr, const std::string& message);
+    void error_at(DeclarationAST* decl, const std::string& message);
+    void warning_at(ExprAST* expr, const std::string& message);
+    void warning_at(DeclarationAST* decl, const std::string& message);
+
+    // Makes slot the type to, returns false (and changes nothing) if that can't be done implicitly
+    bool implicit_cast(Expression& slot, const TypeInstance& to);
+
+    void check_function(FunctionAST* fn);
+
+    friend class ExprVisitor<Sema>;
+    void visit_binary(BinaryExprAST* expr);
+    void visit_unary(UnaryExprAST* expr);
+    void visit_deref(DerefExprAST* expr);
+    void visit_if(IfExprAST* expr);
+    void visit_call(CallExprAST* expr);
+    void visit_new_variable(NewVariableAST* expr);
+    void visit_return(ReturnAST* expr);
+
+public:
+    // file_name is only for the messages, arena should be the one unit was parsed into
+    Sema(const std::string& file_name, DiagnosticSink& diagnostics, AstArena& arena);
+
+    // prelude has the functions declared before this file, like Parser::declare()
+    void check(TranslationUnitAST& unit, const std::vector<DeclarationAST*>& prelude = {});
+};
@@ -0,0 +1,106 @@
+#include "sourcemanager.h"
+#include <algorithm>
+
+std::atomic<SourceManager*> SourceManager::instance_ = nullptr;
+std::mutex SourceManager::instance_mutex_;
+
+SourceManager::SourceManager() {
+    this->files_ = std::vector<std::unique_ptr<SourceFile>>();
+}
+
+SourceManager* SourceManager::get() {
+    if (SourceManager* sm = instance_.load(std::memory_order_acquire))
+        return sm;
+
+    // Several lexers might ask for the first one at the same time
+    std::lock_guard<std::mutex> lock(instance_mutex_);
+    if (!instance_.load(std::memory_order_relaxed))
+        instance_.store(new SourceManager(), std::memory_order_release);
+    return instance_.load(std::memory_order_relaxed);
+}
+
+// Destroys the current source manager, every Token made so far loses its data.
+// Nothing may be lexing while this happens.
+void SourceManager::destroy() {
+    std::lock_guard<std::mutex> lock(instance_mutex_);
+    delete instance_.exchange(nullptr);
+}
+
+SourceFile& SourceManager::add_file(const std::string& name) {
+    return add_file(name, std::string());
+}
+
+SourceFile& SourceManager::add_file(const std::string& name, std::string text) {
+    auto file = std::make_unique<SourceFile>();
+    file->name = name;
+    file->text = std::move(text);
+
+    std::unique_lock<std::shared_mutex> lock(files_mutex_);
+
+    // Leave one offset free after every file, so its EOF token still points into it
+    if (files_.empty())
+        file->base = 1;
+    else
+        file->base = files_.back()->base + static_cast<uint32_t>(files_.back()->text.size()) + 1;
+
+    files_.push_back(std::move(file));
+    return *files_.back();
+}
+
+const SourceFile* SourceManager::file_at(uint32_t offset) const {
+    std::shared_lock<std::shared_mutex> lock(files_mutex_);
+    if (offset == 0 || files_.empty())
+        return nullptr;
+
+    // First file that starts after offset, the one before that is ours
+    auto it = std::upper_bound(files_.begin(), files_.end(), offset,
+        [](uint32_t off, const std::unique_ptr<SourceFile>& file) { return off < file->base; });
+    if (it == files_.begin())
+        return nullptr;
+
+    return (it - 1)->get();
+}
+
+std::string_view SourceManager::text(uint32_t offset, uint32_t length) const {
+    const SourceFile* file = file_at(offset);
+    if (!file)
+        return std::string_view();
+
+    const uint32_t rel = offset - file->base;
+    if (rel >= file->text.size())
+        return std::string_view();
+
+    return std::string_view(file->text).substr(rel, length);
+}
+
+int SourceManager::line(uint32_t offset) const {
+    const SourceFile* file = file_at(offset);
+    if (!file)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(file->line_starts_mutex);
+    std::vector<uint32_t>& starts = file->line_starts;
+    if (starts.empty())
+        starts.push_back(0);
+
+    // Catch up with whatever the lexer has read since the last call
+    const std::string& text = file->text;
+    for (uint32_t i = file->lines_scanned_up_to; i < text.size(); i++) {
+        if (text[i] == '\n')
+            starts.push_back(i + 1);
+    }
+    file->lines_scanned_up_to = static_cast<uint32_t>(text.size());
+
+    const uint32_t rel = offset - file->base;
+    return static_cast<int>(std::upper_bound(starts.begin(), starts.end(), rel) - starts.begin());
+}
+
+int SourceManager::col(uint32_t offset) const {
+    const int line_number = line(offset);
+    if (line_number == 0)
+        return 0;
+
+    const SourceFile* file = file_at(offset);
+    std::lock_guard<std::mutex> lock(file->line_starts_mutex);
+    return static_cast<int>(offset - file->base - file->line_starts[line_number - 1]) + 1;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../common.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+
+// A source file that has been (or is being) read by the Lexer.
+// Its chars live at global offsets [base, base + text.size()].
+struct SourceFile {
+    std::string name;
+    std::string text;
+    uint32_t base;
+
+    // Offsets (relative to base) of the first char of every line, built lazily
+    // since the Lexer may still be appending to text when streaming a file.
+    mutable std::vector<uint32_t> line_starts;
+    mutable uint32_t lines_scanned_up_to = 0;
+    mutable std::mutex line_starts_mutex;
+};
+
+// Owns the text of every file in the current compilation, so that Tokens can
+// refer to their data with a (global) offset and length instead of owning a string.
+// Offset 0 is never used by a file, a Token with offset 0 has no location.
+// Files can be added and looked up from several threads at once.
+class SourceManager {
+private:
+    std::vector<std::unique_ptr<SourceFile>> files_;
+    mutable std::shared_mutex files_mutex_;
+    static std::atomic<SourceManager*> instance_;
+    static std::mutex instance_mutex_;
+
+    SourceManager();
+    const SourceFile* file_at(uint32_t offset) const;
+
+public:
+    static SourceManager* get();
+    static void destroy();
+
+    // Adds a new (empty) file, the caller fills in its text.
+    // Only the last added file may still grow, so files that are streamed in can't be
+    // read by more than one thread at a time.
+    SourceFile& add_file(const std::string& name);
+
+    // Adds a file whose text is already complete
+    SourceFile& add_file(const std::string& name, std::string text);
+
+    std::string_view text(uint32_t offset, uint32_t length) const;
+    int line(uint32_t offset) const;
+    int col(uint32_t offset) const;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "interner.h"
+#include <vector>
+#include <cstdint>
+
+// Maps Symbols to values (the Parser keeps the type of every variable in one) and knows about scopes.
+// Everything declared lives in one flat vector, in the order it was declared, so leaving a scope is just
+// popping what was declared since entering it. Lookups don't hash anything: heads_ is indexed by the symbol id
+// and points to the newest declaration of that symbol, and every declaration points to the one it shadows.
+template <typename T>
+class SymbolTable {
+private:
+    static constexpr int32_t NONE = -1;
+
+    struct Entry {
+        Symbol name;
+        T value;
+        uint32_t depth;         // the scope it was declared in, 0 is global
+        int32_t shadowed;       // the older declaration of name this one hides, or NONE
+    };
+
+    std::vector<Entry> entries_;
+    std::vector<int32_t> heads_;            // heads_[symbol id], newest entry with that name
+    std::vector<uint32_t> scope_starts_;    // where each scope (except global) begins in entries_
+
+    int32_t& head(Symbol name) {
+        if (name.id() >= heads_.size())
+            heads_.resize(name.id() + 1, NONE);
+        return heads_[name.id()];
+    }
+
+public:
+    // Enters a scope when it's made, and leaves it when it goes out of scope itself. Parser functions
+    // return early all the time, so this is how they leave scopes.
+    class Scope {
+    private:
+        SymbolTable& table_;
+
+    public:
+        Scope(SymbolTable& table) : table_(table) { table_.push_scope(); }
+        ~Scope() { table_.pop_scope(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    uint32_t depth() const { return static_cast<uint32_t>(scope_starts_.size()); }
+
+    void push_scope() { scope_starts_.push_back(static_cast<uint32_t>(entries_.size())); }
+
+    // Forgets everything declared in the innermost scope, and brings back whatever it shadowed
+    void pop_scope() {
+        if (scope_starts_.empty())
+            salt::print_fatal("SymbolTable::pop_scope(): already at global scope");
+
+        const uint32_t start = scope_starts_.back();
+        scope_starts_.pop_back();
+        while (entries_.size() > start) {
+            heads_[entries_.back().name.id()] = entries_.back().shadowed;
+            entries_.pop_back();
+        }
+    }
+
+    // Declares name in the current scope. Declaring it twice in the same scope just changes its value
+    void declare(Symbol name, const T& value) {
+        int32_t& h = head(name);
+        if (h != NONE && entries_[h].depth == depth()) {
+            entries_[h].value = value;
+            return;
+        }
+
+        entries_.push_back({ name, value, depth(), h });
+        h = static_cast<int32_t>(entries_.size() - 1);
+    }
+
+    // The value of the innermost declaration of name, or nullptr if there is none
+    const T* find(Symbol name) const {
+        if (name.id() >= heads_.size() || heads_[name.id()] == NONE)
+            return nullptr;
+        return &entries_[heads_[name.id()]].value;
+    }
+
+    // Same as find() but gives a default constructed T if name doesn't exist
+    T lookup(Symbol name) const {
+        const T* res = find(name);
+        return res ? *res : T();
+    }
+};
@@ -3,65 +3,55 @@ this file is part of my salt project, which uses the gnu gplv3 license
 */
 
 #include "tokens.h"
+#include "sourcemanager.h"
 #include <string>
 Token::Token(Token_e value) {
-    this->val_ = value;
-    this->data_ = std::string("");
+    this->offset_ = 0;
+    this->length_ = 0;
+    this->symbol_ = Symbol();
+    this->val_ = static_cast<int16_t>(value);
     this->count_ = 0;
-    this->col_ = lexer_col;
-    this->line_ = lexer_line;
+    this->indent_ = NO_INDENT;
 }
 
-Token::Token(Token_e value, const std::string& data) {
-    this->val_ = value;
-    this->data_ = data;
-    this->count_ = 0;
-    this->col_ = lexer_col;
-    this->line_ = lexer_line;
-}
-
-Token::Token(Token_e value, const std::string&& data) {
-    this->val_ = value;
-    this->data_ = data;
-    this->count_ = 1;
-    this->col_ = lexer_col;
-    this->line_ = lexer_line;
+Token::Token(Token_e value, uint32_t offset, uint32_t length, Symbol symbol, int count) {
+    this->offset_ = offset;
+    this->length_ = length;
+    this->symbol_ = symbol;
+    this->val_ = static_cast<int16_t>(value);
+    this->count_ = static_cast<uint8_t>(count);
+    this->indent_ = NO_INDENT;
 }
 
-Token::Token(Token_e value, const std::string& data, int count) {
-    this->val_ = value;
-    this->data_ = data;
-    this->count_ = count;
-    this->col_ = lexer_col;
-    this->line_ = lexer_line;
+std::string_view Token::data() const {
+    if (this->symbol_)
+        return this->symbol_.str();
+    return SourceManager::get()->text(this->offset_, this->length_);
 }
 
-Token::Token(Token_e value, const std::string&& data, int count) {
-    this->val_ = value;
-    this->data_ = data;
-    this->count_ = count;
-    this->col_ = lexer_col;
-    this->line_ = lexer_line;
+Symbol Token::interned() const {
+    if (this->symbol_)
+        return this->symbol_;
+    return Interner::get()->intern(this->data());
 }
 
-Token::Token(Token_e value, const std::string& data, int count, int line, int col) {
-    this->val_ = value;
-    this->data_ = data;
-    this->count_ = count;
-    this->col_ = col;
-    this->line_ = line;
+int Token::col() const {
+    return SourceManager::get()->col(this->offset_);
 }
 
-std::string& Token::data() const {
-    return const_cast<std::string&>(this->data_);
+int Token::line() const {
+    return SourceManager::get()->line(this->offset_);
 }
 
-int Token::col() const {
-    return this->col_;
+Token Token::merged(Token_e value, const Token& next, int count, Symbol symbol) const {
+    Token res = Token(value, this->offset_, next.offset_ + next.length_ - this->offset_, symbol, count);
+    res.indent_ = this->indent_;
+    return res;
 }
 
-int Token::line() const {
-    return this->line_;
+void Token::set_indent(int depth) {
+    // NO_INDENT is taken, nobody indents that far anyway
+    this->indent_ = static_cast<uint8_t>(depth < NO_INDENT ? depth : NO_INDENT - 1);
 }
 
 Token::operator int() const {
@@ -72,8 +62,20 @@ Token::operator bool() const {
     return this->val_ != TOK_NONE;
 }
 
+// Only these tokens carry data, the rest just point at their symbols in the source
 bool Token::has_data() const {
-    return this->data() != "";
+    switch (val()) {
+    case TOK_ERROR:
+    case TOK_IDENT:
+    case TOK_NUMBER:
+    case TOK_CHAR:
+    case TOK_STRING:
+    case TOK_TYPE:
+    case TOK_PTR:
+        return !this->data().empty();
+    default:
+        return false;
+    }
 }
 
 int Token::count() const {
@@ -108,7 +110,7 @@ std::ostream& operator<<(std::ostream& os, const Token& token) {
 }
 
 Token_e Token::val() const {
-    return this->val_;
+    return static_cast<Token_e>(this->val_);
 }
 
 std::string Token::str() const {
@@ -307,7 +309,7 @@ std::string Token::str() const {
 [[deprecated("TOK_PTR is deprecated")]]
 Token Token::as_pointer() const {
     if (this->val() != TOK_TYPE)
-        salt::print_fatal(salt::Exception((std::to_string(line_) + ':' + std::to_string(col_) + ':' + "(internal) Bad call to Token::to_pointer()").c_str()));
+        salt::print_fatal(salt::Exception((std::to_string(line()) + ':' + std::to_string(col()) + ':' + "(internal) Bad call to Token::to_pointer()").c_str()));
     
-    return Token(TOK_PTR, this->data());
+    return Token(TOK_PTR, this->offset_, this->length_, this->symbol_);
 }
\ No newline at end of file
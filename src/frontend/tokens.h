@@ -4,8 +4,12 @@ this file is part of my salt project, which uses the gnu gplv3 license
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <iostream>
+#include <cstdint>
+#include <type_traits>
 #include "../common.h"
+#include "interner.h"
 
 #define TOKEN_STR_NAN "nan"
 #define TOKEN_STR_NULL "null"
@@ -13,9 +17,6 @@ this file is part of my salt project, which uses the gnu gplv3 license
 #define TOKEN_STR_FALSE "false"
 #define TOKEN_STR_INF "inf"
 
-extern int lexer_line;
-extern int lexer_col;
-
 enum Token_e {
     // never use
     TOK_MIN         = -3,
@@ -56,7 +57,7 @@ enum Token_e {
     TOK_EOL,                // end of line
     TOK_EOS,                // end of statement
     TOK_MUT,
-    TOK_CONST,              // possible dontuse; variables const by default
+    TOK_CONST,              // const fn
     
     // operators
     TOK_ADD,                // +
@@ -162,23 +163,25 @@ enum Token_e {
     TOK_TOTAL
 }; 
 
+// A token is just a view into the source held by the SourceManager, so it can be
+// copied around freely. Identifiers, types and literals also carry their interned
+// Symbol, which is also used for data that doesn't appear in the source as-is
+// (like "uint" for "unsigned int").
 class Token {
 private:
 
-    Token_e val_;
-    std::string data_;
-    int count_;
-    int line_;
-    int col_;
+    uint32_t offset_;   // global offset into the SourceManager, 0 if the token has no location
+    uint32_t length_;
+    Symbol symbol_;     // interned data, if the lexer interned it
+    int16_t val_;
+    uint8_t count_;
+    uint8_t indent_;    // indentation depth if this is the first token on its line, NO_INDENT otherwise
 
 public:
+    static constexpr uint8_t NO_INDENT = 0xFF;
 
-    Token(Token_e value);
-    Token(Token_e value, const std::string& data);
-    Token(Token_e value, const std::string&& data);
-    Token(Token_e value, const std::string& data, int count);
-    Token(Token_e value, const std::string&& data, int count);
-    Token(Token_e value, const std::string& data, int count, int line, int col);
+    Token(Token_e value = TOK_NONE);
+    Token(Token_e value, uint32_t offset, uint32_t length, Symbol symbol = Symbol(), int count = 0);
 
     explicit operator int() const;
     explicit operator bool() const;
@@ -186,17 +189,36 @@ public:
     // Converts a token to a string.
     std::string str() const;
 
-    // Retrieves the data from a string, if there is any.
-    std::string& data() const;
+    // Retrieves the data from a token, if there is any.
+    // The view stays valid until the SourceManager is destroyed.
+    std::string_view data() const;
     int count() const;
 
     bool has_data() const;
 
     Token_e val() const;
 
+    uint32_t offset() const { return offset_; }
+    uint32_t length() const { return length_; }
+    Symbol symbol() const { return symbol_; }
+
+    // Returns symbol(), or interns the data if the lexer didn't.
+    Symbol interned() const;
+
+    // The lexer doesn't emit whitespace, instead the first token of every line
+    // remembers how far that line is indented (1 per tab or 4 spaces).
+    bool starts_line() const { return indent_ != NO_INDENT; }
+    int indent() const { return starts_line() ? indent_ : 0; }
+    void set_indent(int depth);
+
+    // Looked up in the SourceManager, so prefer calling these only once per token
     int col() const;
     int line() const;
 
+    // Returns a token of kind value that spans from this token up to and including next.
+    // Keeps this token's indentation.
+    Token merged(Token_e value, const Token& next, int count = 0, Symbol symbol = Symbol()) const;
+
     // Make the Token printable with std::cout and std::cerr
     friend std::ostream& operator<<(std::ostream& os, const Token& token);
 
@@ -206,6 +228,9 @@ public:
     bool is_whitespace() const;
 };
 
+static_assert(sizeof(Token) == 16, "Token should stay small enough to pass around by value");
+static_assert(std::is_trivially_copyable_v<Token>);
+
 // An exception that is thrown when a bad char is encountered.
 class BadCharException : public salt::Exception {
 public:
@@ -0,0 +1,116 @@
+#include "tokenstream.h"
+#include "lexer.h"
+#include <algorithm>
+
+TokenStream::TokenStream(const std::vector<std::string>& files, bool whole_file) {
+    this->files_ = files;
+    this->next_file_ = 0;
+    this->whole_file_ = whole_file;
+    this->finished_ = false;
+    this->ring_ = std::vector<Token>(256);
+    this->first_ = 0;
+    this->end_ = 0;
+
+    if (files_.empty())
+        salt::print_fatal("TokenStream: no files to read");
+
+    if (!whole_file_) {
+        open_next_file();
+        return;
+    }
+
+    // The old way, tokenize every file and glue them together
+    for (size_t i = 0; i < files_.size(); i++) {
+        Lexer lexer;
+        for (const Token& tok : lexer.tokenize(files_[i].c_str()))
+            if (tok.val() != TOK_EOF || i == files_.size() - 1)
+                push(tok);
+
+        for (const salt::Error& e : lexer.errors())
+            salt::dbout << e.str() << std::endl;
+    }
+    next_file_ = files_.size();
+    finished_ = true;
+}
+
+TokenStream::TokenStream(const std::string& name, std::string text) {
+    this->files_ = { name };
+    this->next_file_ = 1;
+    this->whole_file_ = false;
+    this->finished_ = false;
+    this->ring_ = std::vector<Token>(256);
+    this->first_ = 0;
+    this->end_ = 0;
+
+    lexer_ = std::make_unique<Lexer>();
+    lexer_->open_text(name, std::move(text));
+}
+
+// Out of line, since Lexer is incomplete in the header
+TokenStream::~TokenStream() = default;
+
+// Every file gets a fresh lexer
+void TokenStream::open_next_file() {
+    lexer_ = std::make_unique<Lexer>();
+    lexer_->open(files_[next_file_].c_str());
+    next_file_++;
+}
+
+void TokenStream::push(const Token& tok) {
+    // Out of room, so double the ring and put every token back in its new slot
+    if (end_ - first_ == ring_.size()) {
+        std::vector<Token> old = std::move(ring_);
+        ring_ = std::vector<Token>(old.size() * 2);
+        for (size_t i = first_; i < end_; i++)
+            slot(i) = old[i & (old.size() - 1)];
+    }
+
+    slot(end_) = tok;
+    end_++;
+}
+
+// Pulls the next token out of the lexer, moving on to the next file when this one is done.
+// Returns false once there is nothing left to read.
+bool TokenStream::read_more() {
+    if (finished_)
+        return false;
+
+    const Token tok = lexer_->pull();
+
+    if (tok.val() == TOK_EOF) {
+        for (const salt::Error& e : lexer_->errors())
+            salt::dbout << e.str() << std::endl;
+
+        // Only the last file's EOF makes it to the parser
+        if (next_file_ < files_.size()) {
+            open_next_file();
+            return true;
+        }
+        finished_ = true;
+    }
+
+    push(tok);
+    return true;
+}
+
+const Token& TokenStream::operator[](size_t idx) {
+    if (idx < first_)
+        salt::print_fatal(salt::f_string("TokenStream: token %d was already released", static_cast<int>(idx)));
+
+    while (idx >= end_ && read_more())
+        ;
+
+    // Past the end we keep handing out the EOF
+    if (idx >= end_)
+        return slot(end_ - 1);
+
+    return slot(idx);
+}
+
+void TokenStream::release_before(size_t idx) {
+    // --tokvec keeps everything around, so it can be looked at
+    if (whole_file_)
+        return;
+
+    first_ = std::max(first_, std::min(idx, end_));
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "tokens.h"
+#include "../common.h"
+#include <vector>
+#include <string>
+#include <memory>
+
+class Lexer;
+
+// Where the Parser gets its tokens from. Tokens are indexed from the start of the
+// first file, like they were in the old token vector, and the files are read one
+// after another as if they were a single file.
+//
+// By default tokens are pulled from the Lexer as the parser reaches them and kept
+// in a ring buffer, which the parser empties with release_before() whenever it starts
+// on a new function. That way we only ever hold the tokens of the longest function.
+// With whole_file set, every file is tokenized up front instead (--tokvec), which is
+// easier to look at in a debugger.
+class TokenStream {
+private:
+    std::vector<std::string> files_;
+    std::unique_ptr<Lexer> lexer_;  // reading the file before next_file_
+    size_t next_file_;
+    bool whole_file_;
+    bool finished_;                 // the EOF of the last file has been read
+
+    std::vector<Token> ring_;       // size is always a power of 2
+    size_t first_;                  // index of the oldest token we still have
+    size_t end_;                    // one past the newest token we have
+
+    Token& slot(size_t idx) { return ring_[idx & (ring_.size() - 1)]; }
+    void open_next_file();
+    void push(const Token& tok);
+    bool read_more();
+
+public:
+    TokenStream(const std::vector<std::string>& files, bool whole_file = false);
+
+    // Reads text as if it was the file called name, for editors that have changes that aren't saved yet
+    TokenStream(const std::string& name, std::string text);
+    ~TokenStream();
+
+    // Reads up to idx if we haven't yet. Past the end of the last file this is its EOF token.
+    // References are only good until the next call, since the ring buffer may grow.
+    const Token& operator[](size_t idx);
+
+    // The parser won't go back to anything before idx anymore
+    void release_before(size_t idx);
+
+    // How many tokens we are holding on to right now, and how many we have room for
+    size_t buffered() const { return end_ - first_; }
+    size_t capacity() const { return ring_.size(); }
+};
@@ -120,7 +120,7 @@ bool TypeInstance::operator==(const TypeInstance& other) const {
 }
 
 TypeInstance::TypeInstance(const Token& tok) {
-	const salt::Type* type_or_pointee = salt::all_types[tok.data()];
+	const salt::Type* type_or_pointee = salt::all_types[std::string(tok.data())];
 	if (!type_or_pointee) {
 		*this = SALT_TYPE_ERROR;
 		return;
@@ -0,0 +1,240 @@
+#pragma once
+#include "testing.h"
+#include "../frontend/parser.h"
+#include "../frontend/astcache.h"
+#include "../frontend/types.h"
+#include <filesystem>
+#include <set>
+
+namespace {
+	using namespace SaltTest;
+	using namespace salt;
+
+	// Has every kind of node the cache can store, and an extern and a const fn
+	const char* const T_ASTCACHE_TEXT =
+		"extern fn puts(char* s) -> int\n\n"
+		"const fn helper(long a, double b) -> long:\n"
+		"    return a + 1\n\n"
+		"fn kinds(long x, char* p) -> long:\n"
+		"    long y = -x * 3 + helper(x, 2.5)\n"
+		"    y = if x > 2 then x else -x\n"
+		"    y = *p as long\n"
+		"    puts(\"hello\")\n"
+		"    y = !y\n"
+		"    y = y << 2 >> 1\n"
+		"    return y\n";
+
+	const ExprKind T_ASTCACHE_KINDS[] = {
+		ExprKind::Val, ExprKind::Variable, ExprKind::Binary, ExprKind::Unary, ExprKind::Call,
+		ExprKind::If, ExprKind::Type, ExprKind::Deref, ExprKind::Return, ExprKind::NewVariable,
+	};
+
+	bool same_type_instance(const TypeInstance& a, const TypeInstance& b) {
+		return a.type == b.type && a.pointee == b.pointee && a.ptr_layers == b.ptr_layers;
+	}
+}
+
+static class t_astcache : public TestGroup {
+	// Everything the serializer writes has to come back, down to the line and column of every node
+	static bool same_tree(Expression a, Expression b, std::set<ExprKind>& kinds) {
+		if (!a || !b)
+			return a == b;
+		if (a->kind() != b->kind() || a->line() != b->line() || a->col() != b->col()
+			|| !same_type_instance(a->type_instance(), b->type_instance()))
+			return false;
+		kinds.insert(a->kind());
+
+		switch (a->kind()) {
+		case ExprKind::Val: {
+			ValExprAST* val_a = llvm::cast<ValExprAST>(a);
+			ValExprAST* val_b = llvm::cast<ValExprAST>(b);
+			if (val_a->to_int() != val_b->to_int() || val_a->to_double() != val_b->to_double() || val_a->str() != val_b->str())
+				return false;
+			break;
+		}
+		case ExprKind::Variable:
+			if (llvm::cast<VariableExprAST>(a)->name() != llvm::cast<VariableExprAST>(b)->name())
+				return false;
+			break;
+		case ExprKind::Binary:
+			if (llvm::cast<BinaryExprAST>(a)->op() != llvm::cast<BinaryExprAST>(b)->op())
+				return false;
+			break;
+		case ExprKind::Unary:
+			if (llvm::cast<UnaryExprAST>(a)->op() != llvm::cast<UnaryExprAST>(b)->op())
+				return false;
+			break;
+		case ExprKind::Call:
+			if (llvm::cast<CallExprAST>(a)->callee() != llvm::cast<CallExprAST>(b)->callee())
+				return false;
+			break;
+		case ExprKind::Return:
+			if (!same_type_instance(llvm::cast<ReturnAST>(a)->expected_return_type, llvm::cast<ReturnAST>(b)->expected_return_type))
+				return false;
+			break;
+		default:
+			break;
+		}
+
+		std::vector<Expression> children_a;
+		std::vector<Expression> children_b;
+		a->children(children_a);
+		b->children(children_b);
+		if (children_a.size() != children_b.size())
+			return false;
+		for (size_t i = 0; i < children_a.size(); i++)
+			if (!same_tree(children_a[i], children_b[i], kinds))
+				return false;
+		return true;
+	}
+
+	static bool same_declaration(DeclarationAST* a, DeclarationAST* b, std::set<ExprKind>& kinds) {
+		if (a->name() != b->name() || a->line() != b->line() || a->col() != b->col()
+			|| !same_type_instance(a->type_instance(), b->type_instance()) || a->is_const() != b->is_const()
+			|| a->args().size() != b->args().size())
+			return false;
+		for (size_t i = 0; i < a->args().size(); i++)
+			if (!same_tree(a->args()[i], b->args()[i], kinds))
+				return false;
+		return true;
+	}
+
+	static bool same_unit(const TranslationUnitAST& a, const TranslationUnitAST& b, std::set<ExprKind>& kinds) {
+		if (a.declarations.size() != b.declarations.size() || a.functions.size() != b.functions.size())
+			return false;
+		for (size_t i = 0; i < a.declarations.size(); i++)
+			if (!same_declaration(a.declarations[i], b.declarations[i], kinds))
+				return false;
+
+		for (size_t i = 0; i < a.functions.size(); i++) {
+			FunctionAST* fn_a = a.functions[i];
+			FunctionAST* fn_b = b.functions[i];
+			if (!same_declaration(fn_a->decl(), fn_b->decl(), kinds) || fn_a->body().size() != fn_b->body().size())
+				return false;
+			for (size_t j = 0; j < fn_a->body().size(); j++)
+				if (!same_tree(fn_a->body()[j], fn_b->body()[j], kinds))
+					return false;
+		}
+		return true;
+	}
+
+	static Result<TranslationUnitAST> parse_file(const std::string& file_name, AstArena& arena) {
+		BufferedDiagnosticSink diagnostics;
+		Parser parser = Parser(file_name, diagnostics, arena);
+		parser.parse();
+		if (diagnostics.error_count() || diagnostics.warning_count())
+			return Error("the test source doesn't parse cleanly");
+		TranslationUnitAST unit = parser.unit();
+		return unit;
+	}
+
+	// The cache file that appeared in dir since known was filled in, or "" if there isn't exactly one
+	static std::string new_cache_file(const std::filesystem::path& dir, std::set<std::string>& known) {
+		std::string res;
+		for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+			const std::string path = entry.path().string();
+			if (entry.path().extension() != ".ast" || known.count(path))
+				continue;
+			if (!res.empty())
+				return "";
+			res = path;
+		}
+		known.insert(res);
+		return res;
+	}
+
+	// Every node is stored and loaded back the same, into another arena
+	static TestResult test_round_trip() {
+		salt::fill_types();
+		const std::filesystem::path dir = std::filesystem::temp_directory_path() / "salt_t_astcache_round_trip";
+		std::filesystem::remove_all(dir);
+		const std::string source = (dir / "kinds.sl").string();
+		if (!salt::write_file_atomic(source, T_ASTCACHE_TEXT))
+			return TestResult(FAIL, "could not write " + source);
+
+		AstArena arena;
+		Result<TranslationUnitAST> parsed = parse_file(source, arena);
+		if (!parsed)
+			return TestResult(FAIL, parsed.unwrap_err().message());
+		const TranslationUnitAST unit = parsed.unwrap();
+
+		AstCache cache = AstCache((dir / "cache").string(), 1);
+		cache.store(source, unit);
+		AstArena loaded_arena;
+		TranslationUnitAST loaded;
+		const bool hit = cache.load(source, loaded_arena, loaded);
+		std::filesystem::remove_all(dir);
+		if (!hit)
+			return TestResult(FAIL, "the stored AST wasn't loaded");
+
+		std::set<ExprKind> kinds;
+		if (!same_unit(unit, loaded, kinds))
+			return TestResult(FAIL, "the loaded AST isn't the one that was stored");
+		for (ExprKind kind : T_ASTCACHE_KINDS)
+			if (!kinds.count(kind))
+				return TestResult(FAIL, f_string("the test source has no node of ExprKind %d", int(kind)));
+		return PASS;
+	}
+
+	// A cache file that was cut short, or that was made for other source text, is a miss and leaves nothing behind
+	static TestResult test_bad_files_rejected() {
+		salt::fill_types();
+		const std::filesystem::path dir = std::filesystem::temp_directory_path() / "salt_t_astcache_bad_files";
+		std::filesystem::remove_all(dir);
+		const std::string source_a = (dir / "a.sl").string();
+		const std::string source_b = (dir / "b.sl").string();
+		const std::filesystem::path cache_dir = dir / "cache";
+		if (!salt::write_file_atomic(source_a, T_ASTCACHE_TEXT)
+			|| !salt::write_file_atomic(source_b, std::string(T_ASTCACHE_TEXT) + "\nfn other() -> long:\n    return 1\n"))
+			return TestResult(FAIL, "could not write the test sources");
+
+		AstArena arena;
+		Result<TranslationUnitAST> parsed_a = parse_file(source_a, arena);
+		Result<TranslationUnitAST> parsed_b = parse_file(source_b, arena);
+		if (!parsed_a || !parsed_b)
+			return TestResult(FAIL, "the test sources don't parse cleanly");
+
+		AstCache cache = AstCache(cache_dir.string(), 1);
+		std::set<std::string> known;
+		cache.store(source_a, parsed_a.unwrap());
+		const std::string file_a = new_cache_file(cache_dir, known);
+		cache.store(source_b, parsed_b.unwrap());
+		const std::string file_b = new_cache_file(cache_dir, known);
+
+		std::string data_a;
+		if (file_a.empty() || file_b.empty() || !salt::read_file(file_a, data_a)) {
+			std::filesystem::remove_all(dir);
+			return TestResult(FAIL, "storing didn't make one cache file per source");
+		}
+
+		// b's file with a's (whole and valid) AST in it, and a's cut in half
+		salt::write_file_atomic(file_b, data_a);
+		salt::write_file_atomic(file_a, data_a.substr(0, data_a.size() / 2));
+
+		AstArena loaded_arena;
+		TranslationUnitAST truncated;
+		TranslationUnitAST wrong_key;
+		const bool truncated_hit = cache.load(source_a, loaded_arena, truncated);
+		const bool wrong_key_hit = cache.load(source_b, loaded_arena, wrong_key);
+		std::filesystem::remove_all(dir);
+
+		if (truncated_hit || !truncated.declarations.empty() || !truncated.functions.empty())
+			return TestResult(FAIL, "a truncated cache file was loaded");
+		if (wrong_key_hit || !wrong_key.declarations.empty() || !wrong_key.functions.empty())
+			return TestResult(FAIL, "a cache file made for other source text was loaded");
+		return test_for(cache.misses() == 2 && cache.hits() == 0, "expected two misses and no hits");
+	}
+
+	void register_tests() override {
+		REGISTER_TEST(t_astcache::test_round_trip);
+		REGISTER_TEST(t_astcache::test_bad_files_rejected);
+	}
+
+	const char* name() override {
+		return "t_astcache";
+	}
+};
+
+void add_t_astcache() {
+	ADD_TEST_GROUP(t_astcache);
+}
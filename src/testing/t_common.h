@@ -98,7 +98,7 @@ static class t_common : public TestGroup {
 	// Assert that OK results evaluate to true, and ERR results evaluate to false.
 	static TestResult test_Result_bool() {
 		Result<void> ok = Result<void>(Result_e::OK);
-		Result<int> err = Result<int>(Result_e::ERR, Exception("testception"));
+		Result<int> err = Result<int>(Result_e::ERR, Error("testception"));
 		return test_for(
 			bool(ok) == true &&
 			bool(ok) != false &&
@@ -168,6 +168,20 @@ static class t_common : public TestGroup {
 
 	}
 
+	// Assert that an Error made from a std::string keeps its message after the string (and the first Error) are gone.
+	static TestResult test_Error_owned_message() {
+		Error copy = Error("placeholder");
+		{
+			std::string message = f_string("function %s does not exist", "f");
+			Error err = Error(message, ErrorCode::TYPE, 3, 4);
+			message.assign(message.size(), 'x');
+			copy = err.at(5, 6);
+		}
+
+		return test_for(copy.str("t.sl") == "t.sl - 5:6: function f does not exist" && copy.code() == ErrorCode::TYPE,
+			f_string("the message of a copied Error changed to \"%s\"", copy.str("t.sl").c_str()));
+	}
+
 	void register_tests() override {
 		REGISTER_TEST(t_common::test_atoi);
 		REGISTER_TEST(t_common::test_vec_to_str);
@@ -176,6 +190,7 @@ static class t_common : public TestGroup {
 		REGISTER_TEST(t_common::test_Result_unwrap_or);
 		REGISTER_TEST(t_common::test_Result_unwrap);
 		REGISTER_TEST(t_common::test_Result_wrap);
+		REGISTER_TEST(t_common::test_Error_owned_message);
 	}
 
 	const char* name() override {
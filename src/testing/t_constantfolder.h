@@ -0,0 +1,181 @@
+#pragma once
+#include "testing.h"
+#include "../frontend/parser.h"
+#include "../frontend/sema.h"
+#include "../frontend/constantfolder.h"
+#include "../frontend/types.h"
+#include <cmath>
+
+namespace {
+	using namespace SaltTest;
+	using namespace salt;
+
+	// One fn per expression, each returning it, so every folded value is the return value of its own fn
+	struct FoldCase {
+		const char* type;
+		const char* expr;
+	};
+}
+
+static class t_constantfolder : public TestGroup {
+	// Parses, checks and folds the fns, then gives what each of them returns.
+	// Fails the test if the source isn't clean, the cases are wrong then and not the folder
+	static Result<std::vector<Expression>> fold_returns(const std::vector<FoldCase>& cases, AstArena& arena) {
+		salt::fill_types();
+		std::string text;
+		for (size_t i = 0; i < cases.size(); i++)
+			text += "fn f" + std::to_string(i) + "(long x) -> " + cases[i].type + ":\n    return " + cases[i].expr + "\n\n";
+
+		BufferedDiagnosticSink diagnostics;
+		TranslationUnitAST unit;
+		{
+			Parser parser = Parser("t_constantfolder.sl", text, diagnostics, arena);
+			parser.parse();
+			unit = parser.unit();
+		}
+		if (!diagnostics.has_errors())
+			Sema("t_constantfolder.sl", diagnostics, arena).check(unit);
+		if (diagnostics.has_errors())
+			return Error("the test source has errors");
+		ConstantFolder("t_constantfolder.sl", diagnostics, arena).fold(unit);
+
+		std::vector<Expression> returns;
+		for (FunctionAST* fn : unit.functions)
+			returns.push_back(llvm::cast<ReturnAST>(fn->body().back())->return_val);
+		return returns;
+	}
+
+	// Every case has to fold into a constant of its type with the expected bits
+	static TestResult check_ints(const std::vector<FoldCase>& cases, const std::vector<int64_t>& expected) {
+		AstArena arena;
+		Result<std::vector<Expression>> res = fold_returns(cases, arena);
+		if (!res)
+			return TestResult(FAIL, res.unwrap_err().message());
+
+		const std::vector<Expression> returns = res.unwrap();
+		for (size_t i = 0; i < cases.size(); i++) {
+			ValExprAST* val = llvm::dyn_cast<ValExprAST>(returns[i]);
+			if (!val)
+				return TestResult(FAIL, f_string("%s wasn't folded", cases[i].expr));
+			if (val->type()->name != cases[i].type || val->to_int() != expected[i])
+				return TestResult(FAIL, f_string("%s folded to the %s %lld, expected the %s %lld", cases[i].expr,
+					val->type()->name.c_str(), (long long) val->to_int(), cases[i].type, (long long) expected[i]));
+		}
+		return PASS;
+	}
+
+	// Signed and unsigned ops of the same width give different results
+	static TestResult test_signedness() {
+		return check_ints({
+			{ "long",   "-7 / 2" },
+			{ "ulong",  "(-7 as ulong) / (2 as ulong)" },
+			{ "long",   "-7 % 2" },
+			{ "ulong",  "(-7 as ulong) % (2 as ulong)" },
+			{ "long",   "-8 >> 1" },
+			{ "ulong",  "(-8 as ulong) >> (1 as ulong)" },
+			{ "bool",   "-1 < 1" },
+			{ "bool",   "(-1 as ulong) < (1 as ulong)" },
+			{ "bool",   "(-1 as uint) > (1 as uint)" },
+		}, {
+			-3,
+			int64_t(0x7ffffffffffffffcull),
+			-1,
+			1,
+			-4,
+			int64_t(0x7ffffffffffffffcull),
+			1,
+			0,
+			1,
+		});
+	}
+
+	// Narrower types wrap, and come back extended by their own signedness
+	static TestResult test_narrowing() {
+		return check_ints({
+			{ "int",    "4294967297" },         // through an ImplicitCastExprAST from long
+			{ "int",    "2147483648" },
+			{ "uint",   "-1" },
+			{ "char",   "300" },
+			{ "int",    "(2147483647 as int) + (1 as int)" },
+		}, {
+			1,
+			-2147483648ll,
+			4294967295ll,
+			44,
+			-2147483648ll,
+		});
+	}
+
+	// Compared with 0 like code_gen() does (fcmp one), so NaN is false too
+	static TestResult test_to_bool() {
+		return check_ints({
+			{ "bool",   "7 as bool" },
+			{ "bool",   "0 as bool" },
+			{ "bool",   "0.5 as bool" },
+			{ "bool",   "0.0 as bool" },
+			{ "bool",   "nan as bool" },
+		}, { 1, 0, 1, 0, 0 });
+	}
+
+	// What would trap or be poison at runtime stays for the runtime
+	static TestResult test_left_unfolded() {
+		const std::vector<FoldCase> cases = {
+			{ "long",   "7 / 0" },
+			{ "long",   "7 % 0" },
+			{ "long",   "(-9223372036854775807 - 1) / -1" },
+			{ "int",    "(-2147483648 as int) % (-1 as int)" },
+			{ "long",   "1 << 64" },
+			{ "int",    "(1 as int) << (32 as int)" },
+			{ "long",   "1 >> -1" },
+		};
+
+		AstArena arena;
+		Result<std::vector<Expression>> res = fold_returns(cases, arena);
+		if (!res)
+			return TestResult(FAIL, res.unwrap_err().message());
+
+		const std::vector<Expression> returns = res.unwrap();
+		for (size_t i = 0; i < cases.size(); i++)
+			if (llvm::isa<ValExprAST>(returns[i]))
+				return TestResult(FAIL, f_string("%s was folded", cases[i].expr));
+		return PASS;
+	}
+
+	// A constant condition leaves only the arm that is taken, even if that arm isn't constant
+	static TestResult test_constant_if() {
+		const std::vector<FoldCase> cases = {
+			{ "long",   "if 1 > 2 then 10 else 20" },
+			{ "long",   "if 1 < 2 then x else 5" },
+			{ "long",   "if x > 2 then 10 else 20" },
+		};
+
+		AstArena arena;
+		Result<std::vector<Expression>> res = fold_returns(cases, arena);
+		if (!res)
+			return TestResult(FAIL, res.unwrap_err().message());
+
+		const std::vector<Expression> returns = res.unwrap();
+		ValExprAST* folded = llvm::dyn_cast<ValExprAST>(returns[0]);
+		if (!folded || folded->to_int() != 20)
+			return TestResult(FAIL, "if 1 > 2 then 10 else 20 wasn't folded to 20");
+		if (!llvm::isa<VariableExprAST>(returns[1]))
+			return TestResult(FAIL, "if 1 < 2 then x else 5 wasn't replaced by x");
+		return test_for(llvm::isa<IfExprAST>(returns[2]), "an if without a constant condition was folded");
+	}
+
+	void register_tests() override {
+		REGISTER_TEST(t_constantfolder::test_signedness);
+		REGISTER_TEST(t_constantfolder::test_narrowing);
+		REGISTER_TEST(t_constantfolder::test_to_bool);
+		REGISTER_TEST(t_constantfolder::test_left_unfolded);
+		REGISTER_TEST(t_constantfolder::test_constant_if);
+	}
+
+	const char* name() override {
+		return "t_constantfolder";
+	}
+};
+
+void add_t_constantfolder() {
+	ADD_TEST_GROUP(t_constantfolder);
+}
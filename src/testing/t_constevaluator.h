@@ -0,0 +1,144 @@
+#pragma once
+#include "testing.h"
+#include "../frontend/parser.h"
+#include "../frontend/sema.h"
+#include "../frontend/constantfolder.h"
+#include "../frontend/types.h"
+
+namespace {
+	using namespace SaltTest;
+	using namespace salt;
+
+	// Keeps the messages, so a test can look for the one it expects
+	class RecordingDiagnosticSink : public DiagnosticSink {
+	public:
+		std::vector<std::string> messages;
+
+		bool any_contains(const std::string& part) const {
+			for (const std::string& message : messages)
+				if (message.find(part) != std::string::npos)
+					return true;
+			return false;
+		}
+
+	protected:
+		void emit(DiagnosticLevel, const std::string& message) override {
+			messages.push_back(message);
+		}
+	};
+}
+
+static class t_constevaluator : public TestGroup {
+	// Parses, checks and folds text, then gives what its first fn that isn't const returns
+	static Result<Expression> fold_first_return(const std::string& text, RecordingDiagnosticSink& diagnostics,
+		AstArena& arena, ConstEvalLimits limits = {}) {
+		salt::fill_types();
+		TranslationUnitAST unit;
+		{
+			Parser parser = Parser("t_constevaluator.sl", text, diagnostics, arena);
+			parser.parse();
+			unit = parser.unit();
+		}
+		if (!diagnostics.has_errors())
+			Sema("t_constevaluator.sl", diagnostics, arena).check(unit);
+		if (diagnostics.has_errors())
+			return Error("the test source has errors");
+		ConstantFolder("t_constevaluator.sl", diagnostics, arena, limits).fold(unit);
+
+		for (FunctionAST* fn : unit.functions) {
+			if (!fn->decl()->is_const()) {
+				Expression res = llvm::cast<ReturnAST>(fn->body().back())->return_val;
+				return res;
+			}
+		}
+		return Error("the test source has no fn that isn't const");
+	}
+
+	// The call has to be replaced by the long it returns, without anything to say about it
+	static TestResult check_folds_to(const std::string& text, int64_t expected) {
+		RecordingDiagnosticSink diagnostics;
+		AstArena arena;
+		Result<Expression> res = fold_first_return(text, diagnostics, arena);
+		if (!res)
+			return TestResult(FAIL, res.unwrap_err().message());
+		if (!diagnostics.messages.empty())
+			return TestResult(FAIL, "folding said " + diagnostics.messages[0]);
+
+		ValExprAST* val = llvm::dyn_cast<ValExprAST>(res.unwrap());
+		if (!val)
+			return TestResult(FAIL, "the call wasn't folded");
+		return test_for(val->to_int() == expected,
+			f_string("the call folded to %lld instead of %lld", (long long) val->to_int(), (long long) expected));
+	}
+
+	// Recursing forever has to stop at a limit with an error instead of hanging or taking the compiler's stack with it
+	static TestResult check_runs_into(ConstEvalLimits limits, const std::string& flag) {
+		RecordingDiagnosticSink diagnostics;
+		AstArena arena;
+		Result<Expression> res = fold_first_return(
+			"const fn forever(long n) -> long:\n    return forever(n + 1)\n\n"
+			"fn main() -> long:\n    return forever(0)\n",
+			diagnostics, arena, limits);
+		if (!res)
+			return TestResult(FAIL, res.unwrap_err().message());
+		if (!diagnostics.any_contains(flag))
+			return TestResult(FAIL, "no error mentions " + flag);
+		return test_for(diagnostics.error_count() == 1, "expected exactly one error");
+	}
+
+	static TestResult test_recursive() {
+		return check_folds_to(
+			"const fn fib(long n) -> long:\n    return if n < 2 then n else fib(n - 1) + fib(n - 2)\n\n"
+			"fn main() -> long:\n    return fib(20)\n",
+			6765);
+	}
+
+	static TestResult test_calls_const_fn() {
+		return check_folds_to(
+			"const fn square(long x) -> long:\n    return x * x\n\n"
+			"const fn sum_of_squares(long a, long b) -> long:\n    long res = square(a)\n    res = res + square(b)\n    return res\n\n"
+			"fn main() -> long:\n    return sum_of_squares(3, 4)\n",
+			25);
+	}
+
+	static TestResult test_steps_limit() {
+		return check_runs_into({ 10000, 16 << 20 }, "--const-eval-steps");
+	}
+
+	static TestResult test_memory_limit() {
+		return check_runs_into({ uint64_t(1) << 40, 4096 }, "--const-eval-memory");
+	}
+
+	// Dividing by zero is only a problem if it ever runs, so that's left for the runtime with a warning
+	static TestResult test_ub_left_for_runtime() {
+		RecordingDiagnosticSink diagnostics;
+		AstArena arena;
+		Result<Expression> res = fold_first_return(
+			"const fn div(long a, long b) -> long:\n    return a / b\n\n"
+			"fn main() -> long:\n    return div(10, 0)\n",
+			diagnostics, arena);
+		if (!res)
+			return TestResult(FAIL, res.unwrap_err().message());
+		if (diagnostics.has_errors() || diagnostics.warning_count() != 1)
+			return TestResult(FAIL, "expected one warning and no errors");
+		if (!diagnostics.any_contains("div is left to be called at runtime"))
+			return TestResult(FAIL, "the warning doesn't say the call is left for the runtime");
+		return test_for(llvm::isa<CallExprAST>(res.unwrap()), "the call was replaced");
+	}
+
+	void register_tests() override {
+		REGISTER_TEST(t_constevaluator::test_recursive);
+		REGISTER_TEST(t_constevaluator::test_calls_const_fn);
+		REGISTER_TEST(t_constevaluator::test_steps_limit);
+		REGISTER_TEST(t_constevaluator::test_memory_limit);
+		REGISTER_TEST(t_constevaluator::test_ub_left_for_runtime);
+	}
+
+	const char* name() override {
+		return "t_constevaluator";
+	}
+};
+
+void add_t_constevaluator() {
+	ADD_TEST_GROUP(t_constevaluator);
+}
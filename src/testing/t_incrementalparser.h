@@ -0,0 +1,110 @@
+#pragma once
+#include "testing.h"
+#include "../frontend/incrementalparser.h"
+#include "../frontend/types.h"
+
+namespace {
+	using namespace SaltTest;
+	using namespace salt;
+	const int T_INCREMENTAL_FUNCTIONS = 4;
+}
+
+static class t_incrementalparser : public TestGroup {
+	// Functions of 3 lines and a blank one each, so f<i> starts at line 4 * i + 1.
+	// The edited one gets an extra statement, which moves everything after it down a line
+	static std::string make_text(int edited = -1, const char* last_return_type = "long", const char* last_arg_type = "long") {
+		std::string text;
+		for (int i = 0; i < T_INCREMENTAL_FUNCTIONS; i++) {
+			const bool last = i == T_INCREMENTAL_FUNCTIONS - 1;
+			text += "fn f" + std::to_string(i) + "(" + (last ? last_arg_type : "long") + " x) -> " + (last ? last_return_type : "long") + ":\n";
+			text += "    long y = x * " + std::to_string(i + 2) + '\n';
+			if (i == edited)
+				text += "    y = y + 1\n";
+			text += "    return y\n\n";
+		}
+		return text;
+	}
+
+	// Only the edited function is parsed again, the ones below it keep their AST with the lines moved
+	static TestResult test_edit_one_function() {
+		salt::fill_types();
+		IncrementalParser parser = IncrementalParser("t_incrementalparser.sl");
+		BufferedDiagnosticSink diagnostics;
+
+		parser.update(make_text(), diagnostics);
+		if (parser.reparsed() != T_INCREMENTAL_FUNCTIONS || parser.reused() != 0)
+			return TestResult(FAIL, f_string("first update: %d reparsed and %d reused, expected all to be parsed",
+				int(parser.reparsed()), int(parser.reused())));
+		FunctionAST* const last = parser.unit().functions.back();
+
+		parser.update(make_text(1), diagnostics);
+		if (diagnostics.error_count() || diagnostics.warning_count())
+			return TestResult(FAIL, "the test text came with errors or warnings");
+		if (parser.reparsed() != 1 || parser.reused() != T_INCREMENTAL_FUNCTIONS - 1)
+			return TestResult(FAIL, f_string("after editing f1: %d reparsed and %d reused, expected 1 and %d",
+				int(parser.reparsed()), int(parser.reused()), T_INCREMENTAL_FUNCTIONS - 1));
+
+		const std::vector<FunctionAST*>& functions = parser.unit().functions;
+		if (functions.back() != last)
+			return TestResult(FAIL, "the last function wasn't reused");
+		for (int i = 0; i < T_INCREMENTAL_FUNCTIONS; i++) {
+			const int expected_line = 4 * i + 1 + (i > 1);
+			if (functions[i]->decl()->line() != expected_line || functions[i]->body()[0]->line() != expected_line + 1)
+				return TestResult(FAIL, f_string("f%d is at line %d (its first statement at %d), expected %d",
+					i, functions[i]->decl()->line(), functions[i]->body()[0]->line(), expected_line));
+		}
+
+		return PASS;
+	}
+
+	// A changed signature could change the types of calls in the other functions, so nothing is reused
+	static TestResult test_signature_change() {
+		salt::fill_types();
+		IncrementalParser parser = IncrementalParser("t_incrementalparser.sl");
+		BufferedDiagnosticSink diagnostics;
+
+		parser.update(make_text(), diagnostics);
+		parser.update(make_text(-1, "int"), diagnostics);
+		if (parser.reparsed() != T_INCREMENTAL_FUNCTIONS || parser.reused() != 0)
+			return TestResult(FAIL, f_string("after a return type change: %d reparsed and %d reused, expected all to be parsed",
+				int(parser.reparsed()), int(parser.reused())));
+
+		parser.update(make_text(-1, "int", "int"), diagnostics);
+		if (parser.reparsed() != T_INCREMENTAL_FUNCTIONS || parser.reused() != 0)
+			return TestResult(FAIL, f_string("after an argument type change: %d reparsed and %d reused, expected all to be parsed",
+				int(parser.reparsed()), int(parser.reused())));
+
+		return PASS;
+	}
+
+	// Sema checks every function, so a type error in one that was reused is still reported
+	static TestResult test_type_error_in_reused_function() {
+		salt::fill_types();
+		IncrementalParser parser = IncrementalParser("t_incrementalparser.sl");
+		BufferedDiagnosticSink diagnostics;
+		const std::string text = make_text() + "fn broken(long x) -> long:\n    return nope(x)\n";
+
+		parser.update(text, diagnostics);
+		parser.update(text, diagnostics);
+		if (parser.reused() != T_INCREMENTAL_FUNCTIONS + 1)
+			return TestResult(FAIL, f_string("%d functions reused, expected %d", int(parser.reused()), T_INCREMENTAL_FUNCTIONS + 1));
+		if (diagnostics.error_count() != 2)
+			return TestResult(FAIL, f_string("%d errors after 2 updates, expected one each time", diagnostics.error_count()));
+
+		return PASS;
+	}
+
+	void register_tests() override {
+		REGISTER_TEST(t_incrementalparser::test_edit_one_function);
+		REGISTER_TEST(t_incrementalparser::test_signature_change);
+		REGISTER_TEST(t_incrementalparser::test_type_error_in_reused_function);
+	}
+
+	const char* name() override {
+		return "t_incrementalparser";
+	}
+};
+
+void add_t_incrementalparser() {
+	ADD_TEST_GROUP(t_incrementalparser);
+}
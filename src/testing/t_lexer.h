@@ -0,0 +1,108 @@
+#pragma once
+#include "testing.h"
+#include "../frontend/lexer.h"
+#include "../frontend/types.h"
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <filesystem>
+
+namespace {
+	using namespace SaltTest;
+	using namespace salt;
+	const int T_LEXER_FILES = 64;
+	const int T_LEXER_FUNCTIONS_PER_FILE = 200;
+}
+
+static class t_lexer : public TestGroup {
+	// Writes a few files full of functions that use most of the things the lexer knows about.
+	// Every file is a little different, so mixing up two files would show.
+	static std::vector<std::string> write_test_files() {
+		std::vector<std::string> file_names;
+		const std::filesystem::path dir = std::filesystem::temp_directory_path();
+
+		for (int i = 0; i < T_LEXER_FILES; i++) {
+			const std::string file_name = (dir / ("salt_t_lexer_" + std::to_string(i) + ".sl")).string();
+			std::ofstream out = std::ofstream(file_name, std::ios::binary);
+			out << "# file " << i << '\n';
+			for (int j = 0; j < T_LEXER_FUNCTIONS_PER_FILE; j++) {
+				out << "fn f" << i << '_' << j << "(int a, long b, char* s) -> long:\n"
+					<< "    long x = a + b * " << (i * 1000 + j) << "  # comment " << j << '\n'
+					<< "    double y = 3.14 * x - 0x1F\n"
+					<< "    print(\"file " << i << " function " << j << "\")\n"
+					<< "\tx = if x == 2 then -x else x << 2\n"
+					<< "    x >>= 1\n"
+					<< "    unsigned int u = 'c' as unsigned int\n"
+					<< "    return x\n\n";
+			}
+			file_names.push_back(file_name);
+		}
+
+		return file_names;
+	}
+
+	// Everything about a token that doesn't depend on where its file ended up in the SourceManager
+	static std::vector<std::string> describe(const std::vector<Token>& tokens) {
+		std::vector<std::string> res;
+		res.reserve(tokens.size());
+		for (const Token& tok : tokens)
+			res.push_back(std::to_string(tok.val()) + ' ' + std::string(tok.data()) + ' ' + std::to_string(tok.count()) + ' '
+				+ std::to_string(tok.starts_line() ? tok.indent() : -1) + ' ' + std::to_string(tok.line()) + ':' + std::to_string(tok.col()));
+		return res;
+	}
+
+	// Lex the same files one after another and then all at once on a bunch of threads,
+	// every file must come out the same either way.
+	static TestResult test_concurrent_lexing() {
+		salt::fill_types();
+		const std::vector<std::string> files = write_test_files();
+
+		std::vector<std::vector<std::string>> serial(files.size());
+		for (size_t i = 0; i < files.size(); i++)
+			serial[i] = describe(tokenize(files[i].c_str()));
+
+		std::vector<std::vector<std::string>> concurrent(files.size());
+		std::atomic<size_t> next_file = 0;
+		std::vector<std::thread> pool;
+		const unsigned thread_count = std::max(4u, std::thread::hardware_concurrency());
+
+		for (unsigned t = 0; t < thread_count; t++)
+			pool.emplace_back([&]() {
+				for (size_t i = next_file++; i < files.size(); i = next_file++) {
+					Lexer lexer;
+					concurrent[i] = describe(lexer.tokenize(files[i].c_str()));
+				}
+			});
+
+		for (std::thread& thread : pool)
+			thread.join();
+
+		for (const std::string& file_name : files)
+			std::filesystem::remove(file_name);
+
+		for (size_t i = 0; i < files.size(); i++) {
+			if (serial[i].size() != concurrent[i].size())
+				return TestResult(FAIL, f_string("%s: %d tokens when lexed alone, %d when lexed concurrently",
+					files[i].c_str(), int(serial[i].size()), int(concurrent[i].size())));
+
+			for (size_t j = 0; j < serial[i].size(); j++)
+				if (serial[i][j] != concurrent[i][j])
+					return TestResult(FAIL, f_string("%s: token %d differs: \"%s\" when lexed alone, \"%s\" when lexed concurrently",
+						files[i].c_str(), int(j), serial[i][j].c_str(), concurrent[i][j].c_str()));
+		}
+
+		return PASS;
+	}
+
+	void register_tests() override {
+		REGISTER_TEST(t_lexer::test_concurrent_lexing);
+	}
+
+	const char* name() override {
+		return "t_lexer";
+	}
+};
+
+void add_t_lexer() {
+	ADD_TEST_GROUP(t_lexer);
+}
@@ -5,6 +5,11 @@
 #include <csignal>
 #include "t_common.h"
 #include "t_testing.h"
+#include "t_lexer.h"
+#include "t_incrementalparser.h"
+#include "t_constantfolder.h"
+#include "t_constevaluator.h"
+#include "t_astcache.h"
 
 using namespace SaltTest;
 using namespace salt;
@@ -20,9 +25,19 @@ namespace chrono = std::chrono;
 
 std::vector<std::unique_ptr<TestGroup>> SaltTest::all_test_groups;
 
+// normally defined in main.cpp
+bool salt::no_std = false;
+std::vector<std::string> salt::file_names = { "test" };
+int salt::current_file_name_index = 0;
+
 static void add_all_tests() {
 	add_t_testing();
 	add_t_common();
+	add_t_lexer();
+	add_t_incrementalparser();
+	add_t_constantfolder();
+	add_t_constevaluator();
+	add_t_astcache();
 }
 
 static void set_color(int color) {